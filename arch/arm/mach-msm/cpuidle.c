@@ -14,6 +14,10 @@
 #include <linux/kernel.h>
 #include <linux/init.h>
 #include <linux/cpuidle.h>
+#include <linux/debugfs.h>
+#include <linux/ktime.h>
+#include <linux/seq_file.h>
+#include <linux/tick.h>
 
 #include "cpuidle.h"
 #include "pm.h"
@@ -24,6 +28,72 @@ static struct cpuidle_driver msm_cpuidle_driver = {
 	.owner = THIS_MODULE,
 };
 
+/*
+ * Per state statistics, updated with interrupts disabled on the idling
+ * CPU.  Histogram bucket i counts times in [2^(i-1), 2^i) us.  The
+ * latency is how far past the expected timer wakeup the CPU came back,
+ * i.e. the entry plus exit cost actually paid, and is only sampled when
+ * the sleep was ended by the timer.
+ */
+#define MSM_CPUIDLE_HIST_BUCKETS	12
+
+struct msm_cpuidle_state_stats {
+	u32 count;
+	u32 short_count;	/* residency below target_residency */
+	u32 latency_avg;	/* us, moving average */
+	u32 residency_hist[MSM_CPUIDLE_HIST_BUCKETS];
+	u32 latency_hist[MSM_CPUIDLE_HIST_BUCKETS];
+};
+
+static DEFINE_PER_CPU(struct msm_cpuidle_state_stats[CPUIDLE_STATE_MAX],
+		msm_cpuidle_stats);
+
+static inline int msm_cpuidle_bucket(s64 us)
+{
+	if (us <= 0)
+		return 0;
+	if (us >= (1 << (MSM_CPUIDLE_HIST_BUCKETS - 2)))
+		return MSM_CPUIDLE_HIST_BUCKETS - 1;
+	return fls((u32) us);
+}
+
+static void msm_cpuidle_update_stats(struct cpuidle_device *dev,
+	struct cpuidle_state *state, s64 residency, s64 sleep_length)
+{
+	struct msm_cpuidle_state_stats *stats =
+		&__get_cpu_var(msm_cpuidle_stats)[state - dev->states];
+	s64 latency;
+
+	stats->count++;
+	stats->residency_hist[msm_cpuidle_bucket(residency)]++;
+	if (residency < state->target_residency)
+		stats->short_count++;
+
+	if (residency < sleep_length)
+		return;
+
+	latency = residency - sleep_length;
+	stats->latency_hist[msm_cpuidle_bucket(latency)]++;
+	if (!stats->latency_avg)
+		stats->latency_avg = (u32) latency;
+	else
+		stats->latency_avg = (7 * stats->latency_avg +
+				(u32) min_t(s64, latency, USHRT_MAX)) / 8;
+}
+
+/*
+ * Measured entry plus exit latency of @state_nr on @cpu in us, or the
+ * platform value until the state has been woken from by its timer.
+ */
+unsigned int msm_cpuidle_get_latency(unsigned int cpu, int state_nr)
+{
+	struct cpuidle_device *dev = &per_cpu(msm_cpuidle_devs, cpu);
+	unsigned int latency =
+		per_cpu(msm_cpuidle_stats, cpu)[state_nr].latency_avg;
+
+	return latency ? latency : dev->states[state_nr].exit_latency;
+}
+
 #ifdef CONFIG_MSM_SLEEP_STATS
 static DEFINE_PER_CPU(struct atomic_notifier_head, msm_cpuidle_notifiers);
 
@@ -50,6 +120,8 @@ static int msm_cpuidle_enter(
 	struct cpuidle_device *dev, struct cpuidle_state *state)
 {
 	int ret;
+	ktime_t start;
+	s64 sleep_length;
 #ifdef CONFIG_MSM_SLEEP_STATS
 	struct atomic_notifier_head *head =
 			&__get_cpu_var(msm_cpuidle_notifiers);
@@ -57,12 +129,18 @@ static int msm_cpuidle_enter(
 
 	local_irq_disable();
 
+	sleep_length = ktime_to_us(tick_nohz_get_sleep_length());
+	start = ktime_get();
+
 #ifdef CONFIG_MSM_SLEEP_STATS
 	atomic_notifier_call_chain(head, MSM_CPUIDLE_STATE_ENTER, NULL);
 #endif
 
 	ret = msm_pm_idle_enter((enum msm_pm_sleep_mode) (state->driver_data));
 
+	msm_cpuidle_update_stats(dev, state,
+		ktime_to_us(ktime_sub(ktime_get(), start)), sleep_length);
+
 #ifdef CONFIG_MSM_SLEEP_STATS
 	atomic_notifier_call_chain(head, MSM_CPUIDLE_STATE_EXIT, NULL);
 #endif
@@ -113,6 +191,71 @@ void __init msm_cpuidle_set_states(struct msm_cpuidle_state *states,
 	}
 }
 
+#ifdef CONFIG_DEBUG_FS
+static int msm_cpuidle_stats_show(struct seq_file *m, void *unused)
+{
+	unsigned int cpu;
+	int i, j;
+
+	for_each_possible_cpu(cpu) {
+		struct cpuidle_device *dev = &per_cpu(msm_cpuidle_devs, cpu);
+
+		for (i = 0; i < dev->state_count; i++) {
+			struct msm_cpuidle_state_stats *stats =
+				&per_cpu(msm_cpuidle_stats, cpu)[i];
+
+			seq_printf(m, "cpu%u %s: count %u short %u "
+				"latency %u us (platform %u us)\n", cpu,
+				dev->states[i].name, stats->count,
+				stats->short_count,
+				msm_cpuidle_get_latency(cpu, i),
+				dev->states[i].exit_latency);
+
+			seq_puts(m, "  residency:");
+			for (j = 0; j < MSM_CPUIDLE_HIST_BUCKETS; j++)
+				seq_printf(m, " %u", stats->residency_hist[j]);
+			seq_puts(m, "\n  latency:  ");
+			for (j = 0; j < MSM_CPUIDLE_HIST_BUCKETS; j++)
+				seq_printf(m, " %u", stats->latency_hist[j]);
+			seq_putc(m, '\n');
+		}
+	}
+	return 0;
+}
+
+static int msm_cpuidle_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, msm_cpuidle_stats_show, NULL);
+}
+
+static ssize_t msm_cpuidle_stats_write(struct file *file,
+	const char __user *buf, size_t count, loff_t *ppos)
+{
+	unsigned int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu(msm_cpuidle_stats, cpu), 0,
+			sizeof(per_cpu(msm_cpuidle_stats, cpu)));
+	return count;
+}
+
+static const struct file_operations msm_cpuidle_stats_fops = {
+	.open = msm_cpuidle_stats_open,
+	.read = seq_read,
+	.write = msm_cpuidle_stats_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init msm_cpuidle_debugfs_init(void)
+{
+	debugfs_create_file("msm_cpuidle_stats", S_IRUGO | S_IWUSR, NULL,
+		NULL, &msm_cpuidle_stats_fops);
+	return 0;
+}
+late_initcall(msm_cpuidle_debugfs_init);
+#endif
+
 int __init msm_cpuidle_init(void)
 {
 	unsigned int cpu;
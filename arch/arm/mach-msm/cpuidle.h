@@ -46,6 +46,7 @@ void msm_cpuidle_set_states(struct msm_cpuidle_state *states,
 	int nr_states, struct msm_pm_platform_data *pm_data);
 
 int msm_cpuidle_init(void);
+unsigned int msm_cpuidle_get_latency(unsigned int cpu, int state_nr);
 #else
 static inline void msm_cpuidle_set_states(struct msm_cpuidle_state *states,
 	int nr_states, struct msm_pm_platform_data *pm_data) {}
@@ -0,0 +1,137 @@
+/* Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * MSM cpuidle governor
+ *
+ * Predicts the idle period from the next timer event and the recent
+ * residency history of the CPU, then picks the deepest state whose
+ * target residency plus measured entry/exit latency fits in the
+ * prediction.  The latencies are the ones msm_cpuidle_enter() observed
+ * on this CPU rather than the static platform values, so a power
+ * collapse that costs more than it saves under load is not chosen.
+ * The average is only updated when the state is entered, so a state
+ * turned down MSM_IDLE_MAX_SKIPS times in a row on its measured latency
+ * alone is tried once more on the platform value to refresh it.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/cpuidle.h>
+#include <linux/ktime.h>
+#include <linux/pm_qos_params.h>
+#include <linux/tick.h>
+
+#include "cpuidle.h"
+
+#define MSM_IDLE_HISTORY	8
+#define MSM_IDLE_MAX_SKIPS	32
+
+struct msm_idle_device {
+	unsigned int history[MSM_IDLE_HISTORY];
+	int history_idx;
+	int last_state_idx;
+	unsigned int skipped[CPUIDLE_STATE_MAX];
+};
+
+static DEFINE_PER_CPU(struct msm_idle_device, msm_idle_devices);
+
+/*
+ * Average of the recent residencies if they are consistent enough to be
+ * a better predictor than the next timer, or UINT_MAX otherwise.
+ */
+static unsigned int msm_idle_typical_interval(struct msm_idle_device *mdev)
+{
+	u64 avg = 0, variance = 0;
+	s64 diff;
+	int i;
+
+	for (i = 0; i < MSM_IDLE_HISTORY; i++)
+		avg += mdev->history[i];
+	avg /= MSM_IDLE_HISTORY;
+
+	for (i = 0; i < MSM_IDLE_HISTORY; i++) {
+		diff = (s64) mdev->history[i] - avg;
+		variance += diff * diff;
+	}
+	variance /= MSM_IDLE_HISTORY;
+
+	/* standard deviation within a quarter of the average */
+	if (avg && variance * 16 <= avg * avg)
+		return (unsigned int) avg;
+	return UINT_MAX;
+}
+
+static int msm_idle_select(struct cpuidle_device *dev)
+{
+	struct msm_idle_device *mdev = &__get_cpu_var(msm_idle_devices);
+	int latency_req = pm_qos_request(PM_QOS_CPU_DMA_LATENCY);
+	unsigned int predicted, latency;
+	int i, idx = CPUIDLE_DRIVER_STATE_START;
+
+	predicted = min_t(s64, ktime_to_us(tick_nohz_get_sleep_length()),
+			UINT_MAX);
+	predicted = min(predicted, msm_idle_typical_interval(mdev));
+
+	for (i = CPUIDLE_DRIVER_STATE_START + 1; i < dev->state_count; i++) {
+		struct cpuidle_state *s = &dev->states[i];
+
+		if ((int) s->exit_latency > latency_req)
+			break;
+		if (s->target_residency + s->exit_latency > predicted)
+			break;
+
+		latency = msm_cpuidle_get_latency(dev->cpu, i);
+		if (((int) latency > latency_req ||
+		     s->target_residency + latency > predicted) &&
+		    mdev->skipped[i] < MSM_IDLE_MAX_SKIPS) {
+			mdev->skipped[i]++;
+			break;
+		}
+		mdev->skipped[i] = 0;
+		idx = i;
+	}
+
+	mdev->last_state_idx = idx;
+	return idx;
+}
+
+static void msm_idle_reflect(struct cpuidle_device *dev)
+{
+	struct msm_idle_device *mdev = &__get_cpu_var(msm_idle_devices);
+
+	mdev->history[mdev->history_idx] = cpuidle_get_last_residency(dev);
+	mdev->history_idx = (mdev->history_idx + 1) % MSM_IDLE_HISTORY;
+}
+
+static int msm_idle_enable(struct cpuidle_device *dev)
+{
+	struct msm_idle_device *mdev = &per_cpu(msm_idle_devices, dev->cpu);
+
+	memset(mdev, 0, sizeof(*mdev));
+	return 0;
+}
+
+static struct cpuidle_governor msm_idle_governor = {
+	.name =		"msm",
+	.rating =	30,
+	.enable =	msm_idle_enable,
+	.select =	msm_idle_select,
+	.reflect =	msm_idle_reflect,
+	.owner =	THIS_MODULE,
+};
+
+static int __init msm_idle_governor_init(void)
+{
+	return cpuidle_register_governor(&msm_idle_governor);
+}
+postcore_initcall(msm_idle_governor_init);
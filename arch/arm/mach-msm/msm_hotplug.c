@@ -0,0 +1,312 @@
+/* Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/*
+ * Qualcomm MSM in-kernel CPU hotplug governor
+ *
+ * Brings secondary CPUs online and offline from the run queue average
+ * maintained by msm_rq_stats and the frequency scaled CPU load, without
+ * the userspace polling round trip.  A CPU is added when both are above
+ * their up thresholds for up_hold consecutive samples and removed when
+ * both are below their down thresholds for down_hold samples and it has
+ * been online for at least min_online_ms.  While the screen is off at
+ * most suspend_max_cpus stay online.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/cpu.h>
+#include <linux/cpufreq.h>
+#include <linux/earlysuspend.h>
+#include <linux/jiffies.h>
+#include <linux/math64.h>
+#include <linux/mutex.h>
+#include <linux/tick.h>
+#include <linux/workqueue.h>
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/msm_hotplug.h>
+
+#include "msm_rq_stats.h"
+
+static unsigned int min_cpus = 1;
+module_param_named(min_cpus, min_cpus, uint, S_IRUGO | S_IWUSR | S_IWGRP);
+
+static unsigned int max_cpus = NR_CPUS;
+module_param_named(max_cpus, max_cpus, uint, S_IRUGO | S_IWUSR | S_IWGRP);
+
+static unsigned int suspend_max_cpus = 1;
+module_param_named(suspend_max_cpus, suspend_max_cpus, uint,
+		   S_IRUGO | S_IWUSR | S_IWGRP);
+
+/* Run queue thresholds, in tenths of a task per online CPU. */
+static unsigned int up_rq = 15;
+module_param_named(up_rq, up_rq, uint, S_IRUGO | S_IWUSR | S_IWGRP);
+
+static unsigned int down_rq = 10;
+module_param_named(down_rq, down_rq, uint, S_IRUGO | S_IWUSR | S_IWGRP);
+
+/* Load thresholds, in percent of the maximum frequency. */
+static unsigned int up_load = 60;
+module_param_named(up_load, up_load, uint, S_IRUGO | S_IWUSR | S_IWGRP);
+
+static unsigned int down_load = 25;
+module_param_named(down_load, down_load, uint, S_IRUGO | S_IWUSR | S_IWGRP);
+
+static unsigned int up_hold = 2;
+module_param_named(up_hold, up_hold, uint, S_IRUGO | S_IWUSR | S_IWGRP);
+
+static unsigned int down_hold = 10;
+module_param_named(down_hold, down_hold, uint, S_IRUGO | S_IWUSR | S_IWGRP);
+
+static unsigned int min_online_ms = 500;
+module_param_named(min_online_ms, min_online_ms, uint,
+		   S_IRUGO | S_IWUSR | S_IWGRP);
+
+struct hotplug_cpu_data {
+	u64 prev_idle;
+	u64 prev_wall;
+	unsigned long online_jiffies;
+};
+
+static DEFINE_PER_CPU(struct hotplug_cpu_data, hotplug_cpu_data);
+
+static struct hotplug_data {
+	struct delayed_work work;
+	struct mutex lock;
+	unsigned int up_count;
+	unsigned int down_count;
+	int suspended;
+} hotplug;
+
+static struct workqueue_struct *hotplug_wq;
+
+static int enabled = 1;
+
+/* msm_rq_stats averages over the same window as the governor samples */
+static unsigned int sample_ms = 50;
+
+static int set_sample_ms(const char *val, struct kernel_param *kp)
+{
+	int ret = param_set_uint(val, kp);
+
+	if (ret)
+		return ret;
+	if (!sample_ms)
+		sample_ms = 1;
+	if (hotplug_wq)
+		msm_rq_stats_set_poll_ms(sample_ms);
+	return 0;
+}
+module_param_call(sample_ms, set_sample_ms, param_get_uint, &sample_ms,
+		  S_IRUGO | S_IWUSR | S_IWGRP);
+
+static int set_enabled(const char *val, struct kernel_param *kp)
+{
+	int ret = param_set_int(val, kp);
+
+	if (!ret && enabled && hotplug_wq)
+		queue_delayed_work(hotplug_wq, &hotplug.work,
+				   msecs_to_jiffies(sample_ms));
+	return ret;
+}
+module_param_call(enabled, set_enabled, param_get_int, &enabled,
+		  S_IRUGO | S_IWUSR | S_IWGRP);
+
+static void hotplug_reset_cpu(unsigned int cpu)
+{
+	struct hotplug_cpu_data *data = &per_cpu(hotplug_cpu_data, cpu);
+
+	data->prev_idle = get_cpu_idle_time_us(cpu, &data->prev_wall);
+	data->online_jiffies = jiffies;
+}
+
+/* Average busy percentage of the online CPUs, scaled by cur/max freq. */
+static unsigned int hotplug_get_load(void)
+{
+	struct hotplug_cpu_data *data;
+	struct cpufreq_policy *policy;
+	unsigned int cpu, load, total = 0, count = 0;
+	u64 idle, wall, idle_delta, wall_delta;
+
+	for_each_online_cpu(cpu) {
+		data = &per_cpu(hotplug_cpu_data, cpu);
+		idle = get_cpu_idle_time_us(cpu, &wall);
+		idle_delta = idle - data->prev_idle;
+		wall_delta = wall - data->prev_wall;
+		data->prev_idle = idle;
+		data->prev_wall = wall;
+
+		if (!wall_delta || idle_delta > wall_delta)
+			load = 0;
+		else
+			load = div64_u64(100 * (wall_delta - idle_delta),
+					 wall_delta);
+
+		policy = cpufreq_cpu_get(cpu);
+		if (policy) {
+			if (policy->cpuinfo.max_freq)
+				load = load * policy->cur /
+					policy->cpuinfo.max_freq;
+			cpufreq_cpu_put(policy);
+		}
+
+		total += load;
+		count++;
+	}
+
+	return count ? total / count : 0;
+}
+
+static void hotplug_cpu_up(unsigned int rq_avg, unsigned int load)
+{
+	unsigned int cpu;
+
+	for_each_present_cpu(cpu) {
+		if (cpu_online(cpu))
+			continue;
+		if (!cpu_up(cpu))
+			trace_msm_hotplug_decision(cpu, 1, rq_avg, load);
+		return;
+	}
+}
+
+static void hotplug_cpu_down(unsigned int rq_avg, unsigned int load,
+			     bool force)
+{
+	struct hotplug_cpu_data *data;
+	unsigned long min_online = msecs_to_jiffies(min_online_ms);
+	int cpu;
+
+	for (cpu = nr_cpu_ids - 1; cpu > 0; cpu--) {
+		if (!cpu_online(cpu))
+			continue;
+		data = &per_cpu(hotplug_cpu_data, cpu);
+		if (!force &&
+		    time_before(jiffies, data->online_jiffies + min_online))
+			return;
+		if (!cpu_down(cpu))
+			trace_msm_hotplug_decision(cpu, 0, rq_avg, load);
+		return;
+	}
+}
+
+static void hotplug_work_fn(struct work_struct *work)
+{
+	unsigned int online, rq_avg, load, max;
+
+	mutex_lock(&hotplug.lock);
+
+	rq_avg = msm_rq_stats_read_avg();
+	load = hotplug_get_load();
+	online = num_online_cpus();
+	max = hotplug.suspended ? min(max_cpus, suspend_max_cpus) : max_cpus;
+
+	if (online > max) {
+		hotplug_cpu_down(rq_avg, load, true);
+		hotplug.up_count = hotplug.down_count = 0;
+	} else if (online < min_cpus) {
+		hotplug_cpu_up(rq_avg, load);
+		hotplug.up_count = hotplug.down_count = 0;
+	} else if (online < max && rq_avg >= up_rq * online &&
+		   load >= up_load) {
+		hotplug.down_count = 0;
+		if (++hotplug.up_count >= up_hold) {
+			hotplug_cpu_up(rq_avg, load);
+			hotplug.up_count = 0;
+		}
+	} else if (online > min_cpus && rq_avg < down_rq * (online - 1) &&
+		   load < down_load) {
+		hotplug.up_count = 0;
+		if (++hotplug.down_count >= down_hold) {
+			hotplug_cpu_down(rq_avg, load, false);
+			hotplug.down_count = 0;
+		}
+	} else {
+		hotplug.up_count = hotplug.down_count = 0;
+	}
+
+	mutex_unlock(&hotplug.lock);
+
+	if (enabled)
+		queue_delayed_work(hotplug_wq, &hotplug.work,
+				   msecs_to_jiffies(sample_ms));
+}
+
+static int __cpuinit hotplug_cpu_callback(struct notifier_block *nfb,
+					  unsigned long action, void *hcpu)
+{
+	unsigned int cpu = (unsigned long)hcpu;
+
+	switch (action) {
+	case CPU_ONLINE:
+	case CPU_ONLINE_FROZEN:
+		hotplug_reset_cpu(cpu);
+		break;
+	}
+	return NOTIFY_OK;
+}
+
+static struct notifier_block hotplug_cpu_notifier __refdata = {
+	.notifier_call = hotplug_cpu_callback,
+};
+
+#ifdef CONFIG_HAS_EARLYSUSPEND
+static void hotplug_early_suspend(struct early_suspend *h)
+{
+	mutex_lock(&hotplug.lock);
+	hotplug.suspended = 1;
+	mutex_unlock(&hotplug.lock);
+}
+
+static void hotplug_late_resume(struct early_suspend *h)
+{
+	mutex_lock(&hotplug.lock);
+	hotplug.suspended = 0;
+	hotplug.up_count = hotplug.down_count = 0;
+	mutex_unlock(&hotplug.lock);
+}
+
+static struct early_suspend hotplug_early_suspend_handler = {
+	.level = EARLY_SUSPEND_LEVEL_DISABLE_FB,
+	.suspend = hotplug_early_suspend,
+	.resume = hotplug_late_resume,
+};
+#endif
+
+static int __init msm_hotplug_init(void)
+{
+	unsigned int cpu;
+
+	hotplug_wq = create_singlethread_workqueue("msm_hotplug");
+	if (!hotplug_wq)
+		return -ENOMEM;
+
+	mutex_init(&hotplug.lock);
+	INIT_DELAYED_WORK_DEFERRABLE(&hotplug.work, hotplug_work_fn);
+
+	for_each_online_cpu(cpu)
+		hotplug_reset_cpu(cpu);
+	register_hotcpu_notifier(&hotplug_cpu_notifier);
+
+#ifdef CONFIG_HAS_EARLYSUSPEND
+	register_early_suspend(&hotplug_early_suspend_handler);
+#endif
+
+	msm_rq_stats_set_poll_ms(sample_ms);
+	if (enabled)
+		queue_delayed_work(hotplug_wq, &hotplug.work,
+				   msecs_to_jiffies(sample_ms));
+	return 0;
+}
+late_initcall_sync(msm_hotplug_init);
@@ -27,13 +27,17 @@
 #include <linux/sched.h>
 #include <linux/spinlock.h>
 
+#include "msm_rq_stats.h"
+
 struct rq_data {
 	unsigned int rq_avg;
+	unsigned int gov_avg;		/* for msm_rq_stats_read_avg() */
 	unsigned int rq_poll_ms;
 	unsigned int def_timer_ms;
 	unsigned int def_interval;
 	int64_t last_time;
 	int64_t total_time;
+	int64_t gov_total_time;
 	int64_t def_start_time;
 	struct delayed_work rq_work;
 	struct attribute_group *attr_group;
@@ -45,37 +49,48 @@ static struct rq_data rq_info;
 static DEFINE_SPINLOCK(rq_lock);
 static struct workqueue_struct *rq_wq;
 
+/* Fold a sample into an average that a reader resets to 0. */
+static void rq_avg_fold(unsigned int *avg, int64_t *total_time,
+			unsigned int nr, int64_t time_diff)
+{
+	int64_t rq_avg = nr;
+
+	if (!*avg)
+		*total_time = 0;
+
+	if (time_diff && *total_time) {
+		rq_avg = (rq_avg * time_diff) + (*avg * *total_time);
+		do_div(rq_avg, *total_time + time_diff);
+	}
+
+	*avg = (unsigned int)rq_avg;
+	*total_time += time_diff;
+}
+
 static void rq_work_fn(struct work_struct *work)
 {
 	int64_t time_diff = 0;
-	int64_t rq_avg = 0;
+	unsigned int nr;
 	unsigned long flags = 0;
 
 	spin_lock_irqsave(&rq_lock, flags);
 
 	if (!rq_info.last_time)
 		rq_info.last_time = ktime_to_ns(ktime_get());
-	if (!rq_info.rq_avg)
-		rq_info.total_time = 0;
 
-	rq_avg = nr_running() * 10;
+	nr = nr_running() * 10;
 	time_diff = ktime_to_ns(ktime_get()) - rq_info.last_time;
 	do_div(time_diff, (1000 * 1000));
 
-	if (time_diff && rq_info.total_time) {
-		rq_avg = (rq_avg * time_diff) +
-			(rq_info.rq_avg * rq_info.total_time);
-		do_div(rq_avg, rq_info.total_time + time_diff);
-	}
-
-	rq_info.rq_avg =  (unsigned int)rq_avg;
+	rq_avg_fold(&rq_info.rq_avg, &rq_info.total_time, nr, time_diff);
+	rq_avg_fold(&rq_info.gov_avg, &rq_info.gov_total_time, nr,
+		    time_diff);
 
 	/* Set the next poll */
 	if (rq_info.rq_poll_ms)
 		queue_delayed_work(rq_wq, &rq_info.rq_work,
 			msecs_to_jiffies(rq_info.rq_poll_ms));
 
-	rq_info.total_time += time_diff;
 	rq_info.last_time = ktime_to_ns(ktime_get());
 
 	spin_unlock_irqrestore(&rq_lock, flags);
@@ -93,6 +108,24 @@ static void def_work_fn(struct work_struct *work)
 	sysfs_notify(rq_info.kobj, NULL, "def_timer_ms");
 }
 
+/*
+ * Return the run queue average, in tenths of a task, since the previous
+ * call and start a new averaging period.  This average is kept apart
+ * from the one run_queue_avg reads and resets.
+ */
+unsigned int msm_rq_stats_read_avg(void)
+{
+	unsigned int val = 0;
+	unsigned long flags = 0;
+
+	spin_lock_irqsave(&rq_lock, flags);
+	val = rq_info.gov_avg;
+	rq_info.gov_avg = 0;
+	spin_unlock_irqrestore(&rq_lock, flags);
+
+	return val;
+}
+
 static ssize_t show_run_queue_avg(struct kobject *kobj,
 		struct kobj_attribute *attr, char *buf)
 {
@@ -121,17 +154,15 @@ static ssize_t show_run_queue_poll_ms(struct kobject *kobj,
 	return ret;
 }
 
-static ssize_t store_run_queue_poll_ms(struct kobject *kobj,
-		struct kobj_attribute *attr, const char *buf, size_t count)
+/* Sample the run queue every @poll_ms; 0 stops sampling. */
+void msm_rq_stats_set_poll_ms(unsigned int val)
 {
-	int val = 0;
 	unsigned long flags = 0;
 	static DEFINE_MUTEX(lock_poll_ms);
 
 	mutex_lock(&lock_poll_ms);
 
 	spin_lock_irqsave(&rq_lock, flags);
-	sscanf(buf, "%u", &val);
 	rq_info.rq_poll_ms = val;
 	spin_unlock_irqrestore(&rq_lock, flags);
 
@@ -142,6 +173,15 @@ static ssize_t store_run_queue_poll_ms(struct kobject *kobj,
 				msecs_to_jiffies(val));
 
 	mutex_unlock(&lock_poll_ms);
+}
+
+static ssize_t store_run_queue_poll_ms(struct kobject *kobj,
+		struct kobj_attribute *attr, const char *buf, size_t count)
+{
+	unsigned int val = 0;
+
+	sscanf(buf, "%u", &val);
+	msm_rq_stats_set_poll_ms(val);
 
 	return count;
 }
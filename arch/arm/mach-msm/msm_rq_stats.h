@@ -0,0 +1,20 @@
+/* Copyright (c) 2010-2011, Code Aurora Forum. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef __ARCH_ARM_MACH_MSM_RQ_STATS_H
+#define __ARCH_ARM_MACH_MSM_RQ_STATS_H
+
+unsigned int msm_rq_stats_read_avg(void);
+void msm_rq_stats_set_poll_ms(unsigned int poll_ms);
+
+#endif
@@ -114,6 +114,22 @@ struct blkio_cgroup *cgroup_to_blkio_cgroup(struct cgroup *cgroup)
 }
 EXPORT_SYMBOL_GPL(cgroup_to_blkio_cgroup);
 
+#ifdef CONFIG_BLK_DEV_PRIO
+/* Weight and read latency target of the group @tsk is in. */
+void blkio_task_prio(struct task_struct *tsk, unsigned int *weight,
+		     unsigned int *read_latency_us)
+{
+	struct blkio_cgroup *blkcg;
+
+	rcu_read_lock();
+	blkcg = container_of(task_subsys_state(tsk, blkio_subsys_id),
+			     struct blkio_cgroup, css);
+	*weight = blkcg->weight;
+	*read_latency_us = blkcg->read_latency_us;
+	rcu_read_unlock();
+}
+#endif
+
 static inline void
 blkio_update_group_weight(struct blkio_group *blkg, unsigned int weight)
 {
@@ -1202,6 +1218,10 @@ static u64 blkiocg_file_read_u64 (struct cgroup *cgrp, struct cftype *cft) {
 		switch(name) {
 		case BLKIO_PROP_weight:
 			return (u64)blkcg->weight;
+#ifdef CONFIG_BLK_DEV_PRIO
+		case BLKIO_PROP_read_latency_us:
+			return (u64)blkcg->read_latency_us;
+#endif
 		}
 		break;
 	default:
@@ -1224,6 +1244,13 @@ blkiocg_file_write_u64(struct cgroup *cgrp, struct cftype *cft, u64 val)
 		switch(name) {
 		case BLKIO_PROP_weight:
 			return blkio_weight_write(blkcg, val);
+#ifdef CONFIG_BLK_DEV_PRIO
+		case BLKIO_PROP_read_latency_us:
+			if (val > UINT_MAX)
+				return -EINVAL;
+			blkcg->read_latency_us = val;
+			return 0;
+#endif
 		}
 		break;
 	default:
@@ -1249,6 +1276,15 @@ struct cftype blkio_files[] = {
 		.read_u64 = blkiocg_file_read_u64,
 		.write_u64 = blkiocg_file_write_u64,
 	},
+#ifdef CONFIG_BLK_DEV_PRIO
+	{
+		.name = "read_latency_us",
+		.private = BLKIOFILE_PRIVATE(BLKIO_POLICY_PROP,
+				BLKIO_PROP_read_latency_us),
+		.read_u64 = blkiocg_file_read_u64,
+		.write_u64 = blkiocg_file_write_u64,
+	},
+#endif
 	{
 		.name = "time",
 		.private = BLKIOFILE_PRIVATE(BLKIO_POLICY_PROP,
@@ -90,6 +90,7 @@ enum blkcg_file_name_prop {
 	BLKIO_PROP_idle_time,
 	BLKIO_PROP_empty_time,
 	BLKIO_PROP_dequeue,
+	BLKIO_PROP_read_latency_us,
 };
 
 /* cgroup files owned by throttle policy */
@@ -105,6 +106,9 @@ enum blkcg_file_name_throtl {
 struct blkio_cgroup {
 	struct cgroup_subsys_state css;
 	unsigned int weight;
+#ifdef CONFIG_BLK_DEV_PRIO
+	unsigned int read_latency_us;
+#endif
 	spinlock_t lock;
 	struct hlist_head blkg_list;
 	struct list_head policy_list; /* list of blkio_policy_node */
@@ -290,6 +294,10 @@ extern void blkiocg_add_blkio_group(struct blkio_cgroup *blkcg,
 	struct blkio_group *blkg, void *key, dev_t dev,
 	enum blkio_policy_id plid);
 extern int blkiocg_del_blkio_group(struct blkio_group *blkg);
+#ifdef CONFIG_BLK_DEV_PRIO
+extern void blkio_task_prio(struct task_struct *tsk, unsigned int *weight,
+			    unsigned int *read_latency_us);
+#endif
 extern struct blkio_group *blkiocg_lookup_group(struct blkio_cgroup *blkcg,
 						void *key);
 void blkiocg_update_timeslice_used(struct blkio_group *blkg,
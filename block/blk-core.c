@@ -536,6 +536,19 @@ struct request_queue *blk_alloc_queue_node(gfp_t gfp_mask, int node_id)
 		return NULL;
 	}
 
+	if (blk_discard_defer_init(q)) {
+		blk_throtl_exit(q);
+		kmem_cache_free(blk_requestq_cachep, q);
+		return NULL;
+	}
+
+	if (blk_prio_init(q)) {
+		blk_discard_defer_exit(q);
+		blk_throtl_exit(q);
+		kmem_cache_free(blk_requestq_cachep, q);
+		return NULL;
+	}
+
 	setup_timer(&q->backing_dev_info.laptop_mode_wb_timer,
 		    laptop_mode_timer_fn, (unsigned long) q);
 	init_timer(&q->unplug_timer);
@@ -860,6 +873,8 @@ rq_starved:
 	if (ioc_batching(q, ioc))
 		ioc->nr_batch_requests--;
 
+	blk_prio_set_request(q, rq);
+
 	trace_block_getrq(q, bio, rw_flags & 1);
 out:
 	return rq;
@@ -877,6 +892,8 @@ static struct request *get_request_wait(struct request_queue *q, int rw_flags,
 	const bool is_sync = rw_is_sync(rw_flags) != 0;
 	struct request *rq;
 
+	blk_prio_throttle(q, rw_flags);
+
 	rq = get_request(q, rw_flags, bio, GFP_NOIO);
 	while (!rq) {
 		DEFINE_WAIT(wait);
@@ -1125,6 +1142,7 @@ void __blk_put_request(struct request_queue *q, struct request *req)
 		BUG_ON(!list_empty(&req->queuelist));
 		BUG_ON(!hlist_unhashed(&req->hash));
 
+		blk_prio_put_request(q, req);
 		blk_free_request(q, req);
 		freed_request(q, is_sync, priv);
 	}
@@ -1545,6 +1563,8 @@ static inline void __generic_make_request(struct bio *bio)
 			goto end_io;
 		}
 
+		blk_discard_defer_bio(q, bio);
+
 		blk_throtl_bio(q, &bio);
 
 		/*
@@ -2214,6 +2234,7 @@ static void blk_finish_request(struct request *req, int error)
 
 
 	blk_account_io_done(req);
+	blk_prio_done(req);
 
 	if (req->end_io)
 		req->end_io(req, error);
@@ -0,0 +1,570 @@
+/*
+ * Deferred discard support
+ *
+ * On slow flash a discard can keep the device busy for hundreds of
+ * milliseconds, and reads queued behind it wait just as long.  When
+ * discard deferral is enabled for a queue, blkdev_issue_discard() only
+ * records the range and returns.  Adjacent and overlapping ranges are
+ * merged, and the ranges are sent to the device once it has been idle
+ * for discard_idle_ms, or right away while the screen is off.  Writes
+ * to a range that is still pending remove it from the pending set, and
+ * wait if it is being discarded at that moment, so a deferred discard
+ * never hits data written after it was requested.  Reads of a pending
+ * range return the old data, so such a queue does not report
+ * discard_zeroes_data.
+ *
+ * Secure discards are never deferred.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/bio.h>
+#include <linux/blkdev.h>
+#include <linux/earlysuspend.h>
+#include <linux/genhd.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+
+#include "blk.h"
+
+/* Most ranges kept pending; further discards are issued inline. */
+#define DISCARD_MAX_RANGES	1024
+/* Longest single discard, so that a blocked writer does not wait long. */
+#define DISCARD_CHUNK_SECTORS	(8 << 11)	/* 8MB */
+#define DISCARD_IDLE_MS		1000
+
+struct discard_range {
+	struct list_head	list;
+	sector_t		sector;
+	sector_t		nr_sects;
+};
+
+struct discard_data {
+	struct request_queue	*queue;
+	struct list_head	node;		/* on discard_queues */
+
+	spinlock_t		lock;
+	struct list_head	ranges;		/* sorted, non-adjacent */
+	unsigned int		nr_ranges;
+	sector_t		nr_sects;
+	struct gendisk		*disk;		/* held while ranges pend */
+
+	/* range being discarded, writers to it wait on @wait */
+	sector_t		issue_sector;
+	sector_t		issue_nr_sects;
+	wait_queue_head_t	wait;
+
+	struct delayed_work	work;
+	unsigned long		last_io;	/* jiffies */
+	int			flush;		/* ignore idleness */
+
+	/* tunables */
+	unsigned int		enabled;
+	unsigned int		idle_ms;
+
+	unsigned int		zeroes_data;	/* saved while enabled */
+};
+
+static LIST_HEAD(discard_queues);
+static DEFINE_MUTEX(discard_queues_lock);
+static int discard_screen_off;
+
+static void discard_kick(struct discard_data *dd)
+{
+	cancel_delayed_work(&dd->work);
+	queue_delayed_work(system_nrt_wq, &dd->work, 0);
+}
+
+static int discard_queue_busy(struct request_queue *q)
+{
+	return q->rq.count[BLK_RW_SYNC] + q->rq.count[BLK_RW_ASYNC];
+}
+
+/*
+ * The whole disk is opened for every chunk, as the filesystem that
+ * queued the discards may have been unmounted since.
+ */
+static struct block_device *discard_open(struct gendisk *disk)
+{
+	struct block_device *bdev;
+	int ret;
+
+	bdev = bdget_disk(disk, 0);
+	if (!bdev)
+		return ERR_PTR(-ENODEV);
+
+	ret = blkdev_get(bdev, FMODE_WRITE, NULL);
+	if (ret)
+		return ERR_PTR(ret);
+	return bdev;
+}
+
+static void discard_drop_all(struct discard_data *dd)
+{
+	struct discard_range *r, *tmp;
+
+	list_for_each_entry_safe(r, tmp, &dd->ranges, list) {
+		list_del(&r->list);
+		kfree(r);
+	}
+	dd->nr_ranges = 0;
+	dd->nr_sects = 0;
+}
+
+static void discard_work_fn(struct work_struct *work)
+{
+	struct discard_data *dd =
+		container_of(work, struct discard_data, work.work);
+	struct block_device *bdev;
+	struct gendisk *disk;
+	struct discard_range *r;
+	unsigned long idle_at;
+	sector_t sector, nr_sects;
+	int ret;
+
+	spin_lock(&dd->lock);
+	if (list_empty(&dd->ranges)) {
+		disk = dd->disk;
+		dd->disk = NULL;
+		dd->flush = 0;
+		spin_unlock(&dd->lock);
+		wake_up_all(&dd->wait);
+		if (disk)
+			put_disk(disk);
+		return;
+	}
+
+	if (!dd->flush && !discard_screen_off) {
+		idle_at = dd->last_io + msecs_to_jiffies(dd->idle_ms);
+		if (time_before(jiffies, idle_at) ||
+		    discard_queue_busy(dd->queue)) {
+			spin_unlock(&dd->lock);
+			queue_delayed_work(system_nrt_wq, &dd->work,
+				time_before(jiffies, idle_at) ?
+				idle_at - jiffies :
+				msecs_to_jiffies(dd->idle_ms));
+			return;
+		}
+	}
+
+	disk = dd->disk;
+	spin_unlock(&dd->lock);
+
+	/*
+	 * Open before marking the range busy: a writer waiting for it
+	 * may hold bd_mutex, e.g. when syncing on the last close.
+	 */
+	bdev = discard_open(disk);
+	if (IS_ERR(bdev)) {
+		spin_lock(&dd->lock);
+		discard_drop_all(dd);
+		spin_unlock(&dd->lock);
+		goto out;
+	}
+
+	spin_lock(&dd->lock);
+	if (list_empty(&dd->ranges)) {
+		spin_unlock(&dd->lock);
+		blkdev_put(bdev, FMODE_WRITE);
+		goto out;
+	}
+	r = list_first_entry(&dd->ranges, struct discard_range, list);
+	sector = r->sector;
+	nr_sects = min_t(sector_t, r->nr_sects, DISCARD_CHUNK_SECTORS);
+	if (nr_sects == r->nr_sects) {
+		list_del(&r->list);
+		kfree(r);
+		dd->nr_ranges--;
+	} else {
+		r->sector += nr_sects;
+		r->nr_sects -= nr_sects;
+	}
+	dd->nr_sects -= nr_sects;
+	dd->issue_sector = sector;
+	dd->issue_nr_sects = nr_sects;
+	spin_unlock(&dd->lock);
+
+	ret = __blkdev_issue_discard(bdev, sector, nr_sects, GFP_NOIO, 0);
+
+	spin_lock(&dd->lock);
+	dd->issue_nr_sects = 0;
+	/* discards are advisory; don't retry a device that fails them */
+	if (ret)
+		discard_drop_all(dd);
+	spin_unlock(&dd->lock);
+	wake_up_all(&dd->wait);
+	blkdev_put(bdev, FMODE_WRITE);
+out:
+	queue_delayed_work(system_nrt_wq, &dd->work, 0);
+}
+
+/*
+ * Record a discard of @nr_sects at @sector of @bdev for later.  Returns
+ * false if the caller has to issue it itself.
+ */
+bool blk_discard_defer(struct block_device *bdev, sector_t sector,
+		       sector_t nr_sects, gfp_t gfp_mask)
+{
+	struct discard_data *dd = bdev_get_queue(bdev)->discard_data;
+	struct gendisk *disk = bdev->bd_disk;
+	struct discard_range *new, *r, *next;
+	struct list_head *pos;
+
+	if (!dd || !dd->enabled)
+		return false;
+
+	new = kmalloc(sizeof(*new), gfp_mask);
+	if (!new)
+		return false;
+
+	if (bdev != bdev->bd_contains)
+		sector += get_start_sect(bdev);
+
+	spin_lock(&dd->lock);
+	if (dd->nr_ranges >= DISCARD_MAX_RANGES ||
+	    (dd->disk && dd->disk != disk)) {
+		spin_unlock(&dd->lock);
+		kfree(new);
+		return false;
+	}
+	if (!dd->disk) {
+		if (!get_disk(disk)) {
+			spin_unlock(&dd->lock);
+			kfree(new);
+			return false;
+		}
+		dd->disk = disk;
+	}
+
+	/* find the last range starting at or before @sector */
+	pos = &dd->ranges;
+	list_for_each_entry(r, &dd->ranges, list) {
+		if (r->sector > sector)
+			break;
+		pos = &r->list;
+	}
+
+	r = list_entry(pos, struct discard_range, list);
+	if (pos != &dd->ranges && r->sector + r->nr_sects >= sector) {
+		/* extend the previous range */
+		kfree(new);
+		if (r->sector + r->nr_sects < sector + nr_sects) {
+			dd->nr_sects += sector + nr_sects -
+					(r->sector + r->nr_sects);
+			r->nr_sects = sector + nr_sects - r->sector;
+		}
+	} else {
+		new->sector = sector;
+		new->nr_sects = nr_sects;
+		list_add(&new->list, pos);
+		dd->nr_ranges++;
+		dd->nr_sects += nr_sects;
+		r = new;
+	}
+
+	/* swallow the following ranges that now touch @r */
+	next = list_entry(r->list.next, struct discard_range, list);
+	while (&next->list != &dd->ranges &&
+	       next->sector <= r->sector + r->nr_sects) {
+		struct discard_range *tmp;
+
+		if (next->sector + next->nr_sects > r->sector + r->nr_sects) {
+			dd->nr_sects -= r->sector + r->nr_sects - next->sector;
+			r->nr_sects = next->sector + next->nr_sects -
+				      r->sector;
+		} else {
+			dd->nr_sects -= next->nr_sects;
+		}
+		tmp = list_entry(next->list.next, struct discard_range, list);
+		list_del(&next->list);
+		kfree(next);
+		dd->nr_ranges--;
+		next = tmp;
+	}
+	spin_unlock(&dd->lock);
+
+	queue_delayed_work(system_nrt_wq, &dd->work,
+			   discard_screen_off ? 0 :
+			   msecs_to_jiffies(dd->idle_ms));
+	return true;
+}
+
+/* Called with dd->lock held. */
+static int __discard_issuing(struct discard_data *dd, sector_t start,
+			     sector_t end)
+{
+	return dd->issue_nr_sects && start < dd->issue_sector +
+	       dd->issue_nr_sects && dd->issue_sector < end;
+}
+
+static int discard_issuing(struct discard_data *dd, sector_t start,
+			   sector_t end)
+{
+	int ret;
+
+	spin_lock(&dd->lock);
+	ret = __discard_issuing(dd, start, end);
+	spin_unlock(&dd->lock);
+	return ret;
+}
+
+/*
+ * Called for every bio submitted to @q, after partition remapping.
+ * Notes the queue activity and makes sure that no pending or running
+ * discard overlaps a write.
+ */
+void blk_discard_defer_bio(struct request_queue *q, struct bio *bio)
+{
+	struct discard_data *dd = q->discard_data;
+	struct discard_range *r, *tmp, *tail;
+	sector_t start, end;
+
+	if (!dd || (bio->bi_rw & REQ_DISCARD))
+		return;
+
+	if (dd->last_io != jiffies)
+		dd->last_io = jiffies;
+
+	if (!(bio->bi_rw & REQ_WRITE) || !bio_sectors(bio))
+		return;
+
+	start = bio->bi_sector;
+	end = start + bio_sectors(bio);
+
+	/*
+	 * Check and trim under one hold of the lock, so the work function
+	 * cannot start discarding an overlapping range in between.
+	 */
+	spin_lock(&dd->lock);
+	while (__discard_issuing(dd, start, end)) {
+		spin_unlock(&dd->lock);
+		wait_event(dd->wait, !discard_issuing(dd, start, end));
+		spin_lock(&dd->lock);
+	}
+	list_for_each_entry_safe(r, tmp, &dd->ranges, list) {
+		if (r->sector >= end)
+			break;
+		if (r->sector + r->nr_sects <= start)
+			continue;
+
+		if (r->sector >= start && r->sector + r->nr_sects <= end) {
+			dd->nr_sects -= r->nr_sects;
+			list_del(&r->list);
+			kfree(r);
+			dd->nr_ranges--;
+		} else if (r->sector >= start) {
+			dd->nr_sects -= end - r->sector;
+			r->nr_sects -= end - r->sector;
+			r->sector = end;
+		} else if (r->sector + r->nr_sects <= end) {
+			dd->nr_sects -= r->sector + r->nr_sects - start;
+			r->nr_sects = start - r->sector;
+		} else {
+			/* the write splits @r; on no memory drop the tail */
+			tail = kmalloc(sizeof(*tail), GFP_ATOMIC);
+			if (tail) {
+				tail->sector = end;
+				tail->nr_sects = r->sector + r->nr_sects - end;
+				list_add(&tail->list, &r->list);
+				dd->nr_ranges++;
+				dd->nr_sects -= end - start;
+			} else {
+				dd->nr_sects -= r->sector + r->nr_sects - start;
+			}
+			r->nr_sects = start - r->sector;
+			break;
+		}
+	}
+	spin_unlock(&dd->lock);
+}
+
+/**
+ * blk_discard_defer_flush - issue all deferred discards of a queue
+ * @q:		the request queue
+ *
+ * Description:
+ *    Sends the pending discards to the device without waiting for it to
+ *    become idle, and returns once they have been issued.
+ */
+void blk_discard_defer_flush(struct request_queue *q)
+{
+	struct discard_data *dd = q->discard_data;
+
+	if (!dd)
+		return;
+
+	spin_lock(&dd->lock);
+	dd->flush = 1;
+	spin_unlock(&dd->lock);
+	discard_kick(dd);
+
+	wait_event(dd->wait, !dd->nr_ranges && !dd->issue_nr_sects);
+}
+EXPORT_SYMBOL(blk_discard_defer_flush);
+
+/**
+ * blk_queue_discard_defer - enable or disable discard deferral
+ * @q:		the request queue
+ * @enable:	defer discards to idle periods
+ *
+ * Description:
+ *    Drivers for devices on which discards are slow enough to delay
+ *    other I/O can call this to defer discards by default.  A deferred
+ *    discard does not zero the range right away, so discard_zeroes_data
+ *    is cleared while deferral is enabled.  Disabling issues the
+ *    discards still pending.
+ */
+void blk_queue_discard_defer(struct request_queue *q, bool enable)
+{
+	struct discard_data *dd = q->discard_data;
+
+	if (!dd || dd->enabled == enable)
+		return;
+
+	if (enable) {
+		dd->zeroes_data = q->limits.discard_zeroes_data;
+		q->limits.discard_zeroes_data = 0;
+		dd->enabled = 1;
+	} else {
+		dd->enabled = 0;
+		blk_discard_defer_flush(q);
+		q->limits.discard_zeroes_data = dd->zeroes_data;
+	}
+}
+EXPORT_SYMBOL(blk_queue_discard_defer);
+
+ssize_t blk_discard_defer_show(struct request_queue *q, char *page)
+{
+	return sprintf(page, "%u\n", q->discard_data->enabled);
+}
+
+ssize_t blk_discard_defer_store(struct request_queue *q, const char *page,
+				size_t count)
+{
+	unsigned long val;
+	int ret = strict_strtoul(page, 10, &val);
+
+	if (ret < 0)
+		return ret;
+	blk_queue_discard_defer(q, !!val);
+	return count;
+}
+
+ssize_t blk_discard_idle_show(struct request_queue *q, char *page)
+{
+	return sprintf(page, "%u\n", q->discard_data->idle_ms);
+}
+
+ssize_t blk_discard_idle_store(struct request_queue *q, const char *page,
+			       size_t count)
+{
+	unsigned long val;
+	int ret = strict_strtoul(page, 10, &val);
+
+	if (ret < 0)
+		return ret;
+	q->discard_data->idle_ms = val;
+	return count;
+}
+
+ssize_t blk_discard_pending_show(struct request_queue *q, char *page)
+{
+	struct discard_data *dd = q->discard_data;
+	unsigned int nr_ranges;
+	unsigned long long nr_sects;
+
+	spin_lock(&dd->lock);
+	nr_ranges = dd->nr_ranges;
+	nr_sects = dd->nr_sects;
+	spin_unlock(&dd->lock);
+
+	return sprintf(page, "%u %llu\n", nr_ranges, nr_sects);
+}
+
+ssize_t blk_discard_pending_store(struct request_queue *q, const char *page,
+				  size_t count)
+{
+	blk_discard_defer_flush(q);
+	return count;
+}
+
+int blk_discard_defer_init(struct request_queue *q)
+{
+	struct discard_data *dd;
+
+	dd = kzalloc_node(sizeof(*dd), GFP_KERNEL, q->node);
+	if (!dd)
+		return -ENOMEM;
+
+	dd->queue = q;
+	spin_lock_init(&dd->lock);
+	INIT_LIST_HEAD(&dd->ranges);
+	init_waitqueue_head(&dd->wait);
+	INIT_DELAYED_WORK(&dd->work, discard_work_fn);
+	dd->last_io = jiffies;
+	dd->idle_ms = DISCARD_IDLE_MS;
+
+	mutex_lock(&discard_queues_lock);
+	list_add(&dd->node, &discard_queues);
+	mutex_unlock(&discard_queues_lock);
+
+	q->discard_data = dd;
+	return 0;
+}
+
+void blk_discard_defer_exit(struct request_queue *q)
+{
+	struct discard_data *dd = q->discard_data;
+
+	if (!dd)
+		return;
+
+	mutex_lock(&discard_queues_lock);
+	list_del(&dd->node);
+	mutex_unlock(&discard_queues_lock);
+
+	cancel_delayed_work_sync(&dd->work);
+	discard_drop_all(dd);
+	if (dd->disk)
+		put_disk(dd->disk);
+
+	q->discard_data = NULL;
+	kfree(dd);
+}
+
+#ifdef CONFIG_HAS_EARLYSUSPEND
+static void discard_set_screen_off(int off)
+{
+	struct discard_data *dd;
+
+	mutex_lock(&discard_queues_lock);
+	discard_screen_off = off;
+	if (off)
+		list_for_each_entry(dd, &discard_queues, node)
+			if (dd->nr_ranges)
+				discard_kick(dd);
+	mutex_unlock(&discard_queues_lock);
+}
+
+static void discard_early_suspend(struct early_suspend *h)
+{
+	discard_set_screen_off(1);
+}
+
+static void discard_late_resume(struct early_suspend *h)
+{
+	discard_set_screen_off(0);
+}
+
+static struct early_suspend discard_early_suspend_handler = {
+	.level = EARLY_SUSPEND_LEVEL_DISABLE_FB,
+	.suspend = discard_early_suspend,
+	.resume = discard_late_resume,
+};
+
+static int __init blk_discard_defer_setup(void)
+{
+	register_early_suspend(&discard_early_suspend_handler);
+	return 0;
+}
+late_initcall(blk_discard_defer_setup);
+#endif
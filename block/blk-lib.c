@@ -23,18 +23,7 @@ static void blkdev_discard_end_io(struct bio *bio, int err)
 	bio_put(bio);
 }
 
-/**
- * blkdev_issue_discard - queue a discard
- * @bdev:	blockdev to issue discard for
- * @sector:	start sector
- * @nr_sects:	number of sectors to discard
- * @gfp_mask:	memory allocation flags (for bio_alloc)
- * @flags:	BLKDEV_IFL_* flags to control behaviour
- *
- * Description:
- *    Issue a discard request for the sectors in question.
- */
-int blkdev_issue_discard(struct block_device *bdev, sector_t sector,
+int __blkdev_issue_discard(struct block_device *bdev, sector_t sector,
 		sector_t nr_sects, gfp_t gfp_mask, unsigned long flags)
 {
 	DECLARE_COMPLETION_ONSTACK(wait);
@@ -102,6 +91,31 @@ int blkdev_issue_discard(struct block_device *bdev, sector_t sector,
 
 	return ret;
 }
+
+/**
+ * blkdev_issue_discard - queue a discard
+ * @bdev:	blockdev to issue discard for
+ * @sector:	start sector
+ * @nr_sects:	number of sectors to discard
+ * @gfp_mask:	memory allocation flags (for bio_alloc)
+ * @flags:	BLKDEV_IFL_* flags to control behaviour
+ *
+ * Description:
+ *    Issue a discard request for the sectors in question.  If the queue
+ *    defers discards, the range is only recorded and is discarded once
+ *    the device is idle.
+ */
+int blkdev_issue_discard(struct block_device *bdev, sector_t sector,
+		sector_t nr_sects, gfp_t gfp_mask, unsigned long flags)
+{
+	struct request_queue *q = bdev_get_queue(bdev);
+
+	if (q && blk_queue_discard(q) && !(flags & BLKDEV_DISCARD_SECURE) &&
+	    blk_discard_defer(bdev, sector, nr_sects, gfp_mask))
+		return 0;
+
+	return __blkdev_issue_discard(bdev, sector, nr_sects, gfp_mask, flags);
+}
 EXPORT_SYMBOL(blkdev_issue_discard);
 
 struct bio_batch
@@ -0,0 +1,278 @@
+/*
+ * Priority based request limiting
+ *
+ * Only CFQ looks at I/O priorities and blkio cgroup weights, so with the
+ * deadline, noop or flash schedulers a background task can fill the
+ * request queue and foreground reads wait behind it.  This works below
+ * any scheduler, at request allocation time.
+ *
+ * Sync requests of RT class tasks, of tasks in a blkio cgroup with a
+ * read latency target, and, when the queue has a default read latency
+ * target, of best effort tasks at normal or higher priority are
+ * protected: they are never held back, and their reads are checked
+ * against the target.  Everything else, including all async writes, is
+ * limited.  When more than one in ten protected reads of a window miss
+ * the target, the number of limited requests allowed on the queue is
+ * halved; windows that meet it raise the limit again, and once it is
+ * back at nr_requests nothing is limited.  Each task may use a share of
+ * the limit in proportion to its cgroup weight, scaled by its best
+ * effort level (the nice value for tasks without an explicit ioprio).
+ *
+ * Limited requests are counted per band of weights with a similar
+ * share, and a share is compared against its own band only, so
+ * requests of heavier tasks do not use up the share of lighter ones.
+ * A band with nothing in flight may always allocate one request, and
+ * the total stays within the limit otherwise.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/blkdev.h>
+#include <linux/ioprio.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+
+#include "blk.h"
+#include "blk-cgroup.h"
+
+#define PRIO_WINDOW_NS		(100 * NSEC_PER_MSEC)
+#define PRIO_NR_BANDS		12	/* fls() of the largest weight + 1 */
+
+struct blk_prio_data {
+	struct request_queue	*queue;
+
+	/* limited requests allocated, and tasks waiting for one */
+	atomic_t		nr_limited;
+	atomic_t		nr_band[PRIO_NR_BANDS];
+	wait_queue_head_t	wait;
+
+	/* under the queue lock */
+	unsigned int		depth;		/* allowed at full weight */
+	u64			window_start;
+	unsigned int		nr_reads;	/* protected, this window */
+	unsigned int		nr_missed;
+
+	/* statistics */
+	unsigned long		total_reads;
+	unsigned long		total_missed;
+	unsigned long		total_waits;
+
+	/* tunables */
+	unsigned int		read_latency_us;
+};
+
+/*
+ * Returns the weight of a request of the current task, or 0 if it is
+ * protected, in which case *target_us is its read latency target.
+ */
+static unsigned int blk_prio_classify(struct blk_prio_data *pd,
+				      unsigned int rw_flags,
+				      unsigned int *target_us)
+{
+	struct io_context *ioc = current->io_context;
+	unsigned int weight, cg_target;
+	int class, level;
+
+	blkio_task_prio(current, &weight, &cg_target);
+	if (ioc && ioprio_valid(ioc->ioprio)) {
+		class = IOPRIO_PRIO_CLASS(ioc->ioprio);
+		level = IOPRIO_PRIO_DATA(ioc->ioprio);
+	} else {
+		class = task_nice_ioclass(current);
+		level = task_nice_ioprio(current);
+	}
+
+	*target_us = cg_target ? cg_target : pd->read_latency_us;
+
+	if (!rw_is_sync(rw_flags))
+		return BLKIO_WEIGHT_MIN;
+	if (class == IOPRIO_CLASS_RT)
+		return 0;
+	if (class == IOPRIO_CLASS_IDLE)
+		return 1;
+	if (cg_target || (pd->read_latency_us && level <= IOPRIO_NORM))
+		return 0;
+
+	level = clamp(level, 0, IOPRIO_BE_NR - 1);
+	return max_t(unsigned int, 1, weight * (IOPRIO_BE_NR - level) /
+				      (IOPRIO_BE_NR - IOPRIO_NORM));
+}
+
+static inline atomic_t *blk_prio_band(struct blk_prio_data *pd,
+				      unsigned int weight)
+{
+	return &pd->nr_band[min(fls(weight), PRIO_NR_BANDS - 1)];
+}
+
+/* Whether a request of this weight would go over the limit. */
+static bool blk_prio_over_limit(struct blk_prio_data *pd,
+				unsigned int weight)
+{
+	unsigned int in_band = atomic_read(blk_prio_band(pd, weight));
+	unsigned int share;
+
+	if (pd->depth >= pd->queue->nr_requests || !in_band)
+		return false;
+	if (atomic_read(&pd->nr_limited) >= pd->depth)
+		return true;
+	share = max_t(unsigned int, 1, pd->depth * weight / BLKIO_WEIGHT_MAX);
+	return in_band >= share;
+}
+
+/* queue lock must be held */
+static void blk_prio_update_window(struct blk_prio_data *pd, u64 now)
+{
+	unsigned int max = pd->queue->nr_requests;
+	unsigned int depth = min(max, pd->depth);
+
+	if (now - pd->window_start < PRIO_WINDOW_NS)
+		return;
+
+	if (!pd->nr_reads)
+		pd->depth = min(max, depth * 2);
+	else if (pd->nr_missed * 10 > pd->nr_reads)
+		pd->depth = max(1U, depth / 2);
+	else
+		pd->depth = min(max, depth + max / 16 + 1);
+
+	pd->nr_reads = 0;
+	pd->nr_missed = 0;
+	pd->window_start = now;
+
+	if (waitqueue_active(&pd->wait))
+		wake_up(&pd->wait);
+}
+
+/*
+ * Wait until a request of the current task fits under the limit.  Called
+ * with the queue lock held, which may be dropped while sleeping.
+ */
+void blk_prio_throttle(struct request_queue *q, unsigned int rw_flags)
+{
+	struct blk_prio_data *pd = q->prio_data;
+	unsigned int weight, target_us;
+
+	if (!pd)
+		return;
+
+	weight = blk_prio_classify(pd, rw_flags, &target_us);
+	if (!weight)
+		return;
+
+	blk_prio_update_window(pd, sched_clock());
+	while (blk_prio_over_limit(pd, weight)) {
+		DEFINE_WAIT(wait);
+
+		prepare_to_wait(&pd->wait, &wait, TASK_UNINTERRUPTIBLE);
+		pd->total_waits++;
+
+		__generic_unplug_device(q);
+		spin_unlock_irq(q->queue_lock);
+		/* a window may end with nothing completing */
+		io_schedule_timeout(nsecs_to_jiffies(PRIO_WINDOW_NS) + 1);
+		spin_lock_irq(q->queue_lock);
+
+		finish_wait(&pd->wait, &wait);
+		blk_prio_update_window(pd, sched_clock());
+	}
+}
+
+/* Classify a newly allocated request, no locks held. */
+void blk_prio_set_request(struct request_queue *q, struct request *rq)
+{
+	struct blk_prio_data *pd = q->prio_data;
+	unsigned int target_us;
+
+	if (!pd)
+		return;
+
+	rq->prio_weight = blk_prio_classify(pd, rq->cmd_flags, &target_us);
+	if (rq->prio_weight) {
+		atomic_inc(&pd->nr_limited);
+		atomic_inc(blk_prio_band(pd, rq->prio_weight));
+	} else if (rq_data_dir(rq) == READ)
+		rq->prio_target_us = target_us;
+}
+
+/* queue lock must be held */
+void blk_prio_put_request(struct request_queue *q, struct request *rq)
+{
+	struct blk_prio_data *pd = q->prio_data;
+
+	if (!pd || !rq->prio_weight)
+		return;
+
+	atomic_dec(&pd->nr_limited);
+	atomic_dec(blk_prio_band(pd, rq->prio_weight));
+	if (waitqueue_active(&pd->wait))
+		wake_up(&pd->wait);
+}
+
+/* queue lock must be held */
+void blk_prio_done(struct request *rq)
+{
+	struct blk_prio_data *pd = rq->q->prio_data;
+	u64 now;
+
+	if (!pd || !rq->prio_target_us)
+		return;
+
+	now = sched_clock();
+	pd->nr_reads++;
+	pd->total_reads++;
+	if (now - rq_start_time_ns(rq) >
+	    (u64)rq->prio_target_us * NSEC_PER_USEC) {
+		pd->nr_missed++;
+		pd->total_missed++;
+	}
+	blk_prio_update_window(pd, now);
+}
+
+ssize_t blk_prio_latency_show(struct request_queue *q, char *page)
+{
+	return sprintf(page, "%u\n", q->prio_data->read_latency_us);
+}
+
+ssize_t blk_prio_latency_store(struct request_queue *q, const char *page,
+			       size_t count)
+{
+	unsigned long val;
+	int ret = strict_strtoul(page, 10, &val);
+
+	if (ret < 0)
+		return ret;
+	q->prio_data->read_latency_us = val;
+	return count;
+}
+
+ssize_t blk_prio_stat_show(struct request_queue *q, char *page)
+{
+	struct blk_prio_data *pd = q->prio_data;
+
+	return sprintf(page, "%u %d %lu %lu %lu\n",
+		       min_t(unsigned int, pd->depth, q->nr_requests),
+		       atomic_read(&pd->nr_limited), pd->total_reads,
+		       pd->total_missed, pd->total_waits);
+}
+
+int blk_prio_init(struct request_queue *q)
+{
+	struct blk_prio_data *pd;
+
+	pd = kzalloc_node(sizeof(*pd), GFP_KERNEL, q->node);
+	if (!pd)
+		return -ENOMEM;
+
+	pd->queue = q;
+	atomic_set(&pd->nr_limited, 0);
+	init_waitqueue_head(&pd->wait);
+	pd->depth = UINT_MAX;
+
+	q->prio_data = pd;
+	return 0;
+}
+
+void blk_prio_exit(struct request_queue *q)
+{
+	kfree(q->prio_data);
+	q->prio_data = NULL;
+}
@@ -379,6 +379,39 @@ static struct queue_sysfs_entry queue_random_entry = {
 	.store = queue_store_random,
 };
 
+#ifdef CONFIG_BLK_DEV_PRIO
+static struct queue_sysfs_entry queue_prio_latency_entry = {
+	.attr = {.name = "prio_read_latency_us", .mode = S_IRUGO | S_IWUSR },
+	.show = blk_prio_latency_show,
+	.store = blk_prio_latency_store,
+};
+
+static struct queue_sysfs_entry queue_prio_stat_entry = {
+	.attr = {.name = "prio_stat", .mode = S_IRUGO },
+	.show = blk_prio_stat_show,
+};
+#endif
+
+#ifdef CONFIG_BLK_DEV_DISCARD_DEFER
+static struct queue_sysfs_entry queue_discard_defer_entry = {
+	.attr = {.name = "discard_defer", .mode = S_IRUGO | S_IWUSR },
+	.show = blk_discard_defer_show,
+	.store = blk_discard_defer_store,
+};
+
+static struct queue_sysfs_entry queue_discard_idle_entry = {
+	.attr = {.name = "discard_idle_ms", .mode = S_IRUGO | S_IWUSR },
+	.show = blk_discard_idle_show,
+	.store = blk_discard_idle_store,
+};
+
+static struct queue_sysfs_entry queue_discard_pending_entry = {
+	.attr = {.name = "discard_pending", .mode = S_IRUGO | S_IWUSR },
+	.show = blk_discard_pending_show,
+	.store = blk_discard_pending_store,
+};
+#endif
+
 static struct attribute *default_attrs[] = {
 	&queue_requests_entry.attr,
 	&queue_ra_entry.attr,
@@ -401,6 +434,15 @@ static struct attribute *default_attrs[] = {
 	&queue_rq_affinity_entry.attr,
 	&queue_iostats_entry.attr,
 	&queue_random_entry.attr,
+#ifdef CONFIG_BLK_DEV_PRIO
+	&queue_prio_latency_entry.attr,
+	&queue_prio_stat_entry.attr,
+#endif
+#ifdef CONFIG_BLK_DEV_DISCARD_DEFER
+	&queue_discard_defer_entry.attr,
+	&queue_discard_idle_entry.attr,
+	&queue_discard_pending_entry.attr,
+#endif
 	NULL,
 };
 
@@ -472,6 +514,8 @@ static void blk_release_queue(struct kobject *kobj)
 	blk_sync_queue(q);
 
 	blk_throtl_exit(q);
+	blk_discard_defer_exit(q);
+	blk_prio_exit(q);
 
 	if (rl->rq_pool)
 		mempool_destroy(rl->rq_pool);
@@ -119,6 +119,65 @@ int blk_dev_init(void);
 void elv_quiesce_start(struct request_queue *q);
 void elv_quiesce_end(struct request_queue *q);
 
+int __blkdev_issue_discard(struct block_device *bdev, sector_t sector,
+		sector_t nr_sects, gfp_t gfp_mask, unsigned long flags);
+
+#ifdef CONFIG_BLK_DEV_PRIO
+int blk_prio_init(struct request_queue *q);
+void blk_prio_exit(struct request_queue *q);
+void blk_prio_throttle(struct request_queue *q, unsigned int rw_flags);
+void blk_prio_set_request(struct request_queue *q, struct request *rq);
+void blk_prio_put_request(struct request_queue *q, struct request *rq);
+void blk_prio_done(struct request *rq);
+ssize_t blk_prio_latency_show(struct request_queue *q, char *page);
+ssize_t blk_prio_latency_store(struct request_queue *q, const char *page,
+			       size_t count);
+ssize_t blk_prio_stat_show(struct request_queue *q, char *page);
+#else
+static inline int blk_prio_init(struct request_queue *q)
+{
+	return 0;
+}
+static inline void blk_prio_exit(struct request_queue *q) {}
+static inline void blk_prio_throttle(struct request_queue *q,
+				     unsigned int rw_flags) {}
+static inline void blk_prio_set_request(struct request_queue *q,
+					struct request *rq) {}
+static inline void blk_prio_put_request(struct request_queue *q,
+					struct request *rq) {}
+static inline void blk_prio_done(struct request *rq) {}
+#endif
+
+#ifdef CONFIG_BLK_DEV_DISCARD_DEFER
+int blk_discard_defer_init(struct request_queue *q);
+void blk_discard_defer_exit(struct request_queue *q);
+void blk_discard_defer_bio(struct request_queue *q, struct bio *bio);
+bool blk_discard_defer(struct block_device *bdev, sector_t sector,
+		       sector_t nr_sects, gfp_t gfp_mask);
+ssize_t blk_discard_defer_show(struct request_queue *q, char *page);
+ssize_t blk_discard_defer_store(struct request_queue *q, const char *page,
+				size_t count);
+ssize_t blk_discard_idle_show(struct request_queue *q, char *page);
+ssize_t blk_discard_idle_store(struct request_queue *q, const char *page,
+			       size_t count);
+ssize_t blk_discard_pending_show(struct request_queue *q, char *page);
+ssize_t blk_discard_pending_store(struct request_queue *q, const char *page,
+				  size_t count);
+#else
+static inline int blk_discard_defer_init(struct request_queue *q)
+{
+	return 0;
+}
+static inline void blk_discard_defer_exit(struct request_queue *q) {}
+static inline void blk_discard_defer_bio(struct request_queue *q,
+					 struct bio *bio) {}
+static inline bool blk_discard_defer(struct block_device *bdev,
+		sector_t sector, sector_t nr_sects, gfp_t gfp_mask)
+{
+	return false;
+}
+#endif
+
 
 /*
  * Return the threshold (number of used requests) at which the queue is
@@ -0,0 +1,438 @@
+/*
+ *  Flash i/o scheduler.
+ *
+ *  Based on the deadline i/o scheduler, Copyright (C) 2002 Jens Axboe.
+ *
+ *  On eMMC and other flash devices there is no seek to optimise for, so
+ *  requests are not sector sorted and the device is never idled.  Sync
+ *  requests (reads and sync writes) are served FIFO ahead of async
+ *  writes, which only get the device after async_starved sync dispatches
+ *  or when their FIFO expires.  Writes are kept in a sector tree and
+ *  dispatched in batches that stay within one erase unit, so the card
+ *  sees a run of writes to the same erase block rather than scattered
+ *  ones interleaved with reads.
+ */
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/blkdev.h>
+#include <linux/elevator.h>
+#include <linux/bio.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/init.h>
+#include <linux/compiler.h>
+#include <linux/log2.h>
+#include <linux/rbtree.h>
+
+static const int sync_expire = HZ / 10;	/* max time before a sync rq runs */
+static const int async_expire = 2 * HZ;	/* ditto for async writes */
+static const int async_starved = 8;	/* max sync rqs before a write batch */
+static const int write_batch = 16;	/* max writes in one batch */
+static const int erase_size_kb = 512;	/* a batch stays within one such unit */
+
+struct flash_data {
+	/*
+	 * run time data
+	 */
+
+	/* all requests, by sync class, in arrival order */
+	struct list_head fifo_list[2];
+	/* writes only, sector sorted */
+	struct rb_root write_tree;
+
+	/* next write of the current batch, in sector order */
+	struct request *next_write;
+	sector_t batch_unit;		/* erase unit of the current batch */
+	unsigned int batching;		/* writes dispatched in this batch */
+	unsigned int starved;		/* times sync has starved async */
+	unsigned int erase_shift;	/* log2 of the erase unit in sectors */
+
+	/*
+	 * settings that change how the i/o scheduler behaves
+	 */
+	int fifo_expire[2];
+	int async_starved;
+	int write_batch;
+	int erase_size_kb;
+	int front_merges;
+};
+
+static inline sector_t flash_erase_unit(struct flash_data *fd,
+					struct request *rq)
+{
+	return blk_rq_pos(rq) >> fd->erase_shift;
+}
+
+static inline struct request *flash_latter_write(struct request *rq)
+{
+	struct rb_node *node = rb_next(&rq->rb_node);
+
+	if (node)
+		return rb_entry_rq(node);
+
+	return NULL;
+}
+
+static void flash_move_request(struct flash_data *, struct request *);
+
+static void flash_add_rq_rb(struct flash_data *fd, struct request *rq)
+{
+	struct request *__alias;
+
+	while (unlikely(__alias = elv_rb_add(&fd->write_tree, rq)))
+		flash_move_request(fd, __alias);
+}
+
+static void flash_del_rq_rb(struct flash_data *fd, struct request *rq)
+{
+	if (fd->next_write == rq)
+		fd->next_write = flash_latter_write(rq);
+
+	elv_rb_del(&fd->write_tree, rq);
+}
+
+/*
+ * add rq to fifo, and to the write tree if it is a write
+ */
+static void flash_add_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	const int sync = rq_is_sync(rq);
+
+	if (rq_data_dir(rq) == WRITE)
+		flash_add_rq_rb(fd, rq);
+
+	rq_set_fifo_time(rq, jiffies + fd->fifo_expire[sync]);
+	list_add_tail(&rq->queuelist, &fd->fifo_list[sync]);
+}
+
+static void flash_remove_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	rq_fifo_clear(rq);
+	if (rq_data_dir(rq) == WRITE)
+		flash_del_rq_rb(fd, rq);
+}
+
+static int
+flash_merge(struct request_queue *q, struct request **req, struct bio *bio)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	struct request *__rq;
+
+	/*
+	 * check for front merge; only writes are kept sorted
+	 */
+	if (fd->front_merges && bio_data_dir(bio) == WRITE) {
+		sector_t sector = bio->bi_sector + bio_sectors(bio);
+
+		__rq = elv_rb_find(&fd->write_tree, sector);
+		if (__rq) {
+			BUG_ON(sector != blk_rq_pos(__rq));
+
+			if (elv_rq_merge_ok(__rq, bio)) {
+				*req = __rq;
+				return ELEVATOR_FRONT_MERGE;
+			}
+		}
+	}
+
+	return ELEVATOR_NO_MERGE;
+}
+
+static void flash_merged_request(struct request_queue *q,
+				 struct request *req, int type)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	/*
+	 * if the merge was a front merge, we need to reposition request
+	 */
+	if (type == ELEVATOR_FRONT_MERGE && rq_data_dir(req) == WRITE) {
+		elv_rb_del(&fd->write_tree, req);
+		flash_add_rq_rb(fd, req);
+	}
+}
+
+static void
+flash_merged_requests(struct request_queue *q, struct request *req,
+		      struct request *next)
+{
+	/*
+	 * if next expires before rq, assign its expire time to rq
+	 * and move into next position (next will be deleted) in fifo
+	 */
+	if (!list_empty(&req->queuelist) && !list_empty(&next->queuelist)) {
+		if (time_before(rq_fifo_time(next), rq_fifo_time(req))) {
+			list_move(&req->queuelist, &next->queuelist);
+			rq_set_fifo_time(req, rq_fifo_time(next));
+		}
+	}
+
+	flash_remove_request(q, next);
+}
+
+static struct request *
+flash_former_request(struct request_queue *q, struct request *rq)
+{
+	if (rq_data_dir(rq) != WRITE)
+		return NULL;
+	return elv_rb_former_request(q, rq);
+}
+
+static struct request *
+flash_latter_request(struct request_queue *q, struct request *rq)
+{
+	if (rq_data_dir(rq) != WRITE)
+		return NULL;
+	return elv_rb_latter_request(q, rq);
+}
+
+/*
+ * move request to the dispatch queue; a write batch continues from the
+ * next write in sector order
+ */
+static void flash_move_request(struct flash_data *fd, struct request *rq)
+{
+	struct request_queue *q = rq->q;
+
+	fd->next_write = NULL;
+	if (rq_data_dir(rq) == WRITE)
+		fd->next_write = flash_latter_write(rq);
+
+	flash_remove_request(q, rq);
+	elv_dispatch_add_tail(q, rq);
+}
+
+/*
+ * returns 1 if the oldest request of the sync class has expired.
+ * Requires !list_empty(&fd->fifo_list[sync])
+ */
+static inline int flash_check_fifo(struct flash_data *fd, int sync)
+{
+	struct request *rq = rq_entry_fifo(fd->fifo_list[sync].next);
+
+	return time_after(jiffies, rq_fifo_time(rq));
+}
+
+static int flash_dispatch_requests(struct request_queue *q, int force)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	const int sync = !list_empty(&fd->fifo_list[BLK_RW_SYNC]);
+	const int async = !list_empty(&fd->fifo_list[BLK_RW_ASYNC]);
+	struct request *rq;
+
+	/*
+	 * an expired sync request ends the current write batch
+	 */
+	if (sync && flash_check_fifo(fd, BLK_RW_SYNC))
+		goto dispatch_sync;
+
+	/*
+	 * continue the write batch while it stays in the same erase unit
+	 */
+	rq = fd->next_write;
+	if (rq && fd->batching < fd->write_batch &&
+	    flash_erase_unit(fd, rq) == fd->batch_unit)
+		goto dispatch_write;
+
+	if (async && flash_check_fifo(fd, BLK_RW_ASYNC))
+		goto dispatch_async;
+
+	if (sync && (!async || fd->starved++ < fd->async_starved))
+		goto dispatch_sync;
+
+	if (async)
+		goto dispatch_async;
+
+	return 0;
+
+dispatch_sync:
+	rq = rq_entry_fifo(fd->fifo_list[BLK_RW_SYNC].next);
+	flash_move_request(fd, rq);
+	fd->batching = fd->write_batch;
+	return 1;
+
+dispatch_async:
+	/*
+	 * start a new batch from the oldest async write
+	 */
+	rq = rq_entry_fifo(fd->fifo_list[BLK_RW_ASYNC].next);
+	fd->starved = 0;
+	fd->batching = 0;
+	fd->batch_unit = flash_erase_unit(fd, rq);
+
+dispatch_write:
+	fd->batching++;
+	flash_move_request(fd, rq);
+	return 1;
+}
+
+static int flash_queue_empty(struct request_queue *q)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	return list_empty(&fd->fifo_list[BLK_RW_SYNC])
+		&& list_empty(&fd->fifo_list[BLK_RW_ASYNC]);
+}
+
+static void flash_exit_queue(struct elevator_queue *e)
+{
+	struct flash_data *fd = e->elevator_data;
+
+	BUG_ON(!list_empty(&fd->fifo_list[BLK_RW_SYNC]));
+	BUG_ON(!list_empty(&fd->fifo_list[BLK_RW_ASYNC]));
+
+	kfree(fd);
+}
+
+static void flash_set_erase_size(struct flash_data *fd, int kb)
+{
+	fd->erase_size_kb = rounddown_pow_of_two(kb);
+	fd->erase_shift = ilog2(fd->erase_size_kb) + 1;	/* 2 sectors/KB */
+}
+
+/*
+ * initialize elevator private data (flash_data).
+ */
+static void *flash_init_queue(struct request_queue *q)
+{
+	struct flash_data *fd;
+
+	fd = kmalloc_node(sizeof(*fd), GFP_KERNEL | __GFP_ZERO, q->node);
+	if (!fd)
+		return NULL;
+
+	INIT_LIST_HEAD(&fd->fifo_list[BLK_RW_SYNC]);
+	INIT_LIST_HEAD(&fd->fifo_list[BLK_RW_ASYNC]);
+	fd->write_tree = RB_ROOT;
+	fd->fifo_expire[BLK_RW_SYNC] = sync_expire;
+	fd->fifo_expire[BLK_RW_ASYNC] = async_expire;
+	fd->async_starved = async_starved;
+	fd->write_batch = write_batch;
+	fd->front_merges = 1;
+	flash_set_erase_size(fd, erase_size_kb);
+	return fd;
+}
+
+/*
+ * sysfs parts below
+ */
+
+static ssize_t
+flash_var_show(int var, char *page)
+{
+	return sprintf(page, "%d\n", var);
+}
+
+static ssize_t
+flash_var_store(int *var, const char *page, size_t count)
+{
+	char *p = (char *) page;
+
+	*var = simple_strtol(p, &p, 10);
+	return count;
+}
+
+#define SHOW_FUNCTION(__FUNC, __VAR, __CONV)				\
+static ssize_t __FUNC(struct elevator_queue *e, char *page)		\
+{									\
+	struct flash_data *fd = e->elevator_data;			\
+	int __data = __VAR;						\
+	if (__CONV)							\
+		__data = jiffies_to_msecs(__data);			\
+	return flash_var_show(__data, (page));				\
+}
+SHOW_FUNCTION(flash_sync_expire_show, fd->fifo_expire[BLK_RW_SYNC], 1);
+SHOW_FUNCTION(flash_async_expire_show, fd->fifo_expire[BLK_RW_ASYNC], 1);
+SHOW_FUNCTION(flash_async_starved_show, fd->async_starved, 0);
+SHOW_FUNCTION(flash_write_batch_show, fd->write_batch, 0);
+SHOW_FUNCTION(flash_erase_size_kb_show, fd->erase_size_kb, 0);
+SHOW_FUNCTION(flash_front_merges_show, fd->front_merges, 0);
+#undef SHOW_FUNCTION
+
+#define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
+static ssize_t __FUNC(struct elevator_queue *e, const char *page, size_t count)	\
+{									\
+	struct flash_data *fd = e->elevator_data;			\
+	int __data;							\
+	int ret = flash_var_store(&__data, (page), count);		\
+	if (__data < (MIN))						\
+		__data = (MIN);						\
+	else if (__data > (MAX))					\
+		__data = (MAX);						\
+	if (__CONV)							\
+		*(__PTR) = msecs_to_jiffies(__data);			\
+	else								\
+		*(__PTR) = __data;					\
+	return ret;							\
+}
+STORE_FUNCTION(flash_sync_expire_store, &fd->fifo_expire[BLK_RW_SYNC], 0, INT_MAX, 1);
+STORE_FUNCTION(flash_async_expire_store, &fd->fifo_expire[BLK_RW_ASYNC], 0, INT_MAX, 1);
+STORE_FUNCTION(flash_async_starved_store, &fd->async_starved, 0, INT_MAX, 0);
+STORE_FUNCTION(flash_write_batch_store, &fd->write_batch, 1, INT_MAX, 0);
+STORE_FUNCTION(flash_front_merges_store, &fd->front_merges, 0, 1, 0);
+#undef STORE_FUNCTION
+
+static ssize_t flash_erase_size_kb_store(struct elevator_queue *e,
+					 const char *page, size_t count)
+{
+	struct flash_data *fd = e->elevator_data;
+	int __data;
+	int ret = flash_var_store(&__data, (page), count);
+
+	flash_set_erase_size(fd, clamp(__data, 4, 64 * 1024));
+	return ret;
+}
+
+#define FLASH_ATTR(name) \
+	__ATTR(name, S_IRUGO|S_IWUSR, flash_##name##_show, \
+				      flash_##name##_store)
+
+static struct elv_fs_entry flash_attrs[] = {
+	FLASH_ATTR(sync_expire),
+	FLASH_ATTR(async_expire),
+	FLASH_ATTR(async_starved),
+	FLASH_ATTR(write_batch),
+	FLASH_ATTR(erase_size_kb),
+	FLASH_ATTR(front_merges),
+	__ATTR_NULL
+};
+
+static struct elevator_type iosched_flash = {
+	.ops = {
+		.elevator_merge_fn = 		flash_merge,
+		.elevator_merged_fn =		flash_merged_request,
+		.elevator_merge_req_fn =	flash_merged_requests,
+		.elevator_dispatch_fn =		flash_dispatch_requests,
+		.elevator_add_req_fn =		flash_add_request,
+		.elevator_queue_empty_fn =	flash_queue_empty,
+		.elevator_former_req_fn =	flash_former_request,
+		.elevator_latter_req_fn =	flash_latter_request,
+		.elevator_init_fn =		flash_init_queue,
+		.elevator_exit_fn =		flash_exit_queue,
+	},
+
+	.elevator_attrs = flash_attrs,
+	.elevator_name = "flash",
+	.elevator_owner = THIS_MODULE,
+};
+
+static int __init flash_init(void)
+{
+	elv_register(&iosched_flash);
+
+	return 0;
+}
+
+static void __exit flash_exit(void)
+{
+	elv_unregister(&iosched_flash);
+}
+
+module_init(flash_init);
+module_exit(flash_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("flash IO scheduler");
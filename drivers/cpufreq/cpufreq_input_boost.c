@@ -0,0 +1,342 @@
+/*
+ * drivers/cpufreq/cpufreq_input_boost.c
+ *
+ * Governor independent frequency boost on touchscreen input.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * Sampling governors only notice a touch at their next sample, which is
+ * usually after the first frame has already been drawn at a low speed.
+ * This driver listens to touchscreen events and, for boost_ms after the
+ * last event, raises policy->min to boost_freq through a CPUFREQ_ADJUST
+ * policy notifier.  Every governor handles a new minimum in its
+ * CPUFREQ_GOV_LIMITS path, so no governor needs its own ramp logic.
+ * Only governors named in the 'governors' tunable are boosted.
+ */
+
+#include <linux/cpu.h>
+#include <linux/cpufreq.h>
+#include <linux/init.h>
+#include <linux/input.h>
+#include <linux/jiffies.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+
+#define DEFAULT_BOOST_FREQ	480000
+#define DEFAULT_BOOST_MS	100
+#define DEFAULT_GOVERNORS	\
+	"interactive smartassV2 ondemand conservative sched"
+
+static unsigned long boost_freq = DEFAULT_BOOST_FREQ;
+static unsigned long boost_ms = DEFAULT_BOOST_MS;
+static char boost_governors[CPUFREQ_NAME_LEN * 6] = DEFAULT_GOVERNORS;
+
+static DEFINE_SPINLOCK(boost_lock);
+static bool boost_active;
+static unsigned long boost_start;	/* jiffies */
+static unsigned long boost_end;		/* jiffies */
+
+/* Statistics */
+static unsigned long boost_count;
+static u64 boost_time_ms;
+
+static struct workqueue_struct *boost_wq;
+static void boost_on_work_fn(struct work_struct *work);
+static void boost_off_work_fn(struct work_struct *work);
+static DECLARE_WORK(boost_on_work, boost_on_work_fn);
+static DECLARE_DELAYED_WORK(boost_off_work, boost_off_work_fn);
+
+static bool boost_governor_enabled(const char *name)
+{
+	const char *p = boost_governors;
+	size_t len = strlen(name);
+
+	while (*p) {
+		p = skip_spaces(p);
+		if (!strncmp(p, name, len) && (p[len] == ' ' || !p[len] ||
+					       p[len] == '\n'))
+			return true;
+		while (*p && *p != ' ')
+			p++;
+	}
+	return false;
+}
+
+static void boost_update_policies(void)
+{
+	unsigned int cpu;
+
+	get_online_cpus();
+	for_each_online_cpu(cpu)
+		cpufreq_update_policy(cpu);
+	put_online_cpus();
+}
+
+static void boost_on_work_fn(struct work_struct *work)
+{
+	boost_update_policies();
+	queue_delayed_work(boost_wq, &boost_off_work,
+			   msecs_to_jiffies(boost_ms));
+}
+
+static void boost_off_work_fn(struct work_struct *work)
+{
+	unsigned long flags, now = jiffies;
+
+	spin_lock_irqsave(&boost_lock, flags);
+	if (time_before(now, boost_end)) {
+		/* input arrived while boosted; extend */
+		spin_unlock_irqrestore(&boost_lock, flags);
+		queue_delayed_work(boost_wq, &boost_off_work,
+				   boost_end - now);
+		return;
+	}
+	boost_active = false;
+	boost_time_ms += jiffies_to_msecs(now - boost_start);
+	spin_unlock_irqrestore(&boost_lock, flags);
+
+	boost_update_policies();
+}
+
+static int boost_adjust_notify(struct notifier_block *nb, unsigned long val,
+			       void *data)
+{
+	struct cpufreq_policy *policy = data;
+
+	if (val != CPUFREQ_ADJUST || !boost_active)
+		return NOTIFY_OK;
+	if (!policy->governor ||
+	    !boost_governor_enabled(policy->governor->name))
+		return NOTIFY_OK;
+
+	cpufreq_verify_within_limits(policy, min_t(unsigned int, boost_freq,
+				     policy->max), UINT_MAX);
+	return NOTIFY_OK;
+}
+
+static struct notifier_block boost_adjust_nb = {
+	.notifier_call = boost_adjust_notify,
+};
+
+static void boost_input_event(struct input_handle *handle, unsigned int type,
+			      unsigned int code, int value)
+{
+	unsigned long flags;
+
+	if (!boost_freq || !boost_ms)
+		return;
+
+	spin_lock_irqsave(&boost_lock, flags);
+	boost_end = jiffies + msecs_to_jiffies(boost_ms);
+	if (!boost_active) {
+		boost_active = true;
+		boost_start = jiffies;
+		boost_count++;
+		queue_work(boost_wq, &boost_on_work);
+	}
+	spin_unlock_irqrestore(&boost_lock, flags);
+}
+
+static int boost_input_connect(struct input_handler *handler,
+		struct input_dev *dev, const struct input_device_id *id)
+{
+	struct input_handle *handle;
+	int error;
+
+	handle = kzalloc(sizeof(struct input_handle), GFP_KERNEL);
+	if (!handle)
+		return -ENOMEM;
+
+	handle->dev = dev;
+	handle->handler = handler;
+	handle->name = "cpufreq_input_boost";
+
+	error = input_register_handle(handle);
+	if (error)
+		goto err2;
+
+	error = input_open_device(handle);
+	if (error)
+		goto err1;
+
+	return 0;
+err1:
+	input_unregister_handle(handle);
+err2:
+	kfree(handle);
+	return error;
+}
+
+static void boost_input_disconnect(struct input_handle *handle)
+{
+	input_close_device(handle);
+	input_unregister_handle(handle);
+	kfree(handle);
+}
+
+/* Multi-touch panels (synaptics_i2c_rmi4, melfas_ts) and single touch. */
+static const struct input_device_id boost_ids[] = {
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT |
+			 INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.evbit = { BIT_MASK(EV_ABS) },
+		.absbit = { [BIT_WORD(ABS_MT_POSITION_X)] =
+			    BIT_MASK(ABS_MT_POSITION_X) },
+	},
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_KEYBIT |
+			 INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.keybit = { [BIT_WORD(BTN_TOUCH)] = BIT_MASK(BTN_TOUCH) },
+		.absbit = { [BIT_WORD(ABS_X)] = BIT_MASK(ABS_X) },
+	},
+	{ },
+};
+
+static struct input_handler boost_input_handler = {
+	.event		= boost_input_event,
+	.connect	= boost_input_connect,
+	.disconnect	= boost_input_disconnect,
+	.name		= "cpufreq_input_boost",
+	.id_table	= boost_ids,
+};
+
+#define show_store_one(name)						\
+static ssize_t show_##name(struct kobject *kobj,			\
+			   struct attribute *attr, char *buf)		\
+{									\
+	return sprintf(buf, "%lu\n", name);				\
+}									\
+									\
+static ssize_t store_##name(struct kobject *kobj,			\
+		struct attribute *attr, const char *buf, size_t count)	\
+{									\
+	unsigned long val;						\
+	int ret = strict_strtoul(buf, 0, &val);				\
+									\
+	if (ret < 0)							\
+		return ret;						\
+	name = val;							\
+	return count;							\
+}									\
+									\
+static struct global_attr name##_attr = __ATTR(name, 0644,		\
+		show_##name, store_##name)
+
+show_store_one(boost_freq);
+show_store_one(boost_ms);
+
+static ssize_t show_governors(struct kobject *kobj,
+			      struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%s\n", boost_governors);
+}
+
+static ssize_t store_governors(struct kobject *kobj,
+		struct attribute *attr, const char *buf, size_t count)
+{
+	if (count >= sizeof(boost_governors))
+		return -EINVAL;
+
+	strlcpy(boost_governors, buf, sizeof(boost_governors));
+	strim(boost_governors);
+	return count;
+}
+
+static struct global_attr governors_attr = __ATTR(governors, 0644,
+		show_governors, store_governors);
+
+static ssize_t show_stats(struct kobject *kobj,
+			  struct attribute *attr, char *buf)
+{
+	unsigned long flags, count;
+	u64 time_ms;
+
+	spin_lock_irqsave(&boost_lock, flags);
+	count = boost_count;
+	time_ms = boost_time_ms;
+	if (boost_active)
+		time_ms += jiffies_to_msecs(jiffies - boost_start);
+	spin_unlock_irqrestore(&boost_lock, flags);
+
+	return sprintf(buf, "count %lu\ntime_ms %llu\n", count,
+		       (unsigned long long)time_ms);
+}
+
+static struct global_attr stats_attr = __ATTR(stats, 0444,
+		show_stats, NULL);
+
+static struct attribute *boost_attributes[] = {
+	&boost_freq_attr.attr,
+	&boost_ms_attr.attr,
+	&governors_attr.attr,
+	&stats_attr.attr,
+	NULL,
+};
+
+static struct attribute_group boost_attr_group = {
+	.attrs = boost_attributes,
+	.name = "input_boost",
+};
+
+static int __init cpufreq_input_boost_init(void)
+{
+	int rc;
+
+	boost_wq = create_singlethread_workqueue("cpufreq_input_boost");
+	if (!boost_wq)
+		return -ENOMEM;
+
+	rc = cpufreq_register_notifier(&boost_adjust_nb,
+				       CPUFREQ_POLICY_NOTIFIER);
+	if (rc)
+		goto err_wq;
+
+	rc = sysfs_create_group(cpufreq_global_kobject, &boost_attr_group);
+	if (rc)
+		goto err_notifier;
+
+	rc = input_register_handler(&boost_input_handler);
+	if (rc)
+		goto err_sysfs;
+
+	return 0;
+
+err_sysfs:
+	sysfs_remove_group(cpufreq_global_kobject, &boost_attr_group);
+err_notifier:
+	cpufreq_unregister_notifier(&boost_adjust_nb,
+				    CPUFREQ_POLICY_NOTIFIER);
+err_wq:
+	destroy_workqueue(boost_wq);
+	return rc;
+}
+
+static void __exit cpufreq_input_boost_exit(void)
+{
+	input_unregister_handler(&boost_input_handler);
+	cancel_work_sync(&boost_on_work);
+	cancel_delayed_work_sync(&boost_off_work);
+	sysfs_remove_group(cpufreq_global_kobject, &boost_attr_group);
+	cpufreq_unregister_notifier(&boost_adjust_nb,
+				    CPUFREQ_POLICY_NOTIFIER);
+	destroy_workqueue(boost_wq);
+	if (boost_active) {
+		boost_active = false;
+		boost_update_policies();
+	}
+}
+
+late_initcall(cpufreq_input_boost_init);
+module_exit(cpufreq_input_boost_exit);
+
+MODULE_DESCRIPTION("cpufreq boost on touchscreen input");
+MODULE_LICENSE("GPL");
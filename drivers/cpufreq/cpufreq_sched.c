@@ -0,0 +1,365 @@
+/*
+ * drivers/cpufreq/cpufreq_sched.c
+ *
+ * Scheduler driven cpufreq governor.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * Instead of sampling load from a deferrable timer, CFS reports every
+ * enqueue, dequeue and tick through cpufreq_sched_update() with the run
+ * queue lock held.  Busy time is accumulated per CPU over a short window;
+ * at the end of each window a target frequency is computed from the
+ * utilization.  Frequency changes cannot be made with the run queue lock
+ * held, and neither can the thread that makes them be woken.  ARM has no
+ * self IPI to raise an irq_work early, so a change arms a pinned hrtimer
+ * a few microseconds out, like the scheduler's own hrtick, and its
+ * handler wakes a SCHED_FIFO thread that talks to the cpufreq driver.
+ * Without high resolution timers the handler only runs from the next
+ * tick.
+ */
+
+#include <linux/cpu.h>
+#include <linux/cpumask.h>
+#include <linux/cpufreq.h>
+#include <linux/hrtimer.h>
+#include <linux/kthread.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/cpufreq_sched.h>
+
+#define SCHED_UTIL_SCALE	1024
+
+/* Delay of the hrtimer that wakes the change thread. */
+#define SCHED_KICK_NS		2000
+
+struct cpufreq_sched_cpuinfo {
+	struct cpufreq_policy *policy;
+	struct hrtimer kick_timer;
+	u64 last_update;	/* rq clock of the last update, ns */
+	u64 window_start;
+	u64 busy;		/* busy ns in the current window */
+	u64 freq_change_time;
+	unsigned int req_freq;
+	int governor_enabled;
+};
+
+static DEFINE_PER_CPU(struct cpufreq_sched_cpuinfo, cpuinfo);
+
+static struct task_struct *change_task;
+static cpumask_t change_cpumask;
+static DEFINE_SPINLOCK(change_cpumask_lock);
+static atomic_t active_count = ATOMIC_INIT(0);
+
+/* Utilization window. */
+#define DEFAULT_WINDOW_US 10000
+static unsigned long window_us;
+
+/* Utilization, in percent of the current speed, to run at. */
+#define DEFAULT_TARGET_LOAD 80
+static unsigned long target_load;
+
+/* Go to max speed when the CPU was busy at least this long. */
+#define DEFAULT_GO_MAXSPEED_LOAD 95
+static unsigned long go_maxspeed_load;
+
+/* Minimum time to spend at a frequency before ramping down. */
+#define DEFAULT_DOWN_DELAY_US 40000
+static unsigned long down_delay_us;
+
+static int cpufreq_governor_sched(struct cpufreq_policy *policy,
+		unsigned int event);
+
+#ifndef CONFIG_CPU_FREQ_DEFAULT_GOV_SCHED
+static
+#endif
+struct cpufreq_governor cpufreq_gov_sched = {
+	.name = "sched",
+	.governor = cpufreq_governor_sched,
+	.max_transition_latency = 10000000,
+	.owner = THIS_MODULE,
+};
+
+static unsigned int cpufreq_sched_target(struct cpufreq_sched_cpuinfo *pcpu,
+					 unsigned int util, u64 now)
+{
+	struct cpufreq_policy *policy = pcpu->policy;
+	unsigned int cur = policy->cur;
+	unsigned int target;
+
+	if (util * 100 >= go_maxspeed_load * SCHED_UTIL_SCALE)
+		return policy->max;
+
+	target = div_u64((u64)cur * util * 100,
+			 SCHED_UTIL_SCALE * target_load);
+	if (target > policy->max)
+		target = policy->max;
+	if (target < policy->min)
+		target = policy->min;
+
+	if (target < cur &&
+	    now - pcpu->freq_change_time < (u64)down_delay_us * NSEC_PER_USEC)
+		target = cur;
+
+	return target;
+}
+
+/*
+ * Called by the scheduler with the run queue of @cpu locked, before
+ * nr_running is updated, so @nr_running describes the interval since the
+ * previous call.
+ */
+void cpufreq_sched_update(int cpu, unsigned long nr_running, u64 now)
+{
+	struct cpufreq_sched_cpuinfo *pcpu = &per_cpu(cpuinfo, cpu);
+	unsigned int util, target;
+	u64 elapsed;
+
+	if (!pcpu->governor_enabled)
+		return;
+
+	if (now <= pcpu->last_update)
+		return;
+	if (nr_running)
+		pcpu->busy += now - pcpu->last_update;
+	pcpu->last_update = now;
+
+	elapsed = now - pcpu->window_start;
+	if (elapsed < (u64)window_us * NSEC_PER_USEC)
+		return;
+
+	util = div64_u64(min(pcpu->busy, elapsed) * SCHED_UTIL_SCALE,
+			 elapsed);
+	pcpu->window_start = now;
+	pcpu->busy = 0;
+
+	target = cpufreq_sched_target(pcpu, util, now);
+	trace_cpufreq_sched_decision(cpu, util, pcpu->policy->cur, target);
+
+	if (target != pcpu->req_freq) {
+		pcpu->req_freq = target;
+		/* no softirq wakeup, the run queue lock is held */
+		__hrtimer_start_range_ns(&pcpu->kick_timer,
+					 ns_to_ktime(SCHED_KICK_NS), 0,
+					 HRTIMER_MODE_REL_PINNED, 0);
+	}
+}
+
+static enum hrtimer_restart cpufreq_sched_kick(struct hrtimer *timer)
+{
+	struct cpufreq_sched_cpuinfo *pcpu =
+		container_of(timer, struct cpufreq_sched_cpuinfo, kick_timer);
+	unsigned long flags;
+
+	spin_lock_irqsave(&change_cpumask_lock, flags);
+	cpumask_set_cpu(pcpu->policy->cpu, &change_cpumask);
+	spin_unlock_irqrestore(&change_cpumask_lock, flags);
+	wake_up_process(change_task);
+	return HRTIMER_NORESTART;
+}
+
+static int cpufreq_sched_change_task(void *data)
+{
+	struct cpufreq_sched_cpuinfo *pcpu, *pj;
+	unsigned int cpu, j, freq;
+	cpumask_t tmp_mask;
+	unsigned long flags;
+
+	while (1) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		spin_lock_irqsave(&change_cpumask_lock, flags);
+
+		if (cpumask_empty(&change_cpumask)) {
+			spin_unlock_irqrestore(&change_cpumask_lock, flags);
+			schedule();
+
+			if (kthread_should_stop())
+				break;
+
+			spin_lock_irqsave(&change_cpumask_lock, flags);
+		}
+
+		set_current_state(TASK_RUNNING);
+		tmp_mask = change_cpumask;
+		cpumask_clear(&change_cpumask);
+		spin_unlock_irqrestore(&change_cpumask_lock, flags);
+
+		for_each_cpu(cpu, &tmp_mask) {
+			pcpu = &per_cpu(cpuinfo, cpu);
+
+			smp_rmb();
+
+			if (!pcpu->governor_enabled)
+				continue;
+
+			/* CPUs sharing a clock run at the highest request */
+			freq = 0;
+			for_each_cpu(j, pcpu->policy->cpus) {
+				pj = &per_cpu(cpuinfo, j);
+				if (pj->governor_enabled && pj->req_freq > freq)
+					freq = pj->req_freq;
+			}
+
+			__cpufreq_driver_target(pcpu->policy, freq,
+						CPUFREQ_RELATION_L);
+			for_each_cpu(j, pcpu->policy->cpus)
+				per_cpu(cpuinfo, j).freq_change_time =
+					cpu_clock(j);
+		}
+	}
+
+	return 0;
+}
+
+#define show_store_one(name)						\
+static ssize_t show_##name(struct kobject *kobj,			\
+			   struct attribute *attr, char *buf)		\
+{									\
+	return sprintf(buf, "%lu\n", name);				\
+}									\
+									\
+static ssize_t store_##name(struct kobject *kobj,			\
+		struct attribute *attr, const char *buf, size_t count)	\
+{									\
+	unsigned long val;						\
+	int ret = strict_strtoul(buf, 0, &val);				\
+									\
+	if (ret < 0)							\
+		return ret;						\
+	if (!val)							\
+		return -EINVAL;						\
+	name = val;							\
+	return count;							\
+}									\
+									\
+static struct global_attr name##_attr = __ATTR(name, 0644,		\
+		show_##name, store_##name)
+
+show_store_one(window_us);
+show_store_one(target_load);
+show_store_one(go_maxspeed_load);
+show_store_one(down_delay_us);
+
+static struct attribute *sched_attributes[] = {
+	&window_us_attr.attr,
+	&target_load_attr.attr,
+	&go_maxspeed_load_attr.attr,
+	&down_delay_us_attr.attr,
+	NULL,
+};
+
+static struct attribute_group sched_attr_group = {
+	.attrs = sched_attributes,
+	.name = "sched",
+};
+
+static int cpufreq_governor_sched(struct cpufreq_policy *new_policy,
+		unsigned int event)
+{
+	struct cpufreq_sched_cpuinfo *pcpu;
+	unsigned int j;
+	int rc;
+
+	switch (event) {
+	case CPUFREQ_GOV_START:
+		if (!cpu_online(new_policy->cpu))
+			return -EINVAL;
+
+		for_each_cpu(j, new_policy->cpus) {
+			pcpu = &per_cpu(cpuinfo, j);
+			pcpu->policy = new_policy;
+			pcpu->req_freq = new_policy->cur;
+			pcpu->busy = 0;
+			pcpu->last_update = cpu_clock(j);
+			pcpu->window_start = pcpu->last_update;
+			pcpu->freq_change_time = pcpu->last_update;
+			smp_wmb();
+			pcpu->governor_enabled = 1;
+		}
+
+		if (atomic_inc_return(&active_count) > 1)
+			return 0;
+
+		rc = sysfs_create_group(cpufreq_global_kobject,
+				&sched_attr_group);
+		if (rc) {
+			atomic_dec(&active_count);
+			for_each_cpu(j, new_policy->cpus)
+				per_cpu(cpuinfo, j).governor_enabled = 0;
+			return rc;
+		}
+		break;
+
+	case CPUFREQ_GOV_STOP:
+		for_each_cpu(j, new_policy->cpus) {
+			pcpu = &per_cpu(cpuinfo, j);
+			pcpu->governor_enabled = 0;
+			smp_wmb();
+			hrtimer_cancel(&pcpu->kick_timer);
+		}
+
+		if (atomic_dec_return(&active_count) > 0)
+			return 0;
+
+		sysfs_remove_group(cpufreq_global_kobject,
+				&sched_attr_group);
+		break;
+
+	case CPUFREQ_GOV_LIMITS:
+		if (new_policy->max < new_policy->cur)
+			__cpufreq_driver_target(new_policy,
+					new_policy->max, CPUFREQ_RELATION_H);
+		else if (new_policy->min > new_policy->cur)
+			__cpufreq_driver_target(new_policy,
+					new_policy->min, CPUFREQ_RELATION_L);
+		break;
+	}
+	return 0;
+}
+
+static int __init cpufreq_sched_init(void)
+{
+	struct sched_param param = { .sched_priority = MAX_RT_PRIO-1 };
+	unsigned int i;
+
+	window_us = DEFAULT_WINDOW_US;
+	target_load = DEFAULT_TARGET_LOAD;
+	go_maxspeed_load = DEFAULT_GO_MAXSPEED_LOAD;
+	down_delay_us = DEFAULT_DOWN_DELAY_US;
+
+	for_each_possible_cpu(i) {
+		struct hrtimer *timer = &per_cpu(cpuinfo, i).kick_timer;
+
+		hrtimer_init(timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+		timer->function = cpufreq_sched_kick;
+	}
+
+	change_task = kthread_create(cpufreq_sched_change_task, NULL,
+				     "kschedfreq");
+	if (IS_ERR(change_task))
+		return PTR_ERR(change_task);
+
+	sched_setscheduler_nocheck(change_task, SCHED_FIFO, &param);
+	get_task_struct(change_task);
+
+	return cpufreq_register_governor(&cpufreq_gov_sched);
+}
+
+#ifdef CONFIG_CPU_FREQ_DEFAULT_GOV_SCHED
+fs_initcall(cpufreq_sched_init);
+#else
+module_init(cpufreq_sched_init);
+#endif
+
+MODULE_DESCRIPTION("'cpufreq_sched' - scheduler driven cpufreq governor");
+MODULE_LICENSE("GPL");
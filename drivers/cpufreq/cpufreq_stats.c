@@ -20,6 +20,10 @@
 #include <linux/kobject.h>
 #include <linux/spinlock.h>
 #include <linux/notifier.h>
+#include <linux/sched.h>
+#include <linux/hash.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
 #include <asm/cputime.h>
 
 static spinlock_t cpufreq_stats_lock;
@@ -165,12 +169,210 @@ static int freq_table_get_index(struct cpufreq_stats *stat, unsigned int freq)
 	return -1;
 }
 
+#ifdef CONFIG_CPU_FREQ_STAT_TASK
+/*
+ * Per task time in state.  A task's table is only written by the tick on
+ * the CPU the task is running on, so accounting takes no locks.  All
+ * tasks share the frequency table of the first CPU registered.  When a
+ * task is released its times are folded into a per UID total.
+ */
+static unsigned int *task_freq_table;
+static unsigned int task_state_num;
+static DEFINE_PER_CPU(int, task_stats_index) = -1;
+
+#define UID_HASH_BITS	6
+
+struct uid_entry {
+	uid_t uid;
+	struct hlist_node hash;
+	/* task_state_num exited times followed by task_state_num live */
+	cputime64_t time[0];
+};
+
+static struct hlist_head uid_hash_table[1 << UID_HASH_BITS];
+static DEFINE_SPINLOCK(uid_lock);
+
+static void cpufreq_task_stats_set_index(struct cpufreq_stats *stat)
+{
+	per_cpu(task_stats_index, stat->cpu) =
+		stat->state_num == task_state_num ? stat->last_index : -1;
+}
+
+static void cpufreq_task_stats_setup(struct cpufreq_stats *stat)
+{
+	if (task_freq_table)
+		return;
+
+	task_freq_table = kmemdup(stat->freq_table,
+			stat->state_num * sizeof(unsigned int), GFP_KERNEL);
+	if (!task_freq_table)
+		return;
+	smp_wmb();
+	task_state_num = stat->state_num;
+}
+
+void cpufreq_task_stats_init(struct task_struct *p)
+{
+	p->cpufreq_time_in_state = NULL;
+	if (!task_state_num)
+		return;
+	p->cpufreq_time_in_state = kcalloc(task_state_num,
+			sizeof(cputime64_t), GFP_KERNEL);
+}
+
+void cpufreq_task_stats_free(struct task_struct *p)
+{
+	kfree(p->cpufreq_time_in_state);
+	p->cpufreq_time_in_state = NULL;
+}
+
+void cpufreq_task_stats_account(struct task_struct *p, cputime_t cputime)
+{
+	int index = __get_cpu_var(task_stats_index);
+
+	if (!p->cpufreq_time_in_state || index < 0)
+		return;
+	p->cpufreq_time_in_state[index] =
+		cputime64_add(p->cpufreq_time_in_state[index],
+			      cputime_to_cputime64(cputime));
+}
+
+/* Called with uid_lock held. */
+static struct uid_entry *uid_entry_get(uid_t uid)
+{
+	struct hlist_head *head = &uid_hash_table[hash_32(uid, UID_HASH_BITS)];
+	struct hlist_node *node;
+	struct uid_entry *e;
+
+	hlist_for_each_entry(e, node, head, hash)
+		if (e->uid == uid)
+			return e;
+
+	e = kzalloc(sizeof(*e) + 2 * task_state_num * sizeof(cputime64_t),
+		    GFP_ATOMIC);
+	if (!e)
+		return NULL;
+	e->uid = uid;
+	hlist_add_head(&e->hash, head);
+	return e;
+}
+
+/* Called from __exit_signal() with tasklist_lock held for writing. */
+void cpufreq_task_stats_exit(struct task_struct *p)
+{
+	struct uid_entry *e;
+	unsigned int i;
+
+	if (!p->cpufreq_time_in_state)
+		return;
+
+	spin_lock(&uid_lock);
+	e = uid_entry_get(task_uid(p));
+	if (e)
+		for (i = 0; i < task_state_num; i++)
+			e->time[i] = cputime64_add(e->time[i],
+					p->cpufreq_time_in_state[i]);
+	spin_unlock(&uid_lock);
+}
+
+int proc_time_in_state_show(struct task_struct *p, char *buf)
+{
+	cputime64_t *times = p->cpufreq_time_in_state;
+	ssize_t len = 0;
+	unsigned int i;
+
+	if (!times)
+		return 0;
+	for (i = 0; i < task_state_num; i++)
+		len += sprintf(buf + len, "%u %llu\n", task_freq_table[i],
+			(unsigned long long)cputime64_to_clock_t(times[i]));
+	return len;
+}
+
+static int uid_time_in_state_show(struct seq_file *m, void *v)
+{
+	struct task_struct *g, *p;
+	struct hlist_node *node;
+	struct uid_entry *e;
+	unsigned int i, bkt;
+	cputime64_t *live;
+
+	if (!task_state_num)
+		return 0;
+
+	seq_puts(m, "uid:");
+	for (i = 0; i < task_state_num; i++)
+		seq_printf(m, " %u", task_freq_table[i]);
+	seq_putc(m, '\n');
+
+	/* tasklist_lock keeps exiting tasks from being counted twice */
+	read_lock(&tasklist_lock);
+	spin_lock(&uid_lock);
+
+	for (bkt = 0; bkt < ARRAY_SIZE(uid_hash_table); bkt++)
+		hlist_for_each_entry(e, node, &uid_hash_table[bkt], hash)
+			memset(e->time + task_state_num, 0,
+			       task_state_num * sizeof(cputime64_t));
+
+	do_each_thread(g, p) {
+		if (!p->cpufreq_time_in_state)
+			continue;
+		e = uid_entry_get(task_uid(p));
+		if (!e)
+			continue;
+		live = e->time + task_state_num;
+		for (i = 0; i < task_state_num; i++)
+			live[i] = cputime64_add(live[i],
+					p->cpufreq_time_in_state[i]);
+	} while_each_thread(g, p);
+
+	for (bkt = 0; bkt < ARRAY_SIZE(uid_hash_table); bkt++) {
+		hlist_for_each_entry(e, node, &uid_hash_table[bkt], hash) {
+			live = e->time + task_state_num;
+			seq_printf(m, "%u:", e->uid);
+			for (i = 0; i < task_state_num; i++)
+				seq_printf(m, " %llu", (unsigned long long)
+					cputime64_to_clock_t(cputime64_add(
+						e->time[i], live[i])));
+			seq_putc(m, '\n');
+		}
+	}
+
+	spin_unlock(&uid_lock);
+	read_unlock(&tasklist_lock);
+	return 0;
+}
+
+static int uid_time_in_state_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, uid_time_in_state_show, NULL);
+}
+
+static const struct file_operations uid_time_in_state_fops = {
+	.open		= uid_time_in_state_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#else
+static inline void cpufreq_task_stats_set_index(struct cpufreq_stats *stat)
+{
+}
+
+static inline void cpufreq_task_stats_setup(struct cpufreq_stats *stat)
+{
+}
+#endif
+
 static void cpufreq_stats_free_table(unsigned int cpu)
 {
 	struct cpufreq_stats *stat = per_cpu(cpufreq_stats_table, cpu);
 	struct cpufreq_policy *policy = cpufreq_cpu_get(cpu);
 	if (policy && policy->cpu == cpu)
 		sysfs_remove_group(&policy->kobj, &stats_attr_group);
+#ifdef CONFIG_CPU_FREQ_STAT_TASK
+	per_cpu(task_stats_index, cpu) = -1;
+#endif
 	if (stat) {
 		kfree(stat->time_in_state);
 		kfree(stat);
@@ -243,6 +445,8 @@ static int cpufreq_stats_create_table(struct cpufreq_policy *policy,
 	stat->last_time = get_jiffies_64();
 	stat->last_index = freq_table_get_index(stat, policy->cur);
 	spin_unlock(&cpufreq_stats_lock);
+	cpufreq_task_stats_setup(stat);
+	cpufreq_task_stats_set_index(stat);
 	cpufreq_cpu_put(data);
 	return 0;
 error_out:
@@ -297,6 +501,7 @@ static int cpufreq_stat_notifier_trans(struct notifier_block *nb,
 
 	spin_lock(&cpufreq_stats_lock);
 	stat->last_index = new_index;
+	cpufreq_task_stats_set_index(stat);
 #ifdef CONFIG_CPU_FREQ_STAT_DETAILS
 	stat->trans_table[old_index * stat->max_state + new_index]++;
 #endif
@@ -386,6 +591,10 @@ static int __init cpufreq_stats_init(void)
 	for_each_online_cpu(cpu) {
 		cpufreq_update_policy(cpu);
 	}
+#ifdef CONFIG_CPU_FREQ_STAT_TASK
+	proc_create("uid_time_in_state", S_IRUGO, NULL,
+		    &uid_time_in_state_fops);
+#endif
 	return 0;
 }
 static void __exit cpufreq_stats_exit(void)
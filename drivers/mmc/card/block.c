@@ -79,6 +79,16 @@ struct mmc_blk_data {
 
 	unsigned int	usage;
 	unsigned int	read_only;
+
+	/* eMMC 4.5 packed write commands */
+	unsigned int	packed_enable;
+	unsigned int	packed_max;	/* requests per packed command */
+	struct {
+		unsigned long	packed_cmds;	/* packed commands issued */
+		unsigned long	packed_reqs;	/* requests sent packed */
+		unsigned long	unpacked_wr;	/* writes sent on their own */
+		unsigned long	packed_fail;	/* failed packed commands */
+	} packed_stats;
 };
 
 static DEFINE_MUTEX(open_lock);
@@ -165,12 +175,12 @@ static const struct block_device_operations mmc_bdops = {
 	.owner			= THIS_MODULE,
 };
 
-struct mmc_blk_request {
-	struct mmc_request	mrq;
-	struct mmc_command	sbc;
-	struct mmc_command	cmd;
-	struct mmc_command	stop;
-	struct mmc_data		data;
+enum mmc_blk_status {
+	MMC_BLK_SUCCESS = 0,
+	MMC_BLK_PARTIAL,
+	MMC_BLK_RETRY_SINGLE,
+	MMC_BLK_DATA_ERR,
+	MMC_BLK_CMD_ERR,
 };
 
 static u32 mmc_sd_num_wr_blocks(struct mmc_card *card)
@@ -270,8 +280,6 @@ static int mmc_blk_issue_discard_rq(struct mmc_queue *mq, struct request *req)
 	unsigned int from, nr, arg;
 	int err = 0;
 
-	mmc_claim_host(card->host);
-
 	if (!mmc_can_erase(card)) {
 		err = -EOPNOTSUPP;
 		goto out;
@@ -291,8 +299,6 @@ out:
 	__blk_end_request(req, err, blk_rq_bytes(req));
 	spin_unlock_irq(&md->lock);
 
-	mmc_release_host(card->host);
-
 	return err ? 0 : 1;
 }
 
@@ -304,8 +310,6 @@ static int mmc_blk_issue_secdiscard_rq(struct mmc_queue *mq,
 	unsigned int from, nr, arg;
 	int err = 0;
 
-	mmc_claim_host(card->host);
-
 	if (!mmc_can_secure_erase_trim(card)) {
 		err = -EOPNOTSUPP;
 		goto out;
@@ -327,8 +331,6 @@ out:
 	__blk_end_request(req, err, blk_rq_bytes(req));
 	spin_unlock_irq(&md->lock);
 
-	mmc_release_host(card->host);
-
 	return err ? 0 : 1;
 }
 
@@ -370,12 +372,389 @@ static inline void mmc_apply_rel_rw(struct mmc_blk_request *brq,
 	}
 }
 
-static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *req)
+static int mmc_blk_err_check(struct mmc_card *card,
+			     struct mmc_async_req *areq)
+{
+	struct mmc_queue_req *mq_mrq = container_of(areq, struct mmc_queue_req,
+						    mmc_active);
+	struct mmc_blk_request *brq = &mq_mrq->brq;
+	struct request *req = mq_mrq->req;
+	struct mmc_command cmd;
+	u32 status = 0;
+
+	mmc_queue_bounce_post(mq_mrq);
+
+	/*
+	 * Check for errors here, but don't jump to cmd_err
+	 * until later as we need to wait for the card to leave
+	 * programming mode even when things go wrong.
+	 */
+	// LGE_CHANGE [dojip.kim@lge.com] 2010-08-29,
+	// don't redo I/O when nomedium error
+
+#if defined(CONFIG_MACH_LGE)
+	if (brq->cmd.error == -ENOMEDIUM)
+		return MMC_BLK_CMD_ERR;
+#endif
+	if (brq->sbc.error || brq->cmd.error ||
+	    brq->data.error || brq->stop.error) {
+		if (brq->data.blocks > 1 && rq_data_dir(req) == READ) {
+			/* Redo read one sector at a time */
+			printk(KERN_WARNING "%s: retrying using single "
+			       "block read\n", req->rq_disk->disk_name);
+			return MMC_BLK_RETRY_SINGLE;
+		}
+		status = get_card_status(card, req);
+	}
+
+	if (brq->sbc.error) {
+		printk(KERN_ERR "%s: error %d sending SET_BLOCK_COUNT "
+		       "command, response %#x, card status %#x\n",
+		       req->rq_disk->disk_name, brq->sbc.error,
+		       brq->sbc.resp[0], status);
+	}
+
+	if (brq->cmd.error) {
+		printk(KERN_ERR "%s: error %d sending read/write "
+		       "command, response %#x, card status %#x\n",
+		       req->rq_disk->disk_name, brq->cmd.error,
+		       brq->cmd.resp[0], status);
+	}
+
+	if (brq->data.error) {
+		if (brq->data.error == -ETIMEDOUT && brq->mrq.stop)
+			/* 'Stop' response contains card status */
+			status = brq->mrq.stop->resp[0];
+		printk(KERN_ERR "%s: error %d transferring data,"
+		       " sector %u, nr %u, card status %#x\n",
+		       req->rq_disk->disk_name, brq->data.error,
+		       (unsigned)blk_rq_pos(req),
+		       (unsigned)blk_rq_sectors(req), status);
+	}
+
+	if (brq->stop.error) {
+		printk(KERN_ERR "%s: error %d sending stop command, "
+		       "response %#x, card status %#x\n",
+		       req->rq_disk->disk_name, brq->stop.error,
+		       brq->stop.resp[0], status);
+	}
+
+	if (!mmc_host_is_spi(card->host) && rq_data_dir(req) != READ) {
+		do {
+			int err;
+
+			cmd.opcode = MMC_SEND_STATUS;
+			cmd.arg = card->rca << 16;
+			cmd.flags = MMC_RSP_R1 | MMC_CMD_AC;
+			err = mmc_wait_for_cmd(card->host, &cmd, 5);
+			if (err) {
+				printk(KERN_ERR "%s: error %d requesting status\n",
+				       req->rq_disk->disk_name, err);
+				return MMC_BLK_CMD_ERR;
+			}
+			/*
+			 * Some cards mishandle the status bits,
+			 * so make sure to check both the busy
+			 * indication and the card state.
+			 */
+		} while (!(cmd.resp[0] & R1_READY_FOR_DATA) ||
+			(R1_CURRENT_STATE(cmd.resp[0]) == 7));
+	}
+
+	if (brq->cmd.error || brq->stop.error || brq->data.error) {
+		if (rq_data_dir(req) == READ)
+			return MMC_BLK_DATA_ERR;
+		return MMC_BLK_CMD_ERR;
+	}
+
+	/*
+	 * A request that is only partly done is reported as an error so
+	 * that mmc_start_req() does not start the next request before the
+	 * rest of this one has been sent.
+	 */
+	if (mq_mrq->packed_cmd == MMC_PACKED_NONE &&
+	    blk_rq_bytes(req) != brq->data.bytes_xfered)
+		return MMC_BLK_PARTIAL;
+
+	return MMC_BLK_SUCCESS;
+}
+
+static int mmc_blk_packed_err_check(struct mmc_card *card,
+				    struct mmc_async_req *areq)
+{
+	struct mmc_queue_req *mq_mrq = container_of(areq, struct mmc_queue_req,
+						    mmc_active);
+	struct mmc_blk_request *brq = &mq_mrq->brq;
+	int check;
+
+	check = mmc_blk_err_check(card, areq);
+	if (check == MMC_BLK_SUCCESS &&
+	    brq->data.bytes_xfered != brq->data.blocks * brq->data.blksz)
+		check = MMC_BLK_CMD_ERR;
+
+	return check;
+}
+
+/*
+ * Index of the first entry of a failed packed command that the card did
+ * not complete, as reported through the packed failure exception event.
+ * 0 if the card cannot tell.
+ */
+static int mmc_blk_packed_fail_idx(struct mmc_card *card,
+				   struct mmc_queue_req *mq_rq)
+{
+	struct request *req = mq_rq->req;
+	struct mmc_command cmd;
+	u8 *ext_csd;
+	u32 status;
+	int idx = 0;
+
+	status = get_card_status(card, req);
+
+	/*
+	 * Without MMC_CAP_CMD23 the host sent no stop after the failed
+	 * transfer; leave the receive/data state before reading EXT_CSD.
+	 */
+	if (R1_CURRENT_STATE(status) == 5 || R1_CURRENT_STATE(status) == 6) {
+		memset(&cmd, 0, sizeof(struct mmc_command));
+		cmd.opcode = MMC_STOP_TRANSMISSION;
+		cmd.flags = MMC_RSP_SPI_R1B | MMC_RSP_R1B | MMC_CMD_AC;
+		mmc_wait_for_cmd(card->host, &cmd, 0);
+		status = get_card_status(card, req);
+	}
+
+	if (!(status & R1_EXCEPTION_EVENT))
+		return 0;
+
+	ext_csd = kmalloc(512, GFP_KERNEL);
+	if (!ext_csd)
+		return 0;
+
+	if (!mmc_send_ext_csd(card, ext_csd) &&
+	    (ext_csd[EXT_CSD_EXP_EVENTS_STATUS] & EXT_CSD_PACKED_FAILURE) &&
+	    (ext_csd[EXT_CSD_PACKED_CMD_STATUS] &
+	     EXT_CSD_PACKED_INDEXED_ERROR)) {
+		idx = ext_csd[EXT_CSD_PACKED_FAILURE_INDEX] - 1;
+		if (idx < 0 || idx >= mq_rq->packed_num)
+			idx = 0;
+		printk(KERN_ERR "%s: packed command failed at entry %d "
+		       "of %d\n", req->rq_disk->disk_name, idx + 1,
+		       mq_rq->packed_num);
+	}
+
+	kfree(ext_csd);
+	return idx;
+}
+
+static bool mmc_blk_packable(struct request *req)
+{
+	return rq_data_dir(req) == WRITE &&
+		req->cmd_type == REQ_TYPE_FS &&
+		!(req->cmd_flags & (REQ_DISCARD | REQ_FLUSH |
+				    REQ_FUA | REQ_META));
+}
+
+/*
+ * Pull further writes off the queue to send together with @req in one
+ * packed command.  Each one costs a command round trip otherwise, which
+ * dominates small random writes.
+ */
+static void mmc_blk_prep_packed_list(struct mmc_queue *mq,
+				     struct request *req)
+{
+	struct request_queue *q = mq->queue;
+	struct mmc_card *card = mq->card;
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_queue_req *mqrq = mq->mqrq_cur;
+	struct mmc_host *host = card->host;
+	struct request *next;
+	unsigned int max_num, max_blocks, max_segs, blocks, segs, num = 1;
+
+	mqrq->packed_cmd = MMC_PACKED_NONE;
+	mqrq->packed_num = 0;
+
+	if (rq_data_dir(req) != WRITE)
+		return;
+
+	max_num = min_t(unsigned int, md->packed_max,
+			card->ext_csd.max_packed_writes);
+	/* the queue limits also cover the bounce buffer, if there is one */
+	max_blocks = queue_max_hw_sectors(q);
+	max_segs = queue_max_segments(q);
+	blocks = blk_rq_sectors(req) + 1;	/* plus the header block */
+	segs = req->nr_phys_segments + 1;
+
+	if (mq->no_pack_count) {
+		mq->no_pack_count--;
+		goto unpacked;
+	}
+
+	if (!md->packed_enable || max_num < 2 || !mqrq->packed_cmd_hdr ||
+	    !card->ext_csd.packed_event_en || mmc_host_is_spi(host) ||
+	    !mmc_blk_packable(req) || blocks > max_blocks ||
+	    segs > max_segs)
+		goto unpacked;
+
+	list_add_tail(&req->queuelist, &mqrq->packed_list);
+
+	spin_lock_irq(q->queue_lock);
+	while (num < max_num) {
+		next = blk_peek_request(q);
+		if (!next || !mmc_blk_packable(next))
+			break;
+		if (blocks + blk_rq_sectors(next) > max_blocks ||
+		    segs + next->nr_phys_segments > max_segs)
+			break;
+
+		blk_start_request(next);
+		list_add_tail(&next->queuelist, &mqrq->packed_list);
+		blocks += blk_rq_sectors(next);
+		segs += next->nr_phys_segments;
+		num++;
+	}
+	spin_unlock_irq(q->queue_lock);
+
+	if (num == 1) {
+		list_del_init(&req->queuelist);
+		goto unpacked;
+	}
+
+	mqrq->packed_cmd = MMC_PACKED_WRITE;
+	mqrq->packed_num = num;
+	mqrq->packed_blocks = blocks - 1;
+	md->packed_stats.packed_cmds++;
+	md->packed_stats.packed_reqs += num;
+	return;
+
+ unpacked:
+	md->packed_stats.unpacked_wr++;
+}
+
+/*
+ * A packed write is one CMD23-bounded CMD25 whose first block is a
+ * header holding the CMD23 and CMD25 arguments of every entry.
+ */
+static void mmc_blk_packed_hdr_wrq_prep(struct mmc_queue_req *mqrq,
+					struct mmc_card *card,
+					struct mmc_queue *mq)
+{
+	struct mmc_blk_request *brq = &mqrq->brq;
+	struct request *req = mqrq->req;
+	struct request *prq;
+	u32 *hdr = mqrq->packed_cmd_hdr;
+	int i = 1;
+
+	memset(hdr, 0, MMC_PACKED_HDR_SIZE);
+	/* version 1, write, number of entries */
+	hdr[0] = cpu_to_le32((mqrq->packed_num << 16) | (0x02 << 8) | 0x01);
+	list_for_each_entry(prq, &mqrq->packed_list, queuelist) {
+		/* Argument of CMD23 */
+		hdr[i * 2] = cpu_to_le32(blk_rq_sectors(prq));
+		/* Argument of CMD25 */
+		hdr[i * 2 + 1] = cpu_to_le32(mmc_card_blockaddr(card) ?
+			blk_rq_pos(prq) : blk_rq_pos(prq) << 9);
+		i++;
+	}
+
+	memset(brq, 0, sizeof(struct mmc_blk_request));
+	brq->mrq.cmd = &brq->cmd;
+	brq->mrq.data = &brq->data;
+	brq->mrq.sbc = &brq->sbc;
+	/*
+	 * Hosts that handle CMD23 themselves only use the stop command on
+	 * errors; for the others the core sends CMD23 and the transfer
+	 * must not be followed by a stop.
+	 */
+	if (mmc_host_cmd23(card->host))
+		brq->mrq.stop = &brq->stop;
+
+	brq->sbc.opcode = MMC_SET_BLOCK_COUNT;
+	brq->sbc.arg = MMC_CMD23_ARG_PACKED | (mqrq->packed_blocks + 1);
+	brq->sbc.flags = MMC_RSP_R1 | MMC_CMD_AC;
+
+	brq->cmd.opcode = MMC_WRITE_MULTIPLE_BLOCK;
+	brq->cmd.arg = blk_rq_pos(req);
+	if (!mmc_card_blockaddr(card))
+		brq->cmd.arg <<= 9;
+	brq->cmd.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_ADTC;
+
+	brq->stop.opcode = MMC_STOP_TRANSMISSION;
+	brq->stop.arg = 0;
+	brq->stop.flags = MMC_RSP_SPI_R1B | MMC_RSP_R1B | MMC_CMD_AC;
+
+	brq->data.blksz = 512;
+	brq->data.blocks = mqrq->packed_blocks + 1;
+	brq->data.flags |= MMC_DATA_WRITE;
+
+	mmc_set_data_timeout(&brq->data, card);
+
+	brq->data.sg = mqrq->sg;
+	brq->data.sg_len = mmc_queue_packed_map_sg(mq, mqrq);
+
+	mqrq->mmc_active.mrq = &brq->mrq;
+	mqrq->mmc_active.err_check = mmc_blk_packed_err_check;
+
+	mmc_queue_bounce_pre(mqrq);
+}
+
+/*
+ * Complete the requests of a finished packed command.  After a failure
+ * the entries before the one the card reports as failed are done; the
+ * rest are put back on the queue, to be sent again unpacked.  Returns
+ * the number of requests put back.
+ */
+static int mmc_blk_end_packed_req(struct mmc_queue *mq,
+				  struct mmc_queue_req *mq_rq,
+				  enum mmc_blk_status status)
 {
 	struct mmc_blk_data *md = mq->data;
-	struct mmc_card *card = md->queue.card;
-	struct mmc_blk_request brq;
-	int ret = 1, disable_multi = 0;
+	struct request *prq, *tmp;
+	int idx = mq_rq->packed_num, i = 0, requeued = 0;
+	LIST_HEAD(failed);
+
+	if (status != MMC_BLK_SUCCESS) {
+		md->packed_stats.packed_fail++;
+		idx = mmc_blk_packed_fail_idx(mq->card, mq_rq);
+	}
+
+	spin_lock_irq(&md->lock);
+	list_for_each_entry_safe(prq, tmp, &mq_rq->packed_list, queuelist) {
+		list_del_init(&prq->queuelist);
+		if (i++ < idx)
+			__blk_end_request(prq, 0, blk_rq_bytes(prq));
+		else
+			list_add(&prq->queuelist, &failed);
+	}
+
+	/* requeue in reverse so that the first failed entry is next */
+	list_for_each_entry_safe(prq, tmp, &failed, queuelist) {
+		list_del_init(&prq->queuelist);
+		blk_requeue_request(mq->queue, prq);
+		requeued++;
+	}
+	spin_unlock_irq(&md->lock);
+
+	mq->no_pack_count += requeued;
+	mq_rq->packed_cmd = MMC_PACKED_NONE;
+	mq_rq->packed_num = 0;
+
+	return requeued;
+}
+
+static void mmc_blk_rw_rq_prep(struct mmc_queue_req *mqrq,
+			       struct mmc_card *card,
+			       int disable_multi,
+			       struct mmc_queue *mq)
+{
+	u32 readcmd, writecmd;
+	struct mmc_blk_request *brq = &mqrq->brq;
+	struct request *req = mqrq->req;
+	struct mmc_blk_data *md = mq->data;
+
+	if (mqrq->packed_cmd == MMC_PACKED_WRITE) {
+		mmc_blk_packed_hdr_wrq_prep(mqrq, card, mq);
+		return;
+	}
 
 	/*
 	 * Reliable writes are used to implement Forced Unit Access and
@@ -386,240 +765,221 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *req)
 		(rq_data_dir(req) == WRITE) &&
 		(md->flags & MMC_BLK_REL_WR);
 
-	mmc_claim_host(card->host);
+	memset(brq, 0, sizeof(struct mmc_blk_request));
+	brq->mrq.cmd = &brq->cmd;
+	brq->mrq.data = &brq->data;
 
-	do {
-		struct mmc_command cmd;
-		u32 readcmd, writecmd, status = 0;
-
-		memset(&brq, 0, sizeof(struct mmc_blk_request));
-		brq.mrq.cmd = &brq.cmd;
-		brq.mrq.data = &brq.data;
-
-		brq.cmd.arg = blk_rq_pos(req);
-		if (!mmc_card_blockaddr(card))
-			brq.cmd.arg <<= 9;
-		brq.cmd.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_ADTC;
-		brq.data.blksz = 512;
-		brq.stop.opcode = MMC_STOP_TRANSMISSION;
-		brq.stop.arg = 0;
-		brq.stop.flags = MMC_RSP_SPI_R1B | MMC_RSP_R1B | MMC_CMD_AC;
-		brq.data.blocks = blk_rq_sectors(req);
+	brq->cmd.arg = blk_rq_pos(req);
+	if (!mmc_card_blockaddr(card))
+		brq->cmd.arg <<= 9;
+	brq->cmd.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_ADTC;
+	brq->data.blksz = 512;
+	brq->stop.opcode = MMC_STOP_TRANSMISSION;
+	brq->stop.arg = 0;
+	brq->stop.flags = MMC_RSP_SPI_R1B | MMC_RSP_R1B | MMC_CMD_AC;
+	brq->data.blocks = blk_rq_sectors(req);
 
-		/*
-		 * The block layer doesn't support all sector count
-		 * restrictions, so we need to be prepared for too big
-		 * requests.
-		 */
-		if (brq.data.blocks > card->host->max_blk_count)
-			brq.data.blocks = card->host->max_blk_count;
-
-		/*
-		 * After a read error, we redo the request one sector at a time
-		 * in order to accurately determine which sectors can be read
-		 * successfully.
-		 */
-		if (disable_multi && brq.data.blocks > 1)
-			brq.data.blocks = 1;
-
-		if (brq.data.blocks > 1 || do_rel_wr) {
-			/* SPI multiblock writes terminate using a special
-			 * token, not a STOP_TRANSMISSION request.
-			 */
-			if (!mmc_host_is_spi(card->host) ||
-			    rq_data_dir(req) == READ)
-				brq.mrq.stop = &brq.stop;
-			readcmd = MMC_READ_MULTIPLE_BLOCK;
-			writecmd = MMC_WRITE_MULTIPLE_BLOCK;
-		} else {
-			brq.mrq.stop = NULL;
-			readcmd = MMC_READ_SINGLE_BLOCK;
-			writecmd = MMC_WRITE_BLOCK;
-		}
-		if (rq_data_dir(req) == READ) {
-			brq.cmd.opcode = readcmd;
-			brq.data.flags |= MMC_DATA_READ;
-		} else {
-			brq.cmd.opcode = writecmd;
-			brq.data.flags |= MMC_DATA_WRITE;
-		}
+	/*
+	 * The block layer doesn't support all sector count
+	 * restrictions, so we need to be prepared for too big
+	 * requests.
+	 */
+	if (brq->data.blocks > card->host->max_blk_count)
+		brq->data.blocks = card->host->max_blk_count;
 
-		if (do_rel_wr)
-			mmc_apply_rel_rw(&brq, card, req);
+	/*
+	 * After a read error, we redo the request one sector at a time
+	 * in order to accurately determine which sectors can be read
+	 * successfully.
+	 */
+	if (disable_multi && brq->data.blocks > 1)
+		brq->data.blocks = 1;
 
-		/*
-		 * Pre-defined multi-block transfers are preferable to
-		 * open ended-ones (and necessary for reliable writes).
-		 * However, it is not sufficient to just send CMD23,
-		 * and avoid the final CMD12, as on an error condition
-		 * CMD12 (stop) needs to be sent anyway. This, coupled
-		 * with Auto-CMD23 enhancements provided by some
-		 * hosts, means that the complexity of dealing
-		 * with this is best left to the host. If CMD23 is
-		 * supported by card and host, we'll fill sbc in and let
-		 * the host deal with handling it correctly. This means
-		 * that for hosts that don't expose MMC_CAP_CMD23, no
-		 * change of behavior will be observed.
-		 *
-		 * N.B: Some MMC cards experience perf degradation.
-		 * We'll avoid using CMD23-bounded multiblock writes for
-		 * these, while retaining features like reliable writes.
+	if (brq->data.blocks > 1 || do_rel_wr) {
+		/* SPI multiblock writes terminate using a special
+		 * token, not a STOP_TRANSMISSION request.
 		 */
+		if (!mmc_host_is_spi(card->host) ||
+		    rq_data_dir(req) == READ)
+			brq->mrq.stop = &brq->stop;
+		readcmd = MMC_READ_MULTIPLE_BLOCK;
+		writecmd = MMC_WRITE_MULTIPLE_BLOCK;
+	} else {
+		brq->mrq.stop = NULL;
+		readcmd = MMC_READ_SINGLE_BLOCK;
+		writecmd = MMC_WRITE_BLOCK;
+	}
+	if (rq_data_dir(req) == READ) {
+		brq->cmd.opcode = readcmd;
+		brq->data.flags |= MMC_DATA_READ;
+	} else {
+		brq->cmd.opcode = writecmd;
+		brq->data.flags |= MMC_DATA_WRITE;
+	}
 
-		if ((md->flags & MMC_BLK_CMD23) &&
-		    mmc_op_multi(brq.cmd.opcode) &&
-		    (do_rel_wr || !(card->quirks & MMC_QUIRK_BLK_NO_CMD23))) {
-			brq.sbc.opcode = MMC_SET_BLOCK_COUNT;
-			brq.sbc.arg = brq.data.blocks |
-				(do_rel_wr ? (1 << 31) : 0);
-			brq.sbc.flags = MMC_RSP_R1 | MMC_CMD_AC;
-			brq.mrq.sbc = &brq.sbc;
-		}
-
-		mmc_set_data_timeout(&brq.data, card);
-
-		brq.data.sg = mq->sg;
-		brq.data.sg_len = mmc_queue_map_sg(mq);
+	if (do_rel_wr)
+		mmc_apply_rel_rw(brq, card, req);
 
-		/*
-		 * Adjust the sg list so it is the same size as the
-		 * request.
-		 */
-		if (brq.data.blocks != blk_rq_sectors(req)) {
-			int i, data_size = brq.data.blocks << 9;
-			struct scatterlist *sg;
-
-			for_each_sg(brq.data.sg, sg, brq.data.sg_len, i) {
-				data_size -= sg->length;
-				if (data_size <= 0) {
-					sg->length += data_size;
-					i++;
-					break;
-				}
-			}
-			brq.data.sg_len = i;
-		}
+	/*
+	 * Pre-defined multi-block transfers are preferable to
+	 * open ended-ones (and necessary for reliable writes).
+	 * However, it is not sufficient to just send CMD23,
+	 * and avoid the final CMD12, as on an error condition
+	 * CMD12 (stop) needs to be sent anyway. This, coupled
+	 * with Auto-CMD23 enhancements provided by some
+	 * hosts, means that the complexity of dealing
+	 * with this is best left to the host. If CMD23 is
+	 * supported by card and host, we'll fill sbc in and let
+	 * the host deal with handling it correctly. This means
+	 * that for hosts that don't expose MMC_CAP_CMD23, no
+	 * change of behavior will be observed.
+	 *
+	 * N.B: Some MMC cards experience perf degradation.
+	 * We'll avoid using CMD23-bounded multiblock writes for
+	 * these, while retaining features like reliable writes.
+	 */
 
-		mmc_queue_bounce_pre(mq);
+	if ((md->flags & MMC_BLK_CMD23) &&
+	    mmc_op_multi(brq->cmd.opcode) &&
+	    (do_rel_wr || !(card->quirks & MMC_QUIRK_BLK_NO_CMD23))) {
+		brq->sbc.opcode = MMC_SET_BLOCK_COUNT;
+		brq->sbc.arg = brq->data.blocks |
+			(do_rel_wr ? (1 << 31) : 0);
+		brq->sbc.flags = MMC_RSP_R1 | MMC_CMD_AC;
+		brq->mrq.sbc = &brq->sbc;
+	}
 
-		mmc_wait_for_req(card->host, &brq.mrq);
+	mmc_set_data_timeout(&brq->data, card);
 
-		mmc_queue_bounce_post(mq);
+	brq->data.sg = mqrq->sg;
+	brq->data.sg_len = mmc_queue_map_sg(mq, mqrq);
 
-		/*
-		 * Check for errors here, but don't jump to cmd_err
-		 * until later as we need to wait for the card to leave
-		 * programming mode even when things go wrong.
-		 */
-		// LGE_CHANGE [dojip.kim@lge.com] 2010-08-29,
-		// don't redo I/O when nomedium error
-
-#if defined(CONFIG_MACH_LGE)
-		if (brq.cmd.error == -ENOMEDIUM) {
-			goto cmd_err;
-		}
-#endif
-		if (brq.sbc.error || brq.cmd.error ||
-		    brq.data.error || brq.stop.error) {
-			if (brq.data.blocks > 1 && rq_data_dir(req) == READ) {
-				/* Redo read one sector at a time */
-				printk(KERN_WARNING "%s: retrying using single "
-				       "block read\n", req->rq_disk->disk_name);
-				disable_multi = 1;
-				continue;
+	/*
+	 * Adjust the sg list so it is the same size as the
+	 * request.
+	 */
+	if (brq->data.blocks != blk_rq_sectors(req)) {
+		int i, data_size = brq->data.blocks << 9;
+		struct scatterlist *sg;
+
+		for_each_sg(brq->data.sg, sg, brq->data.sg_len, i) {
+			data_size -= sg->length;
+			if (data_size <= 0) {
+				sg->length += data_size;
+				i++;
+				break;
 			}
-			status = get_card_status(card, req);
-		} else if (disable_multi == 1) {
-			disable_multi = 0;
 		}
+		brq->data.sg_len = i;
+	}
 
-		if (brq.sbc.error) {
-			printk(KERN_ERR "%s: error %d sending SET_BLOCK_COUNT "
-			       "command, response %#x, card status %#x\n",
-			       req->rq_disk->disk_name, brq.sbc.error,
-			       brq.sbc.resp[0], status);
-		}
+	mqrq->mmc_active.mrq = &brq->mrq;
+	mqrq->mmc_active.err_check = mmc_blk_err_check;
 
-		if (brq.cmd.error) {
-			printk(KERN_ERR "%s: error %d sending read/write "
-			       "command, response %#x, card status %#x\n",
-			       req->rq_disk->disk_name, brq.cmd.error,
-			       brq.cmd.resp[0], status);
-		}
+	mmc_queue_bounce_pre(mqrq);
+}
 
-		if (brq.data.error) {
-			if (brq.data.error == -ETIMEDOUT && brq.mrq.stop)
-				/* 'Stop' response contains card status */
-				status = brq.mrq.stop->resp[0];
-			printk(KERN_ERR "%s: error %d transferring data,"
-			       " sector %u, nr %u, card status %#x\n",
-			       req->rq_disk->disk_name, brq.data.error,
-			       (unsigned)blk_rq_pos(req),
-			       (unsigned)blk_rq_sectors(req), status);
-		}
+/*
+ * Issue @rqc and complete the request that was started before it.  The
+ * new request is prepared (sg mapped, bounced, DMA mapped by pre_req)
+ * while the previous one is still transferring, and is started as soon
+ * as the previous one has finished without error.  With a NULL @rqc the
+ * request in flight, if any, is only completed.
+ */
+static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_card *card = md->queue.card;
+	struct mmc_blk_request *brq;
+	struct mmc_queue_req *mq_rq;
+	struct mmc_async_req *areq;
+	struct request *req;
+	enum mmc_blk_status status;
+	int ret = 1, disable_multi = 0;
 
-		if (brq.stop.error) {
-			printk(KERN_ERR "%s: error %d sending stop command, "
-			       "response %#x, card status %#x\n",
-			       req->rq_disk->disk_name, brq.stop.error,
-			       brq.stop.resp[0], status);
-		}
+	if (!rqc && !mq->mqrq_prev->req)
+		return 0;
 
-		if (!mmc_host_is_spi(card->host) && rq_data_dir(req) != READ) {
-			do {
-				int err;
-
-				cmd.opcode = MMC_SEND_STATUS;
-				cmd.arg = card->rca << 16;
-				cmd.flags = MMC_RSP_R1 | MMC_CMD_AC;
-				err = mmc_wait_for_cmd(card->host, &cmd, 5);
-				if (err) {
-					printk(KERN_ERR "%s: error %d requesting status\n",
-					       req->rq_disk->disk_name, err);
-					goto cmd_err;
-				}
-				/*
-				 * Some cards mishandle the status bits,
-				 * so make sure to check both the busy
-				 * indication and the card state.
-				 */
-			} while (!(cmd.resp[0] & R1_READY_FOR_DATA) ||
-				(R1_CURRENT_STATE(cmd.resp[0]) == 7));
-
-#if 0
-			if (cmd.resp[0] & ~0x00000900)
-				printk(KERN_ERR "%s: status = %08x\n",
-				       req->rq_disk->disk_name, cmd.resp[0]);
-			if (mmc_decode_status(cmd.resp))
-				goto cmd_err;
-#endif
+	if (rqc)
+		mmc_blk_prep_packed_list(mq, rqc);
+
+	do {
+		if (rqc) {
+			mmc_blk_rw_rq_prep(mq->mqrq_cur, card, 0, mq);
+			areq = &mq->mqrq_cur->mmc_active;
+		} else
+			areq = NULL;
+		areq = mmc_start_req(card->host, areq, (int *) &status);
+		if (!areq)
+			return 0;
+
+		mq_rq = container_of(areq, struct mmc_queue_req, mmc_active);
+		brq = &mq_rq->brq;
+		req = mq_rq->req;
+
+		if (mq_rq->packed_cmd != MMC_PACKED_NONE) {
+			if (mmc_blk_end_packed_req(mq, mq_rq, status))
+				goto start_new_req;
+			break;
 		}
 
-		if (brq.cmd.error || brq.stop.error || brq.data.error) {
-			if (rq_data_dir(req) == READ) {
+		switch (status) {
+		case MMC_BLK_SUCCESS:
+		case MMC_BLK_PARTIAL:
+			/*
+			 * A block was successfully transferred.
+			 */
+			if (disable_multi == 1)
+				disable_multi = 0;
+			spin_lock_irq(&md->lock);
+			ret = __blk_end_request(req, 0,
+						brq->data.bytes_xfered);
+			spin_unlock_irq(&md->lock);
+			if (status == MMC_BLK_SUCCESS && ret) {
 				/*
-				 * After an error, we redo I/O one sector at a
-				 * time, so we only reach here after trying to
-				 * read a single sector.
+				 * All data was transferred without error
+				 * but the request is not complete; the
+				 * next request is already running, so
+				 * fail this one rather than resend it.
 				 */
-				spin_lock_irq(&md->lock);
-				ret = __blk_end_request(req, -EIO, brq.data.blksz);
-				spin_unlock_irq(&md->lock);
-				continue;
+				printk(KERN_ERR "%s: BUG rq_tot %d d_xfer %d\n",
+				       req->rq_disk->disk_name,
+				       blk_rq_bytes(req),
+				       brq->data.bytes_xfered);
+				rqc = NULL;
+				goto cmd_abort;
 			}
+			break;
+		case MMC_BLK_CMD_ERR:
 			goto cmd_err;
+		case MMC_BLK_RETRY_SINGLE:
+			disable_multi = 1;
+			break;
+		case MMC_BLK_DATA_ERR:
+			/*
+			 * After an error, we redo I/O one sector at a
+			 * time, so we only reach here after trying to
+			 * read a single sector.
+			 */
+			spin_lock_irq(&md->lock);
+			ret = __blk_end_request(req, -EIO, brq->data.blksz);
+			spin_unlock_irq(&md->lock);
+			if (!ret)
+				goto start_new_req;
+			break;
 		}
 
-		/*
-		 * A block was successfully transferred.
-		 */
-		spin_lock_irq(&md->lock);
-		ret = __blk_end_request(req, 0, brq.data.bytes_xfered);
-		spin_unlock_irq(&md->lock);
+		if (ret) {
+			/*
+			 * Nothing else is in flight when a request is
+			 * incomplete, so prepare the rest of it and send
+			 * it before the next request.
+			 */
+			mmc_blk_rw_rq_prep(mq_rq, card, disable_multi, mq);
+			mmc_start_req(card->host, &mq_rq->mmc_active, NULL);
+		}
 	} while (ret);
 
-	mmc_release_host(card->host);
-
 	return 1;
 
  cmd_err:
@@ -642,12 +1002,11 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *req)
 		}
 	} else {
 		spin_lock_irq(&md->lock);
-		ret = __blk_end_request(req, 0, brq.data.bytes_xfered);
+		ret = __blk_end_request(req, 0, brq->data.bytes_xfered);
 		spin_unlock_irq(&md->lock);
 	}
 
-	mmc_release_host(card->host);
-
+ cmd_abort:
 	spin_lock_irq(&md->lock);
 	while (ret) {
 		// LGE_CHANGE [dojip.kim@lge.com] 2010-08-29,
@@ -659,6 +1018,12 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *req)
 	}
 	spin_unlock_irq(&md->lock);
 
+ start_new_req:
+	if (rqc) {
+		mmc_blk_rw_rq_prep(mq->mqrq_cur, card, 0, mq);
+		mmc_start_req(card->host, &mq->mqrq_cur->mmc_active, NULL);
+	}
+
 	return 0;
 }
 
@@ -667,26 +1032,42 @@ mmc_blk_set_blksize(struct mmc_blk_data *md, struct mmc_card *card);
 
 static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 {
-#ifdef CONFIG_MMC_BLOCK_DEFERRED_RESUME
 	struct mmc_blk_data *md = mq->data;
 	struct mmc_card *card = md->queue.card;
+	int ret;
 
-	if (mmc_bus_needs_resume(card->host)) {
-		mmc_resume_bus(card->host);
-		mmc_blk_set_blksize(md, card);
-	}
+	if (req && !mq->mqrq_prev->req) {
+#ifdef CONFIG_MMC_BLOCK_DEFERRED_RESUME
+		if (mmc_bus_needs_resume(card->host)) {
+			mmc_resume_bus(card->host);
+			mmc_blk_set_blksize(md, card);
+		}
 #endif
+		/* claim host only for the first request */
+		mmc_claim_host(card->host);
+	}
 
-	if (req->cmd_flags & REQ_DISCARD) {
+	if (req && req->cmd_flags & REQ_DISCARD) {
+		/* complete ongoing async transfer before issuing discard */
+		if (card->host->areq)
+			mmc_blk_issue_rw_rq(mq, NULL);
 		if (req->cmd_flags & REQ_SECURE)
-			return mmc_blk_issue_secdiscard_rq(mq, req);
+			ret = mmc_blk_issue_secdiscard_rq(mq, req);
 		else
-			return mmc_blk_issue_discard_rq(mq, req);
-	} else if (req->cmd_flags & REQ_FLUSH) {
-		return mmc_blk_issue_flush(mq, req);
+			ret = mmc_blk_issue_discard_rq(mq, req);
+	} else if (req && req->cmd_flags & REQ_FLUSH) {
+		/* complete ongoing async transfer before issuing flush */
+		if (card->host->areq)
+			mmc_blk_issue_rw_rq(mq, NULL);
+		ret = mmc_blk_issue_flush(mq, req);
 	} else {
-		return mmc_blk_issue_rw_rq(mq, req);
+		ret = mmc_blk_issue_rw_rq(mq, req);
 	}
+
+	/* release host only when there are no more requests */
+	if (!req)
+		mmc_release_host(card->host);
+	return ret;
 }
 
 static inline int mmc_blk_readonly(struct mmc_card *card)
@@ -734,6 +1115,9 @@ static struct mmc_blk_data *mmc_blk_alloc(struct mmc_card *card)
 	md->queue.issue_fn = mmc_blk_issue_rq;
 	md->queue.data = md;
 
+	md->packed_enable = 1;
+	md->packed_max = MMC_PACKED_NR_MAX;
+
 	md->disk->major	= MMC_BLOCK_MAJOR;
 	md->disk->first_minor = devidx * perdev_minors;
 	md->disk->fops = &mmc_bdops;
@@ -817,6 +1201,106 @@ mmc_blk_set_blksize(struct mmc_blk_data *md, struct mmc_card *card)
 	return 0;
 }
 
+static ssize_t packed_enable_show(struct device *dev,
+				  struct device_attribute *attr, char *buf)
+{
+	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
+	int ret;
+
+	if (!md)
+		return -ENODEV;
+	ret = sprintf(buf, "%u\n", md->packed_enable);
+	mmc_blk_put(md);
+	return ret;
+}
+
+static ssize_t packed_enable_store(struct device *dev,
+				   struct device_attribute *attr,
+				   const char *buf, size_t count)
+{
+	struct mmc_blk_data *md;
+	unsigned long val;
+
+	if (strict_strtoul(buf, 0, &val))
+		return -EINVAL;
+
+	md = mmc_blk_get(dev_to_disk(dev));
+	if (!md)
+		return -ENODEV;
+	md->packed_enable = !!val;
+	mmc_blk_put(md);
+	return count;
+}
+
+static ssize_t packed_max_show(struct device *dev,
+			       struct device_attribute *attr, char *buf)
+{
+	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
+	int ret;
+
+	if (!md)
+		return -ENODEV;
+	ret = sprintf(buf, "%u\n", md->packed_max);
+	mmc_blk_put(md);
+	return ret;
+}
+
+static ssize_t packed_max_store(struct device *dev,
+				struct device_attribute *attr,
+				const char *buf, size_t count)
+{
+	struct mmc_blk_data *md;
+	unsigned long val;
+
+	if (strict_strtoul(buf, 0, &val) || val > MMC_PACKED_NR_MAX)
+		return -EINVAL;
+
+	md = mmc_blk_get(dev_to_disk(dev));
+	if (!md)
+		return -ENODEV;
+	md->packed_max = val;
+	mmc_blk_put(md);
+	return count;
+}
+
+static ssize_t packed_stats_show(struct device *dev,
+				 struct device_attribute *attr, char *buf)
+{
+	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
+	int ret;
+
+	if (!md)
+		return -ENODEV;
+	ret = sprintf(buf, "card_max_packed_writes %u\n"
+		      "packed_cmds %lu\npacked_reqs %lu\n"
+		      "unpacked_writes %lu\npacked_failures %lu\n",
+		      md->queue.card->ext_csd.max_packed_writes,
+		      md->packed_stats.packed_cmds,
+		      md->packed_stats.packed_reqs,
+		      md->packed_stats.unpacked_wr,
+		      md->packed_stats.packed_fail);
+	mmc_blk_put(md);
+	return ret;
+}
+
+static DEVICE_ATTR(enable, S_IRUGO | S_IWUSR, packed_enable_show,
+		   packed_enable_store);
+static DEVICE_ATTR(max, S_IRUGO | S_IWUSR, packed_max_show,
+		   packed_max_store);
+static DEVICE_ATTR(stats, S_IRUGO, packed_stats_show, NULL);
+
+static struct attribute *mmc_blk_packed_attrs[] = {
+	&dev_attr_enable.attr,
+	&dev_attr_max.attr,
+	&dev_attr_stats.attr,
+	NULL,
+};
+
+static struct attribute_group mmc_blk_packed_attr_group = {
+	.name = "packed",
+	.attrs = mmc_blk_packed_attrs,
+};
+
 static int mmc_blk_probe(struct mmc_card *card)
 {
 	struct mmc_blk_data *md;
@@ -848,6 +1332,12 @@ static int mmc_blk_probe(struct mmc_card *card)
 	mmc_set_bus_resume_policy(card->host, 1);
 #endif
 	add_disk(md->disk);
+
+	if (card->ext_csd.packed_event_en &&
+	    sysfs_create_group(&disk_to_dev(md->disk)->kobj,
+			       &mmc_blk_packed_attr_group))
+		printk(KERN_WARNING "%s: unable to create packed attributes\n",
+		       md->disk->disk_name);
 	return 0;
 
  out:
@@ -862,6 +1352,10 @@ static void mmc_blk_remove(struct mmc_card *card)
 	struct mmc_blk_data *md = mmc_get_drvdata(card);
 
 	if (md) {
+		if (card->ext_csd.packed_event_en)
+			sysfs_remove_group(&disk_to_dev(md->disk)->kobj,
+					   &mmc_blk_packed_attr_group);
+
 		/* Stop new requests from getting into the queue */
 		del_gendisk(md->disk);
 
@@ -47,6 +47,7 @@ static int mmc_queue_thread(void *d)
 	struct mmc_queue *mq = d;
 	struct request_queue *q = mq->queue;
 	struct request *req;
+	struct mmc_queue_req *tmp;
 
 #ifdef CONFIG_MMC_PERF_PROFILING
 	ktime_t start, diff;
@@ -65,10 +66,10 @@ static int mmc_queue_thread(void *d)
 		set_current_state(TASK_INTERRUPTIBLE);
 		if (!blk_queue_plugged(q))
 			req = blk_fetch_request(q);
-		mq->req = req;
+		mq->mqrq_cur->req = req;
 		spin_unlock_irq(q->queue_lock);
 
-		if (!req) {
+		if (!req && !mq->mqrq_prev->req) {
 			if (kthread_should_stop()) {
 				set_current_state(TASK_RUNNING);
 				break;
@@ -80,26 +81,39 @@ static int mmc_queue_thread(void *d)
 		}
 		set_current_state(TASK_RUNNING);
 
+		/*
+		 * With a NULL req the request still in flight on the host
+		 * is completed; otherwise req is prepared and started while
+		 * the previous one finishes.
+		 */
 #ifdef CONFIG_MMC_PERF_PROFILING
-		bytes_xfer = blk_rq_bytes(req);
-		if (rq_data_dir(req) == READ) {
+		if (req) {
+			bytes_xfer = blk_rq_bytes(req);
 			start = ktime_get();
 			mq->issue_fn(mq, req);
 			diff = ktime_sub(ktime_get(), start);
-			host->perf.rbytes_mmcq += bytes_xfer;
-			host->perf.rtime_mmcq =
-				ktime_add(host->perf.rtime_mmcq, diff);
+			if (rq_data_dir(req) == READ) {
+				host->perf.rbytes_mmcq += bytes_xfer;
+				host->perf.rtime_mmcq =
+					ktime_add(host->perf.rtime_mmcq, diff);
+			} else {
+				host->perf.wbytes_mmcq += bytes_xfer;
+				host->perf.wtime_mmcq =
+					ktime_add(host->perf.wtime_mmcq, diff);
+			}
 		} else {
-			start = ktime_get();
 			mq->issue_fn(mq, req);
-			diff = ktime_sub(ktime_get(), start);
-			host->perf.wbytes_mmcq += bytes_xfer;
-			host->perf.wtime_mmcq =
-				ktime_add(host->perf.wtime_mmcq, diff);
 		}
 #else
-			mq->issue_fn(mq, req);
+		mq->issue_fn(mq, req);
 #endif
+
+		/* Current request becomes previous request and vice versa. */
+		mq->mqrq_prev->brq.mrq.data = NULL;
+		mq->mqrq_prev->req = NULL;
+		tmp = mq->mqrq_prev;
+		mq->mqrq_prev = mq->mqrq_cur;
+		mq->mqrq_cur = tmp;
 	} while (1);
 	up(&mq->thread_sem);
 
@@ -125,10 +139,32 @@ static void mmc_request(struct request_queue *q)
 		return;
 	}
 
-	if (!mq->req)
+	if (!mq->mqrq_cur->req && !mq->mqrq_prev->req)
 		wake_up_process(mq->thread);
 }
 
+static void mmc_queue_free_reqs(struct mmc_queue *mq)
+{
+	struct mmc_queue_req *mqrq;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(mq->mqrq); i++) {
+		mqrq = &mq->mqrq[i];
+
+		kfree(mqrq->bounce_sg);
+		mqrq->bounce_sg = NULL;
+
+		kfree(mqrq->sg);
+		mqrq->sg = NULL;
+
+		kfree(mqrq->bounce_buf);
+		mqrq->bounce_buf = NULL;
+
+		kfree(mqrq->packed_cmd_hdr);
+		mqrq->packed_cmd_hdr = NULL;
+	}
+}
+
 /**
  * mmc_init_queue - initialise a queue structure.
  * @mq: mmc queue
@@ -140,8 +176,9 @@ static void mmc_request(struct request_queue *q)
 int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card, spinlock_t *lock)
 {
 	struct mmc_host *host = card->host;
+	struct mmc_queue_req *mqrq;
 	u64 limit = BLK_BOUNCE_HIGH;
-	int ret;
+	int i, ret;
 
 	if (mmc_dev(host)->dma_mask && *mmc_dev(host)->dma_mask)
 		limit = *mmc_dev(host)->dma_mask;
@@ -151,8 +188,12 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card, spinlock_t *lock
 	if (!mq->queue)
 		return -ENOMEM;
 
+	memset(&mq->mqrq, 0, sizeof(mq->mqrq));
+	mq->mqrq_cur = &mq->mqrq[0];
+	mq->mqrq_prev = &mq->mqrq[1];
+	for (i = 0; i < ARRAY_SIZE(mq->mqrq); i++)
+		INIT_LIST_HEAD(&mq->mqrq[i].packed_list);
 	mq->queue->queuedata = mq;
-	mq->req = NULL;
 
 	blk_queue_prep_rq(mq->queue, mmc_prep_request);
 	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, mq->queue);
@@ -170,6 +211,10 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card, spinlock_t *lock
 		if (mmc_can_secure_erase_trim(card))
 			queue_flag_set_unlocked(QUEUE_FLAG_SECDISCARD,
 						mq->queue);
+		/* let filesystems pack writes into erase units */
+		if (card->pref_erase)
+			blk_queue_io_opt(mq->queue, card->pref_erase << 9);
+		blk_queue_discard_defer(mq->queue, true);
 	}
 
 #ifdef CONFIG_MMC_BLOCK_BOUNCE
@@ -186,53 +231,85 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card, spinlock_t *lock
 			bouncesz = host->max_blk_count * 512;
 
 		if (bouncesz > 512) {
-			mq->bounce_buf = kmalloc(bouncesz, GFP_KERNEL);
-			if (!mq->bounce_buf) {
-				printk(KERN_WARNING "%s: unable to "
-					"allocate bounce buffer\n",
-					mmc_card_name(card));
+			for (i = 0; i < ARRAY_SIZE(mq->mqrq); i++) {
+				mqrq = &mq->mqrq[i];
+				mqrq->bounce_buf = kmalloc(bouncesz,
+							   GFP_KERNEL);
+				if (!mqrq->bounce_buf) {
+					printk(KERN_WARNING "%s: unable to "
+						"allocate bounce buffer\n",
+						mmc_card_name(card));
+					break;
+				}
+			}
+			/* Both requests bounce or neither does */
+			if (i < ARRAY_SIZE(mq->mqrq)) {
+				for (i = 0; i < ARRAY_SIZE(mq->mqrq); i++) {
+					kfree(mq->mqrq[i].bounce_buf);
+					mq->mqrq[i].bounce_buf = NULL;
+				}
 			}
 		}
 
-		if (mq->bounce_buf) {
+		if (mq->mqrq_cur->bounce_buf) {
 			blk_queue_bounce_limit(mq->queue, BLK_BOUNCE_ANY);
 			blk_queue_max_hw_sectors(mq->queue, bouncesz / 512);
 			blk_queue_max_segments(mq->queue, bouncesz / 512);
 			blk_queue_max_segment_size(mq->queue, bouncesz);
 
-			mq->sg = kmalloc(sizeof(struct scatterlist),
-				GFP_KERNEL);
-			if (!mq->sg) {
-				ret = -ENOMEM;
-				goto cleanup_queue;
+			for (i = 0; i < ARRAY_SIZE(mq->mqrq); i++) {
+				mqrq = &mq->mqrq[i];
+				mqrq->sg = kmalloc(sizeof(struct scatterlist),
+					GFP_KERNEL);
+				if (!mqrq->sg) {
+					ret = -ENOMEM;
+					goto cleanup_queue;
+				}
+				sg_init_table(mqrq->sg, 1);
+
+				mqrq->bounce_sg = kmalloc(
+					sizeof(struct scatterlist) *
+					bouncesz / 512, GFP_KERNEL);
+				if (!mqrq->bounce_sg) {
+					ret = -ENOMEM;
+					goto cleanup_queue;
+				}
+				sg_init_table(mqrq->bounce_sg, bouncesz / 512);
 			}
-			sg_init_table(mq->sg, 1);
-
-			mq->bounce_sg = kmalloc(sizeof(struct scatterlist) *
-				bouncesz / 512, GFP_KERNEL);
-			if (!mq->bounce_sg) {
-				ret = -ENOMEM;
-				goto cleanup_queue;
-			}
-			sg_init_table(mq->bounce_sg, bouncesz / 512);
 		}
 	}
 #endif
 
-	if (!mq->bounce_buf) {
+	if (!mq->mqrq_cur->bounce_buf) {
 		blk_queue_bounce_limit(mq->queue, limit);
 		blk_queue_max_hw_sectors(mq->queue,
 			min(host->max_blk_count, host->max_req_size / 512));
 		blk_queue_max_segments(mq->queue, host->max_segs);
 		blk_queue_max_segment_size(mq->queue, host->max_seg_size);
 
-		mq->sg = kmalloc(sizeof(struct scatterlist) *
-			host->max_segs, GFP_KERNEL);
-		if (!mq->sg) {
-			ret = -ENOMEM;
-			goto cleanup_queue;
+		for (i = 0; i < ARRAY_SIZE(mq->mqrq); i++) {
+			mqrq = &mq->mqrq[i];
+			mqrq->sg = kmalloc(sizeof(struct scatterlist) *
+				host->max_segs, GFP_KERNEL);
+			if (!mqrq->sg) {
+				ret = -ENOMEM;
+				goto cleanup_queue;
+			}
+			sg_init_table(mqrq->sg, host->max_segs);
+		}
+	}
+
+	/* Header block for eMMC 4.5 packed commands */
+	if (mmc_card_mmc(card) && card->ext_csd.packed_event_en) {
+		for (i = 0; i < ARRAY_SIZE(mq->mqrq); i++) {
+			mqrq = &mq->mqrq[i];
+			mqrq->packed_cmd_hdr = kzalloc(MMC_PACKED_HDR_SIZE,
+						       GFP_KERNEL);
+			if (!mqrq->packed_cmd_hdr)
+				printk(KERN_WARNING "%s: unable to "
+					"allocate packed header\n",
+					mmc_card_name(card));
 		}
-		sg_init_table(mq->sg, host->max_segs);
 	}
 
 	sema_init(&mq->thread_sem, 1);
@@ -242,21 +319,12 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card, spinlock_t *lock
 
 	if (IS_ERR(mq->thread)) {
 		ret = PTR_ERR(mq->thread);
-		goto free_bounce_sg;
+		goto cleanup_queue;
 	}
 
 	return 0;
- free_bounce_sg:
- 	if (mq->bounce_sg)
- 		kfree(mq->bounce_sg);
- 	mq->bounce_sg = NULL;
  cleanup_queue:
- 	if (mq->sg)
-		kfree(mq->sg);
-	mq->sg = NULL;
-	if (mq->bounce_buf)
-		kfree(mq->bounce_buf);
-	mq->bounce_buf = NULL;
+	mmc_queue_free_reqs(mq);
 	blk_cleanup_queue(mq->queue);
 	return ret;
 }
@@ -278,16 +346,7 @@ void mmc_cleanup_queue(struct mmc_queue *mq)
 	blk_start_queue(q);
 	spin_unlock_irqrestore(q->queue_lock, flags);
 
- 	if (mq->bounce_sg)
- 		kfree(mq->bounce_sg);
- 	mq->bounce_sg = NULL;
-
-	kfree(mq->sg);
-	mq->sg = NULL;
-
-	if (mq->bounce_buf)
-		kfree(mq->bounce_buf);
-	mq->bounce_buf = NULL;
+	mmc_queue_free_reqs(mq);
 
 	mq->card = NULL;
 }
@@ -340,27 +399,66 @@ void mmc_queue_resume(struct mmc_queue *mq)
 /*
  * Prepare the sg list(s) to be handed of to the host driver
  */
-unsigned int mmc_queue_map_sg(struct mmc_queue *mq)
+unsigned int mmc_queue_map_sg(struct mmc_queue *mq, struct mmc_queue_req *mqrq)
 {
 	unsigned int sg_len;
 	size_t buflen;
 	struct scatterlist *sg;
 	int i;
 
-	if (!mq->bounce_buf)
-		return blk_rq_map_sg(mq->queue, mq->req, mq->sg);
+	if (!mqrq->bounce_buf)
+		return blk_rq_map_sg(mq->queue, mqrq->req, mqrq->sg);
 
-	BUG_ON(!mq->bounce_sg);
+	BUG_ON(!mqrq->bounce_sg);
 
-	sg_len = blk_rq_map_sg(mq->queue, mq->req, mq->bounce_sg);
+	sg_len = blk_rq_map_sg(mq->queue, mqrq->req, mqrq->bounce_sg);
 
-	mq->bounce_sg_len = sg_len;
+	mqrq->bounce_sg_len = sg_len;
 
 	buflen = 0;
-	for_each_sg(mq->bounce_sg, sg, sg_len, i)
+	for_each_sg(mqrq->bounce_sg, sg, sg_len, i)
 		buflen += sg->length;
 
-	sg_init_one(mq->sg, mq->bounce_buf, buflen);
+	sg_init_one(mqrq->sg, mqrq->bounce_buf, buflen);
+
+	return 1;
+}
+
+/*
+ * Prepare the sg list of a packed command: the header block followed by
+ * the data of every request in the packed list.  With a bounce buffer the
+ * list is built in bounce_sg and the host sees the one buffer it is
+ * copied to.
+ */
+unsigned int mmc_queue_packed_map_sg(struct mmc_queue *mq,
+				     struct mmc_queue_req *mqrq)
+{
+	struct scatterlist *sg, *sgl;
+	struct request *req;
+	unsigned int sg_len = 1;
+	size_t buflen;
+	int i;
+
+	sgl = mqrq->bounce_buf ? mqrq->bounce_sg : mqrq->sg;
+	sg_set_buf(sgl, mqrq->packed_cmd_hdr, MMC_PACKED_HDR_SIZE);
+
+	list_for_each_entry(req, &mqrq->packed_list, queuelist) {
+		/* blk_rq_map_sg() ends the list after each request */
+		sg_unmark_end(&sgl[sg_len - 1]);
+		sg_len += blk_rq_map_sg(mq->queue, req, &sgl[sg_len]);
+	}
+	sg_mark_end(&sgl[sg_len - 1]);
+
+	if (!mqrq->bounce_buf)
+		return sg_len;
+
+	mqrq->bounce_sg_len = sg_len;
+
+	buflen = 0;
+	for_each_sg(mqrq->bounce_sg, sg, sg_len, i)
+		buflen += sg->length;
+
+	sg_init_one(mqrq->sg, mqrq->bounce_buf, buflen);
 
 	return 1;
 }
@@ -369,19 +467,19 @@ unsigned int mmc_queue_map_sg(struct mmc_queue *mq)
  * If writing, bounce the data to the buffer before the request
  * is sent to the host driver
  */
-void mmc_queue_bounce_pre(struct mmc_queue *mq)
+void mmc_queue_bounce_pre(struct mmc_queue_req *mqrq)
 {
 	unsigned long flags;
 
-	if (!mq->bounce_buf)
+	if (!mqrq->bounce_buf)
 		return;
 
-	if (rq_data_dir(mq->req) != WRITE)
+	if (rq_data_dir(mqrq->req) != WRITE)
 		return;
 
 	local_irq_save(flags);
-	sg_copy_to_buffer(mq->bounce_sg, mq->bounce_sg_len,
-		mq->bounce_buf, mq->sg[0].length);
+	sg_copy_to_buffer(mqrq->bounce_sg, mqrq->bounce_sg_len,
+		mqrq->bounce_buf, mqrq->sg[0].length);
 	local_irq_restore(flags);
 }
 
@@ -389,19 +487,18 @@ void mmc_queue_bounce_pre(struct mmc_queue *mq)
  * If reading, bounce the data from the buffer after the request
  * has been handled by the host driver
  */
-void mmc_queue_bounce_post(struct mmc_queue *mq)
+void mmc_queue_bounce_post(struct mmc_queue_req *mqrq)
 {
 	unsigned long flags;
 
-	if (!mq->bounce_buf)
+	if (!mqrq->bounce_buf)
 		return;
 
-	if (rq_data_dir(mq->req) != READ)
+	if (rq_data_dir(mqrq->req) != READ)
 		return;
 
 	local_irq_save(flags);
-	sg_copy_from_buffer(mq->bounce_sg, mq->bounce_sg_len,
-		mq->bounce_buf, mq->sg[0].length);
+	sg_copy_from_buffer(mqrq->bounce_sg, mqrq->bounce_sg_len,
+		mqrq->bounce_buf, mqrq->sg[0].length);
 	local_irq_restore(flags);
 }
-
@@ -40,6 +40,9 @@
 #include "sd_ops.h"
 #include "sdio_ops.h"
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/mmc.h>
+
 static struct workqueue_struct *workqueue;
 static struct wake_lock mmc_delayed_work_wake_lock;
 
@@ -150,6 +153,10 @@ void mmc_request_done(struct mmc_host *host, struct mmc_request *mrq)
 				mrq->stop->resp[2], mrq->stop->resp[3]);
 		}
 
+		trace_mmc_request_done(host, mrq);
+#ifdef CONFIG_MMC_LATENCY_HIST
+		mrq->completed = ktime_get();
+#endif
 		if (mrq->done)
 			mrq->done(mrq);
 
@@ -218,14 +225,221 @@ mmc_start_request(struct mmc_host *host, struct mmc_request *mrq)
 #endif
 	}
 	mmc_host_clk_ungate(host);
+	trace_mmc_request_start(host, mrq);
+#ifdef CONFIG_MMC_LATENCY_HIST
+	mrq->cmd_done = mrq->data_done = ktime_set(0, 0);
+	mrq->started = ktime_get();
+#endif
 	host->ops->request(host, mrq);
 }
 
+#ifdef CONFIG_MMC_LATENCY_HIST
+static enum mmc_lat_class mmc_latency_class(struct mmc_request *mrq)
+{
+	if (mrq->data)
+		return mrq->data->flags & MMC_DATA_WRITE ?
+			MMC_LAT_WRITE : MMC_LAT_READ;
+	if (mrq->cmd->opcode == MMC_ERASE)
+		return MMC_LAT_DISCARD;
+	return MMC_LAT_OTHER;
+}
+
+static void mmc_latency_set_queued(struct mmc_request *mrq)
+{
+	mrq->queued = ktime_get();
+	mrq->started = mrq->completed = ktime_set(0, 0);
+}
+
+static ktime_t mmc_latency_check_start(void)
+{
+	return ktime_get();
+}
+
+/*
+ * Account a finished request.  The time since @check, when the caller
+ * started checking the result, is mostly spent polling the card until
+ * it leaves the programming state and belongs to the busy phase.
+ */
+static void mmc_latency_account(struct mmc_host *host,
+				struct mmc_request *mrq, ktime_t check)
+{
+	struct mmc_latency_hist *lh = &host->lat_hist;
+	ktime_t cmd_done, data_done;
+	s64 us[MMC_LAT_NR_PHASES], check_us = 0;
+	enum mmc_lat_class class = mmc_latency_class(mrq);
+	int i, bucket;
+
+	/* never reached the host, e.g. SET_BLOCK_COUNT failed */
+	if (!mrq->started.tv64 || !mrq->completed.tv64)
+		return;
+
+	if (check.tv64)
+		check_us = ktime_us_delta(ktime_get(), check);
+
+	cmd_done = mrq->cmd_done.tv64 ? mrq->cmd_done : mrq->started;
+	if (!mrq->data)
+		data_done = cmd_done;
+	else if (mrq->data_done.tv64)
+		data_done = mrq->data_done;
+	else
+		data_done = mrq->completed;
+
+	us[MMC_LAT_QUEUE] = ktime_us_delta(mrq->started, mrq->queued);
+	us[MMC_LAT_ISSUE] = ktime_us_delta(cmd_done, mrq->started);
+	us[MMC_LAT_DMA] = ktime_us_delta(data_done, cmd_done);
+	us[MMC_LAT_BUSY] = ktime_us_delta(mrq->completed, data_done) +
+			   check_us;
+	us[MMC_LAT_TOTAL] = ktime_us_delta(mrq->completed, mrq->queued) +
+			    check_us;
+
+	spin_lock(&lh->lock);
+	lh->count[class]++;
+	for (i = 0; i < MMC_LAT_NR_PHASES; i++) {
+		if (i == MMC_LAT_DMA && !mrq->data)
+			continue;
+		us[i] = clamp_t(s64, us[i], 0, UINT_MAX);
+		bucket = min(fls((u32) us[i]), MMC_LAT_BUCKETS - 1);
+		lh->hist[class][i][bucket]++;
+		if (us[i] > lh->max_us[class][i])
+			lh->max_us[class][i] = us[i];
+	}
+	spin_unlock(&lh->lock);
+}
+#else
+static inline void mmc_latency_set_queued(struct mmc_request *mrq) {}
+static inline ktime_t mmc_latency_check_start(void)
+{
+	return ktime_set(0, 0);
+}
+static inline void mmc_latency_account(struct mmc_host *host,
+				       struct mmc_request *mrq, ktime_t check)
+{}
+#endif
+
 static void mmc_wait_done(struct mmc_request *mrq)
 {
-	complete(mrq->done_data);
+	complete(&mrq->completion);
+}
+
+static void __mmc_start_req(struct mmc_host *host, struct mmc_request *mrq)
+{
+	int err;
+
+	init_completion(&mrq->completion);
+	mrq->done = mmc_wait_done;
+
+	/*
+	 * Hosts without MMC_CAP_CMD23 ignore mrq->sbc. Requests that
+	 * cannot do without a predefined block count (packed commands)
+	 * still set it; send SET_BLOCK_COUNT for them from here.
+	 */
+	if (mrq->sbc && !mmc_host_cmd23(host)) {
+		err = mmc_wait_for_cmd(host, mrq->sbc, 0);
+		if (err) {
+			mrq->cmd->error = err;
+			complete(&mrq->completion);
+			return;
+		}
+	}
+
+	mmc_start_request(host, mrq);
+}
+
+static void mmc_wait_for_req_done(struct mmc_host *host,
+				  struct mmc_request *mrq)
+{
+	wait_for_completion_io(&mrq->completion);
 }
 
+/**
+ *	mmc_pre_req - Prepare for a new request
+ *	@host: MMC host to prepare command
+ *	@mrq: MMC request to prepare for
+ *	@is_first_req: true if no previously started request may run in
+ *		parallel to this call
+ *
+ *	mmc_pre_req() is called before mmc_start_req() to let the host
+ *	prepare the new request, e.g. map it for DMA. Preparation of a
+ *	request may be done while another request is running on the host.
+ */
+static void mmc_pre_req(struct mmc_host *host, struct mmc_request *mrq,
+			bool is_first_req)
+{
+	if (host->ops->pre_req)
+		host->ops->pre_req(host, mrq, is_first_req);
+}
+
+/**
+ *	mmc_post_req - Post process a completed request
+ *	@host: MMC host to post process command
+ *	@mrq: MMC request to post process for
+ *	@err: Error, if non zero, clean up any resources made in pre_req
+ *
+ *	Let the host post process a completed request. Post processing of
+ *	a request may be performed while another request is running.
+ */
+static void mmc_post_req(struct mmc_host *host, struct mmc_request *mrq,
+			 int err)
+{
+	if (host->ops->post_req)
+		host->ops->post_req(host, mrq, err);
+}
+
+/**
+ *	mmc_start_req - start a non-blocking request
+ *	@host: MMC host to start command
+ *	@areq: async request to start
+ *	@error: out parameter returns 0 for success, otherwise non zero
+ *
+ *	Start a new MMC custom command request for a host. If there is
+ *	an ongoing async request, wait for it to complete, start the new
+ *	one and return. Does not wait for the new request to complete.
+ *
+ *	Returns the completed request, or NULL without waiting if no
+ *	request was ongoing. NULL is not an error condition.
+ */
+struct mmc_async_req *mmc_start_req(struct mmc_host *host,
+				    struct mmc_async_req *areq, int *error)
+{
+	int err = 0;
+	struct mmc_async_req *data = host->areq;
+	ktime_t check;
+
+	/* Prepare a new request */
+	if (areq) {
+		mmc_latency_set_queued(areq->mrq);
+		mmc_pre_req(host, areq->mrq, !host->areq);
+	}
+
+	if (host->areq) {
+		mmc_wait_for_req_done(host, host->areq->mrq);
+		check = mmc_latency_check_start();
+		err = host->areq->err_check(host->card, host->areq);
+		mmc_latency_account(host, host->areq->mrq, check);
+		if (err) {
+			mmc_post_req(host, host->areq->mrq, 0);
+			if (areq)
+				mmc_post_req(host, areq->mrq, -EINVAL);
+
+			host->areq = NULL;
+			goto out;
+		}
+	}
+
+	if (areq)
+		__mmc_start_req(host, areq->mrq);
+
+	if (host->areq)
+		mmc_post_req(host, host->areq->mrq, 0);
+
+	host->areq = areq;
+ out:
+	if (error)
+		*error = err;
+	return data;
+}
+EXPORT_SYMBOL(mmc_start_req);
+
 /**
  *	mmc_wait_for_req - start a request and wait for completion
  *	@host: MMC host to start command
@@ -237,14 +451,10 @@ static void mmc_wait_done(struct mmc_request *mrq)
  */
 void mmc_wait_for_req(struct mmc_host *host, struct mmc_request *mrq)
 {
-	DECLARE_COMPLETION_ONSTACK(complete);
-
-	mrq->done_data = &complete;
-	mrq->done = mmc_wait_done;
-
-	mmc_start_request(host, mrq);
-
-	wait_for_completion_io(&complete);
+	mmc_latency_set_queued(mrq);
+	__mmc_start_req(host, mrq);
+	mmc_wait_for_req_done(host, mrq);
+	mmc_latency_account(host, mrq, ktime_set(0, 0));
 }
 
 EXPORT_SYMBOL(mmc_wait_for_req);
@@ -161,6 +161,93 @@ static int mmc_clock_opt_set(void *data, u64 val)
 DEFINE_SIMPLE_ATTRIBUTE(mmc_clock_fops, mmc_clock_opt_get, mmc_clock_opt_set,
 	"%llu\n");
 
+#ifdef CONFIG_MMC_LATENCY_HIST
+static int mmc_latency_show(struct seq_file *s, void *data)
+{
+	static const char *class_str[MMC_LAT_NR_CLASSES] = {
+		[MMC_LAT_READ]		= "read",
+		[MMC_LAT_WRITE]		= "write",
+		[MMC_LAT_DISCARD]	= "discard",
+		[MMC_LAT_OTHER]		= "other",
+	};
+	struct mmc_host *host = s->private;
+	struct mmc_latency_hist *lh;
+	int c, p, b;
+
+	lh = kmalloc(sizeof(*lh), GFP_KERNEL);
+	if (!lh)
+		return -ENOMEM;
+
+	spin_lock(&host->lat_hist.lock);
+	memcpy(lh, &host->lat_hist, sizeof(*lh));
+	spin_unlock(&host->lat_hist.lock);
+
+	for (c = 0; c < MMC_LAT_NR_CLASSES; c++) {
+		if (!lh->count[c])
+			continue;
+
+		seq_printf(s, "%s: %lu requests\n", class_str[c],
+			   lh->count[c]);
+		seq_printf(s, "%10s %9s %9s %9s %9s %9s\n", "usecs",
+			   "queue", "issue", "dma", "busy", "total");
+		for (b = 0; b < MMC_LAT_BUCKETS; b++) {
+			u32 sum = 0;
+
+			for (p = 0; p < MMC_LAT_NR_PHASES; p++)
+				sum += lh->hist[c][p][b];
+			if (!sum)
+				continue;
+
+			if (!b)
+				seq_printf(s, "%10s", "<1");
+			else if (b == MMC_LAT_BUCKETS - 1)
+				seq_printf(s, "%9u+", 1U << (b - 1));
+			else
+				seq_printf(s, "%10u", 1U << (b - 1));
+			for (p = 0; p < MMC_LAT_NR_PHASES; p++)
+				seq_printf(s, " %9u", lh->hist[c][p][b]);
+			seq_printf(s, "\n");
+		}
+		seq_printf(s, "%10s", "max");
+		for (p = 0; p < MMC_LAT_NR_PHASES; p++)
+			seq_printf(s, " %9u", lh->max_us[c][p]);
+		seq_printf(s, "\n\n");
+	}
+
+	kfree(lh);
+	return 0;
+}
+
+static int mmc_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mmc_latency_show, inode->i_private);
+}
+
+static ssize_t mmc_latency_write(struct file *file, const char __user *buf,
+				 size_t count, loff_t *ppos)
+{
+	struct seq_file *sf = file->private_data;
+	struct mmc_host *host = sf->private;
+	struct mmc_latency_hist *lh = &host->lat_hist;
+
+	spin_lock(&lh->lock);
+	memset(lh->count, 0, sizeof(lh->count));
+	memset(lh->max_us, 0, sizeof(lh->max_us));
+	memset(lh->hist, 0, sizeof(lh->hist));
+	spin_unlock(&lh->lock);
+
+	return count;
+}
+
+static const struct file_operations mmc_latency_fops = {
+	.open		= mmc_latency_open,
+	.read		= seq_read,
+	.write		= mmc_latency_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#endif
+
 void mmc_add_host_debugfs(struct mmc_host *host)
 {
 	struct dentry *root;
@@ -187,6 +274,11 @@ void mmc_add_host_debugfs(struct mmc_host *host)
 	if (!debugfs_create_u32("clk_delay", (S_IRUSR | S_IWUSR),
 				root, &host->clk_delay))
 		goto err_node;
+#endif
+#ifdef CONFIG_MMC_LATENCY_HIST
+	if (!debugfs_create_file("latency", S_IRUSR | S_IWUSR, root, host,
+			&mmc_latency_fops))
+		goto err_node;
 #endif
 	return;
 
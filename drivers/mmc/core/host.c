@@ -285,6 +285,9 @@ struct mmc_host *mmc_alloc_host(int extra, struct device *dev)
 	mmc_host_clk_init(host);
 
 	spin_lock_init(&host->lock);
+#ifdef CONFIG_MMC_LATENCY_HIST
+	spin_lock_init(&host->lat_hist.lock);
+#endif
 	init_waitqueue_head(&host->wq);
 	INIT_DELAYED_WORK(&host->detect, mmc_rescan);
 	INIT_DELAYED_WORK_DEFERRABLE(&host->disable, mmc_host_deeper_disable);
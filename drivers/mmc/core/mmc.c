@@ -238,7 +238,7 @@ static int mmc_read_ext_csd(struct mmc_card *card)
 	}
 
 	card->ext_csd.rev = ext_csd[EXT_CSD_REV];
-	if (card->ext_csd.rev > 5) {
+	if (card->ext_csd.rev > 6) {
 		printk(KERN_ERR "%s: unrecognised EXT_CSD revision %d\n",
 			mmc_hostname(card->host), card->ext_csd.rev);
 		err = -EINVAL;
@@ -317,6 +317,14 @@ static int mmc_read_ext_csd(struct mmc_card *card)
 	if (card->ext_csd.rev >= 5)
 		card->ext_csd.rel_param = ext_csd[EXT_CSD_WR_REL_PARAM];
 
+	/* eMMC v4.5 or later */
+	if (card->ext_csd.rev >= 6) {
+		card->ext_csd.max_packed_writes =
+			ext_csd[EXT_CSD_MAX_PACKED_WRITES];
+		card->ext_csd.max_packed_reads =
+			ext_csd[EXT_CSD_MAX_PACKED_READS];
+	}
+
 	if (ext_csd[EXT_CSD_ERASED_MEM_CONT])
 		card->erased_byte = 0xFF;
 	else
@@ -492,6 +500,27 @@ static int mmc_init_card(struct mmc_host *host, u32 ocr,
 			mmc_card_set_blockaddr(card);
 	}
 
+	/*
+	 * Enable the packed command exception event, so that the index of
+	 * a failed packed entry can be read back (if supported)
+	 */
+	if (card->ext_csd.max_packed_writes > 0) {
+		err = mmc_switch(card, EXT_CSD_CMD_SET_NORMAL,
+				 EXT_CSD_EXP_EVENTS_CTRL,
+				 EXT_CSD_PACKED_EVENT_EN);
+		if (err && err != -EBADMSG)
+			goto free_card;
+
+		if (err) {
+			printk(KERN_WARNING "%s: enabling packed event "
+			       "failed\n", mmc_hostname(card->host));
+			card->ext_csd.packed_event_en = false;
+			err = 0;
+		} else {
+			card->ext_csd.packed_event_en = true;
+		}
+	}
+
 	/*
 	 * Activate high speed (if supported)
 	 */
@@ -378,8 +378,9 @@ msmsdcc_dma_complete_tlet(unsigned long data)
 		if (!mrq->data->error)
 			mrq->data->error = -EIO;
 	}
-	dma_unmap_sg(mmc_dev(host->mmc), host->dma.sg, host->dma.num_ents,
-		     host->dma.dir);
+	if (!mrq->data->host_cookie)
+		dma_unmap_sg(mmc_dev(host->mmc), host->dma.sg,
+			     host->dma.num_ents, host->dma.dir);
 
 	if (host->curr.user_pages) {
 		struct scatterlist *sg = host->dma.sg;
@@ -537,9 +538,10 @@ static void msmsdcc_sps_complete_tlet(unsigned long data)
 			mrq->data->error = -EIO;
 	}
 
-	/* Unmap sg buffers */
-	dma_unmap_sg(mmc_dev(host->mmc), host->sps.sg, host->sps.num_ents,
-			 host->sps.dir);
+	/* Unmap sg buffers, unless mapped by msmsdcc_pre_req() */
+	if (!mrq->data->host_cookie)
+		dma_unmap_sg(mmc_dev(host->mmc), host->sps.sg,
+			     host->sps.num_ents, host->sps.dir);
 
 	host->sps.sg = NULL;
 	host->sps.busy = 0;
@@ -593,9 +595,10 @@ static void msmsdcc_sps_exit_curr_xfer(struct msmsdcc_host *host)
 	if (!mrq->data->error)
 		mrq->data->error = -EIO;
 
-	/* Unmap sg buffers */
-	dma_unmap_sg(mmc_dev(host->mmc), host->sps.sg, host->sps.num_ents,
-			 host->sps.dir);
+	/* Unmap sg buffers, unless mapped by msmsdcc_pre_req() */
+	if (!mrq->data->host_cookie)
+		dma_unmap_sg(mmc_dev(host->mmc), host->sps.sg,
+			     host->sps.num_ents, host->sps.dir);
 
 	host->sps.sg = NULL;
 	host->sps.busy = 0;
@@ -641,6 +644,15 @@ static int msmsdcc_check_dma_op_req(struct mmc_data *data)
 		return 0;
 }
 
+static inline enum dma_data_direction
+msmsdcc_get_dma_dir(struct mmc_data *data)
+{
+	if (data->flags & MMC_DATA_READ)
+		return DMA_FROM_DEVICE;
+	else
+		return DMA_TO_DEVICE;
+}
+
 static int msmsdcc_config_dma(struct msmsdcc_host *host, struct mmc_data *data)
 {
 	struct msmsdcc_nc_dmadata *nc;
@@ -718,9 +730,15 @@ static int msmsdcc_config_dma(struct msmsdcc_host *host, struct mmc_data *data)
 	host->dma.hdr.complete_func = msmsdcc_dma_complete_func;
 	host->dma.hdr.crci_mask = msm_dmov_build_crci_mask(1, host->dma.crci);
 
-	n = dma_map_sg(mmc_dev(host->mmc), host->dma.sg,
-			host->dma.num_ents, host->dma.dir);
-	/* dsb inside dma_map_sg will write nc out to mem as well */
+	if (data->host_cookie) {
+		/* already mapped by msmsdcc_pre_req(); write nc out to mem */
+		wmb();
+		n = host->dma.num_ents;
+	} else {
+		n = dma_map_sg(mmc_dev(host->mmc), host->dma.sg,
+				host->dma.num_ents, host->dma.dir);
+		/* dsb inside dma_map_sg will write nc out to mem as well */
+	}
 
 	if (n != host->dma.num_ents) {
 		pr_err("%s: Unable to map in all sg elements\n",
@@ -770,8 +788,11 @@ static int msmsdcc_sps_start_xfer(struct msmsdcc_host *host,
 	}
 
 	/* Make sg buffers DMA ready */
-	rc = dma_map_sg(mmc_dev(host->mmc), data->sg, data->sg_len,
-			host->sps.dir);
+	if (data->host_cookie)
+		rc = data->sg_len;
+	else
+		rc = dma_map_sg(mmc_dev(host->mmc), data->sg, data->sg_len,
+				host->sps.dir);
 
 	if (rc != data->sg_len) {
 		pr_err("%s: Unable to map in all sg elements, rc=%d\n",
@@ -823,8 +844,9 @@ static int msmsdcc_sps_start_xfer(struct msmsdcc_host *host,
 
 dma_map_err:
 	/* unmap sg buffers */
-	dma_unmap_sg(mmc_dev(host->mmc), host->sps.sg, host->sps.num_ents,
-			host->sps.dir);
+	if (!data->host_cookie)
+		dma_unmap_sg(mmc_dev(host->mmc), host->sps.sg,
+			     host->sps.num_ents, host->sps.dir);
 out:
 	return rc;
 }
@@ -933,6 +955,12 @@ msmsdcc_start_data(struct msmsdcc_host *host, struct mmc_data *data,
 
 	/* Is data transfer in PIO mode required? */
 	if (!(datactrl & MCI_DPSM_DMAENABLE)) {
+		/* give buffers mapped by msmsdcc_pre_req() back to the CPU */
+		if (data->host_cookie) {
+			dma_unmap_sg(mmc_dev(host->mmc), data->sg,
+				     data->sg_len, msmsdcc_get_dma_dir(data));
+			data->host_cookie = 0;
+		}
 		host->pio.sg = data->sg;
 		host->pio.sg_len = data->sg_len;
 		host->pio.sg_off = 0;
@@ -1237,6 +1265,8 @@ static void msmsdcc_do_cmdirq(struct msmsdcc_host *host, uint32_t status)
 	cmd->resp[1] = readl_relaxed(host->base + MMCIRESPONSE1);
 	cmd->resp[2] = readl_relaxed(host->base + MMCIRESPONSE2);
 	cmd->resp[3] = readl_relaxed(host->base + MMCIRESPONSE3);
+	if (cmd->mrq && cmd == cmd->mrq->cmd)
+		mmc_latency_cmd_done(cmd->mrq);
 
 	if (status & (MCI_CMDTIMEOUT | MCI_AUTOCMD19TIMEOUT)) {
 		pr_debug("%s: Command timeout\n", mmc_hostname(host->mmc));
@@ -1414,8 +1444,10 @@ msmsdcc_irq(int irq, void *dev_id)
 			}
 
 			/* Check for data done */
-			if (!host->curr.got_dataend && (status & MCI_DATAEND))
+			if (!host->curr.got_dataend && (status & MCI_DATAEND)) {
 				host->curr.got_dataend = 1;
+				mmc_latency_data_done(data->mrq);
+			}
 
 			if (host->curr.got_dataend) {
 				/*
@@ -2609,9 +2641,59 @@ out:
 	return rc;
 }
 
+/*
+ * Map the next request for DMA while the current one is transferring,
+ * so that the cache maintenance in dma_map_sg() is off the critical
+ * path.  data->host_cookie tells the transfer and completion paths the
+ * buffers are already mapped; msmsdcc_post_req() unmaps them.
+ */
+static void msmsdcc_pre_req(struct mmc_host *mmc, struct mmc_request *mrq,
+			    bool is_first_req)
+{
+	struct msmsdcc_host *host = mmc_priv(mmc);
+	struct mmc_data *data = mrq->data;
+	int n;
+
+	if (!data)
+		return;
+
+	data->host_cookie = 0;
+
+	if (msmsdcc_check_dma_op_req(data))
+		return;
+	if (!host->is_sps_mode && !(host->is_dma_mode &&
+	    host->dma.channel != -1 && host->dma.crci != -1))
+		return;
+
+	n = dma_map_sg(mmc_dev(mmc), data->sg, data->sg_len,
+		       msmsdcc_get_dma_dir(data));
+	if (n != data->sg_len) {
+		pr_err("%s: %s: Unable to map in all sg elements\n",
+		       mmc_hostname(mmc), __func__);
+		return;
+	}
+
+	data->host_cookie = 1;
+}
+
+static void msmsdcc_post_req(struct mmc_host *mmc, struct mmc_request *mrq,
+			     int err)
+{
+	struct mmc_data *data = mrq->data;
+
+	if (!data || !data->host_cookie)
+		return;
+
+	dma_unmap_sg(mmc_dev(mmc), data->sg, data->sg_len,
+		     msmsdcc_get_dma_dir(data));
+	data->host_cookie = 0;
+}
+
 static const struct mmc_host_ops msmsdcc_ops = {
 	.enable		= msmsdcc_enable,
 	.disable	= msmsdcc_disable,
+	.pre_req	= msmsdcc_pre_req,
+	.post_req	= msmsdcc_post_req,
 	.request	= msmsdcc_request,
 	.set_ios	= msmsdcc_set_ios,
 	.get_ro		= msmsdcc_get_ro,
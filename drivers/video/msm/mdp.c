@@ -39,6 +39,7 @@
 #include "mdp4.h"
 #endif
 #include "mipi_dsi.h"
+#include "mipi_simulator.h"
 
 uint32 mdp4_extn_disp;
 
@@ -641,6 +642,7 @@ void mdp_pipe_kickoff(uint32 term, struct msm_fb_data_type *mfd)
 		}
 		/* DMA update timestamp */
 		mdp_dma2_last_update_time = ktime_get_real();
+		mipi_simulator_dma_start();
 		/* let's turn on DMA2 block */
 #if 0
 		mdp_pipe_ctrl(MDP_DMA2_BLOCK, MDP_BLOCK_POWER_ON, FALSE);
@@ -938,6 +940,7 @@ irqreturn_t mdp_isr(int irq, void *ptr)
 			/* let's disable LCDC interrupt */
 			mdp_intr_mask &= ~LCDC_FRAME_START;
 			outp32(MDP_INTR_ENABLE, mdp_intr_mask);
+			mipi_simulator_vsync();
 
 			dma = &dma2_data;
 			if (dma->waiting) {
@@ -970,6 +973,7 @@ irqreturn_t mdp_isr(int irq, void *ptr)
 			struct timeval now;
 			ktime_t now_k;
 
+			mipi_simulator_dma_done();
 			now_k = ktime_get_real();
 			mdp_dma2_last_update_time.tv.sec =
 			    now_k.tv.sec - mdp_dma2_last_update_time.tv.sec;
@@ -663,6 +663,48 @@ void mdp_set_dma_pan_info(struct fb_info *info, struct mdp_dirty_region *dirty,
 void mdp_dma_pan_update(struct fb_info *info);
 void mdp_refresh_screen(unsigned long data);
 int mdp_ppp_blit(struct fb_info *info, struct mdp_blit_req *req);
+
+/* images of a blit request resolved ahead of time (async blit queue) */
+struct mdp_ppp_imgs {
+	unsigned long src_start;
+	unsigned long src_vaddr;
+	unsigned long src_len;
+	unsigned long dst_start;
+	unsigned long dst_vaddr;
+	unsigned long dst_len;
+	struct file *p_src_file;
+	struct file *p_dst_file;
+	boolean flushed;
+};
+
+int mdp_ppp_get_imgs(struct fb_info *info, struct mdp_blit_req *req,
+		     struct mdp_ppp_imgs *imgs);
+void mdp_ppp_put_imgs(struct mdp_ppp_imgs *imgs);
+#ifdef CONFIG_FB_MSM_MDP40
+/* MDP4 has no async blit queue, so @imgs is always NULL */
+static inline int mdp_ppp_blit_imgs(struct fb_info *info,
+				    struct mdp_blit_req *req,
+				    struct mdp_ppp_imgs *imgs)
+{
+	return mdp_ppp_blit(info, req);
+}
+#else
+int mdp_ppp_blit_imgs(struct fb_info *info, struct mdp_blit_req *req,
+		      struct mdp_ppp_imgs *imgs);
+#endif
+int mdp_ppp_verify_req(struct mdp_blit_req *req);
+
+/* software blitter (mdp_ppp_sw.c) */
+#define MDP_PPP_SW_OFF		0	/* PPP only */
+#define MDP_PPP_SW_FALLBACK	1	/* software when the PPP is busy */
+#define MDP_PPP_SW_FORCE	2	/* software when supported, testing */
+
+extern int mdp_ppp_sw_mode;
+int mdp_ppp_sw_supported(struct mdp_blit_req *req);
+int mdp_ppp_sw_blit_req(struct fb_info *info, struct mdp_blit_req *req);
+void mdp_ppp_sw_blit(struct mdp_blit_req *req, uint8 *src_base,
+		     uint8 *dst_base);
+int mdp_ppp_sw_bench(char *buf, int len);
 void mdp_lcd_update_workqueue_handler(struct work_struct *work);
 void mdp_vsync_resync_workqueue_handler(struct work_struct *work);
 void mdp_dma2_update(struct msm_fb_data_type *mfd);
@@ -30,6 +30,7 @@
 #include "mdp.h"
 #include "msm_fb.h"
 #include "mdp4.h"
+#include "mipi_simulator.h"
 
 #define DSI_VIDEO_BASE	0xE0000
 
@@ -445,6 +446,8 @@ void mdp4_overlay_dsi_video_wait4vsync(struct msm_fb_data_type *mfd)
 void mdp4_overlay_dsi_video_vsync_push(struct msm_fb_data_type *mfd,
 			struct mdp4_overlay_pipe *pipe)
 {
+	/* every kickoff flushes its registers and then comes here */
+	mipi_simulator_dma_start();
 
 	if (pipe->flags & MDP_OV_PLAY_NOWAIT)
 		return;
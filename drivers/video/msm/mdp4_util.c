@@ -30,6 +30,7 @@
 #include "mdp.h"
 #include "msm_fb.h"
 #include "mdp4.h"
+#include "mipi_simulator.h"
 
 struct mdp4_statistic mdp4_stat;
 
@@ -404,6 +405,7 @@ irqreturn_t mdp4_isr(int irq, void *ptr)
 		mdp_intr_mask &= ~INTR_PRIMARY_VSYNC;
 		outp32(MDP_INTR_ENABLE, mdp_intr_mask);
 		dma->waiting = FALSE;
+		mipi_simulator_vsync();
 		if (panel & MDP4_PANEL_LCDC)
 			mdp4_primary_vsync_lcdc();
 #ifdef CONFIG_FB_MSM_MIPI_DSI
@@ -426,6 +428,7 @@ irqreturn_t mdp4_isr(int irq, void *ptr)
 #endif
 	if (isr & INTR_DMA_P_DONE) {
 		mdp4_stat.intr_dma_p++;
+		mipi_simulator_dma_done();
 		dma = &dma2_data;
 		if (panel & MDP4_PANEL_LCDC) {
 			/* disable LCDC interrupt */
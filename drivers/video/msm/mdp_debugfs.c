@@ -23,6 +23,7 @@
 #include <linux/debugfs.h>
 #include <linux/semaphore.h>
 #include <linux/uaccess.h>
+#include <linux/slab.h>
 #include <asm/system.h>
 #include <asm/mach-types.h>
 #include <mach/hardware.h>
@@ -424,6 +425,56 @@ static const struct file_operations mdp_stat_fops = {
 };
 #endif
 
+#ifndef CONFIG_FB_MSM_MDP40
+static int mdp_sw_bench_open(struct inode *inode, struct file *file)
+{
+	/* non-seekable */
+	file->f_mode &= ~(FMODE_LSEEK | FMODE_PREAD | FMODE_PWRITE);
+	return 0;
+}
+
+static int mdp_sw_bench_release(struct inode *inode, struct file *file)
+{
+	return 0;
+}
+
+static ssize_t mdp_sw_bench_read(
+	struct file *file,
+	char __user *buff,
+	size_t count,
+	loff_t *ppos)
+{
+	char *bp;
+	int tot;
+
+	if (*ppos)
+		return 0;	/* the end */
+
+	bp = kmalloc(PAGE_SIZE * 2, GFP_KERNEL);
+	if (!bp)
+		return -ENOMEM;
+
+	tot = mdp_ppp_sw_bench(bp, PAGE_SIZE * 2);
+	if (tot > 0) {
+		if (tot > count)
+			tot = count;
+		if (copy_to_user(buff, bp, tot))
+			tot = -EFAULT;
+		else
+			*ppos += tot;	/* increase offset */
+	}
+	kfree(bp);
+
+	return tot;
+}
+
+static const struct file_operations mdp_sw_bench_fops = {
+	.open = mdp_sw_bench_open,
+	.release = mdp_sw_bench_release,
+	.read = mdp_sw_bench_read,
+};
+#endif
+
 /*
  * MDDI
  *
@@ -1193,6 +1244,15 @@ int mdp_debugfs_init(void)
 	}
 #endif
 
+#ifndef CONFIG_FB_MSM_MDP40
+	if (debugfs_create_file("ppp_sw_bench", 0444, dent, 0,
+				&mdp_sw_bench_fops) == NULL) {
+		printk(KERN_ERR "%s(%d): debugfs_create_file: debug fail\n",
+			__FILE__, __LINE__);
+		return -1;
+	}
+#endif
+
 	dent = debugfs_create_dir("mddi", NULL);
 
 	if (IS_ERR(dent)) {
@@ -61,6 +61,60 @@ static uint32_t bytes_per_pixel[] = {
 extern uint32 mdp_plv[];
 extern struct semaphore mdp_ppp_mutex;
 
+/*
+ * Destination buffers being written.  The software fallback runs beside
+ * the PPP, so every blit claims its destination first and blits to one
+ * buffer stay ordered whichever engine does them.  Claims are taken
+ * before mdp_ppp_mutex and never waited for while holding it.
+ */
+struct mdp_ppp_dst_claim {
+	struct list_head list;
+	unsigned long start;
+	unsigned long len;
+};
+
+static LIST_HEAD(mdp_ppp_dst_claims);
+static DEFINE_SPINLOCK(mdp_ppp_dst_lock);
+static DECLARE_WAIT_QUEUE_HEAD(mdp_ppp_dst_wait);
+
+static bool mdp_ppp_dst_try_claim(struct mdp_ppp_dst_claim *claim)
+{
+	struct mdp_ppp_dst_claim *c;
+	unsigned long flag;
+	bool ok = true;
+
+	spin_lock_irqsave(&mdp_ppp_dst_lock, flag);
+	list_for_each_entry(c, &mdp_ppp_dst_claims, list) {
+		if (claim->start < c->start + c->len &&
+		    c->start < claim->start + claim->len) {
+			ok = false;
+			break;
+		}
+	}
+	if (ok)
+		list_add_tail(&claim->list, &mdp_ppp_dst_claims);
+	spin_unlock_irqrestore(&mdp_ppp_dst_lock, flag);
+	return ok;
+}
+
+static void mdp_ppp_dst_claim(struct mdp_ppp_dst_claim *claim,
+			      unsigned long start, unsigned long len)
+{
+	claim->start = start;
+	claim->len = len;
+	wait_event(mdp_ppp_dst_wait, mdp_ppp_dst_try_claim(claim));
+}
+
+static void mdp_ppp_dst_release(struct mdp_ppp_dst_claim *claim)
+{
+	unsigned long flag;
+
+	spin_lock_irqsave(&mdp_ppp_dst_lock, flag);
+	list_del(&claim->list);
+	spin_unlock_irqrestore(&mdp_ppp_dst_lock, flag);
+	wake_up_all(&mdp_ppp_dst_wait);
+}
+
 int mdp_get_bytes_per_pixel(uint32_t format,
 				 struct msm_fb_data_type *mfd)
 {
@@ -574,9 +628,23 @@ static void flush_imgs(struct mdp_blit_req *req, int src_bpp, int dst_bpp,
 	}
 
 }
+
+/* write back what the software blitter left in the cache */
+static void flush_dst_img(struct mdp_blit_req *req, struct file *p_dst_file)
+{
+	uint32_t dst0_len, dst1_len;
+
+	get_len(&req->dst, &req->dst_rect, bytes_per_pixel[req->dst.format],
+		&dst0_len, &dst1_len);
+	flush_pmem_file(p_dst_file, req->dst.offset +
+			req->dst_rect.y * req->dst.width *
+			bytes_per_pixel[req->dst.format], dst0_len);
+}
 #else
 static void flush_imgs(struct mdp_blit_req *req, int src_bpp, int dst_bpp,
 			struct file *p_src_file, struct file *p_dst_file) { }
+static void flush_dst_img(struct mdp_blit_req *req,
+			  struct file *p_dst_file) { }
 #endif
 
 static void mdp_start_ppp(struct msm_fb_data_type *mfd, MDPIBUF *iBuf,
@@ -1158,7 +1226,7 @@ struct mdp_blit_req *req, struct file *p_src_file, struct file *p_dst_file)
 	mdp_pipe_kickoff(MDP_PPP_TERM, mfd);
 }
 
-static int mdp_ppp_verify_req(struct mdp_blit_req *req)
+int mdp_ppp_verify_req(struct mdp_blit_req *req)
 {
 	u32 src_width, src_height, dst_width, dst_height;
 
@@ -1262,17 +1330,15 @@ int get_gem_img(struct mdp_img *img, unsigned long *start, unsigned long *len)
 	return kgsl_gem_obj_addr(img->memory_id, (int) img->priv, start, len);
 }
 
-int get_img(struct mdp_img *img, struct fb_info *info, unsigned long *start,
-	    unsigned long *len, struct file **pp_file)
+static int get_img_vaddr(struct mdp_img *img, struct fb_info *info,
+			 unsigned long *start, unsigned long *vstart,
+			 unsigned long *len, struct file **pp_file)
 {
 	int put_needed, ret = 0;
 	struct file *file;
-#ifdef CONFIG_ANDROID_PMEM
-	unsigned long vstart;
-#endif
 
 #ifdef CONFIG_ANDROID_PMEM
-	if (!get_pmem_file(img->memory_id, start, &vstart, len, pp_file))
+	if (!get_pmem_file(img->memory_id, start, vstart, len, pp_file))
 		return 0;
 #endif
 	file = fget_light(img->memory_id, &put_needed);
@@ -1281,6 +1347,7 @@ int get_img(struct mdp_img *img, struct fb_info *info, unsigned long *start,
 
 	if (MAJOR(file->f_dentry->d_inode->i_rdev) == FB_MAJOR) {
 		*start = info->fix.smem_start;
+		*vstart = (unsigned long)info->screen_base;
 		*len = info->fix.smem_len;
 		*pp_file = file;
 	} else {
@@ -1290,6 +1357,14 @@ int get_img(struct mdp_img *img, struct fb_info *info, unsigned long *start,
 	return ret;
 }
 
+int get_img(struct mdp_img *img, struct fb_info *info, unsigned long *start,
+	    unsigned long *len, struct file **pp_file)
+{
+	unsigned long vstart;
+
+	return get_img_vaddr(img, info, start, &vstart, len, pp_file);
+}
+
 
 void put_img(struct file *p_src_file)
 {
@@ -1300,38 +1375,162 @@ void put_img(struct file *p_src_file)
 }
 
 
-int mdp_ppp_blit(struct fb_info *info, struct mdp_blit_req *req)
+/*
+ * Resolve, validate and cache-flush both images of a blit request ahead
+ * of time so that the request can later be handed to the PPP from a
+ * context that does not own the caller's file descriptors (the async
+ * blit worker).  On success the references taken here are owned by
+ * @imgs and must be dropped with mdp_ppp_put_imgs().
+ */
+int mdp_ppp_get_imgs(struct fb_info *info, struct mdp_blit_req *req,
+		     struct mdp_ppp_imgs *imgs)
 {
-	unsigned long src_start, dst_start;
-	unsigned long src_len = 0;
-	unsigned long dst_len = 0;
-	MDPIBUF iBuf;
-	u32 dst_width, dst_height;
-	struct file *p_src_file = 0 , *p_dst_file = 0;
 	struct msm_fb_data_type *mfd = (struct msm_fb_data_type *)info->par;
 
+	memset(imgs, 0, sizeof(*imgs));
+
 	if (req->dst.format == MDP_FB_FORMAT)
 		req->dst.format =  mfd->fb_imgType;
 	if (req->src.format == MDP_FB_FORMAT)
 		req->src.format = mfd->fb_imgType;
 	if (req->flags & MDP_BLIT_SRC_GEM)
-		get_gem_img(&req->src, &src_start, &src_len);
+		get_gem_img(&req->src, &imgs->src_start, &imgs->src_len);
 	else
-		get_img(&req->src, info, &src_start, &src_len, &p_src_file);
-	if (src_len == 0) {
+		get_img_vaddr(&req->src, info, &imgs->src_start,
+			      &imgs->src_vaddr, &imgs->src_len,
+			      &imgs->p_src_file);
+	if (imgs->src_len == 0) {
 		printk(KERN_ERR "mdp_ppp: could not retrieve image from "
 		       "memory\n");
-		return -1;
+		return -EINVAL;
 	}
 	if (req->flags & MDP_BLIT_DST_GEM)
-		get_gem_img(&req->dst, &dst_start, &dst_len);
+		get_gem_img(&req->dst, &imgs->dst_start, &imgs->dst_len);
 	else
-		get_img(&req->dst, info, &dst_start, &dst_len, &p_dst_file);
-	if (dst_len == 0) {
-		put_img(p_src_file);
+		get_img_vaddr(&req->dst, info, &imgs->dst_start,
+			      &imgs->dst_vaddr, &imgs->dst_len,
+			      &imgs->p_dst_file);
+	if (imgs->dst_len == 0) {
+		mdp_ppp_put_imgs(imgs);
 		printk(KERN_ERR "mdp_ppp: could not retrieve image from "
 		       "memory\n");
-		return -1;
+		return -EINVAL;
+	}
+	if (mdp_ppp_verify_req(req)) {
+		printk(KERN_ERR "mdp_ppp: invalid image!\n");
+		mdp_ppp_put_imgs(imgs);
+		return -EINVAL;
+	}
+
+	flush_imgs(req, bytes_per_pixel[req->src.format],
+		   bytes_per_pixel[req->dst.format],
+		   imgs->p_src_file, imgs->p_dst_file);
+	imgs->flushed = TRUE;
+
+	return 0;
+}
+
+void mdp_ppp_put_imgs(struct mdp_ppp_imgs *imgs)
+{
+	put_img(imgs->p_src_file);
+	put_img(imgs->p_dst_file);
+	imgs->p_src_file = NULL;
+	imgs->p_dst_file = NULL;
+}
+
+int mdp_ppp_blit(struct fb_info *info, struct mdp_blit_req *req)
+{
+	return mdp_ppp_blit_imgs(info, req, NULL);
+}
+
+/*
+ * Blit @req in software for a caller that found the PPP busy and does not
+ * hold msm_fb_ioctl_ppp_sem.  Returns -EAGAIN, with nothing written, if
+ * the software blitter cannot handle the request; the caller then waits
+ * for the PPP.
+ */
+int mdp_ppp_sw_blit_req(struct fb_info *info, struct mdp_blit_req *req)
+{
+	struct mdp_ppp_dst_claim dst_claim;
+	struct mdp_ppp_imgs imgs;
+	int ret;
+
+	if (req->src_rect.h == 0 || req->src_rect.w == 0 ||
+	    req->dst_rect.h == 0 || req->dst_rect.w == 0)
+		return -EINVAL;
+
+	/* resolves, verifies and flushes the source */
+	ret = mdp_ppp_get_imgs(info, req, &imgs);
+	if (ret)
+		return ret;
+
+	if (!imgs.src_vaddr || !imgs.dst_vaddr ||
+	    !mdp_ppp_sw_supported(req)) {
+		mdp_ppp_put_imgs(&imgs);
+		return -EAGAIN;
+	}
+
+	mdp_ppp_dst_claim(&dst_claim, imgs.dst_start, imgs.dst_len);
+	mdp_ppp_sw_blit(req, (uint8 *)imgs.src_vaddr, (uint8 *)imgs.dst_vaddr);
+	flush_dst_img(req, imgs.p_dst_file);
+	mdp_ppp_dst_release(&dst_claim);
+
+	mdp_ppp_put_imgs(&imgs);
+	return 0;
+}
+
+/*
+ * Program one blit.  When @imgs is NULL the images are looked up (and
+ * released) here from the calling process' descriptors; otherwise the
+ * references already held in @imgs are used and stay owned by the caller.
+ */
+int mdp_ppp_blit_imgs(struct fb_info *info, struct mdp_blit_req *req,
+		      struct mdp_ppp_imgs *imgs)
+{
+	unsigned long src_start, dst_start;
+	unsigned long src_vaddr = 0, dst_vaddr = 0;
+	unsigned long src_len = 0;
+	unsigned long dst_len = 0;
+	struct mdp_ppp_dst_claim dst_claim;
+	MDPIBUF iBuf;
+	u32 dst_width, dst_height;
+	struct file *p_src_file = 0 , *p_dst_file = 0;
+	struct file *p_src_flush, *p_dst_flush;
+	struct msm_fb_data_type *mfd = (struct msm_fb_data_type *)info->par;
+
+	if (req->dst.format == MDP_FB_FORMAT)
+		req->dst.format =  mfd->fb_imgType;
+	if (req->src.format == MDP_FB_FORMAT)
+		req->src.format = mfd->fb_imgType;
+	if (imgs) {
+		src_start = imgs->src_start;
+		src_vaddr = imgs->src_vaddr;
+		src_len = imgs->src_len;
+		dst_start = imgs->dst_start;
+		dst_vaddr = imgs->dst_vaddr;
+		dst_len = imgs->dst_len;
+	} else {
+		if (req->flags & MDP_BLIT_SRC_GEM)
+			get_gem_img(&req->src, &src_start, &src_len);
+		else
+			get_img_vaddr(&req->src, info, &src_start,
+				      &src_vaddr, &src_len, &p_src_file);
+		if (src_len == 0) {
+			printk(KERN_ERR "mdp_ppp: could not retrieve image "
+			       "from memory\n");
+			return -1;
+		}
+		if (req->flags & MDP_BLIT_DST_GEM)
+			get_gem_img(&req->dst, &dst_start, &dst_len);
+		else
+			get_img_vaddr(&req->dst, info, &dst_start,
+				      &dst_vaddr, &dst_len, &p_dst_file);
+		if (dst_len == 0) {
+			put_img(p_src_file);
+			printk(KERN_ERR "mdp_ppp: could not retrieve image "
+			       "from memory\n");
+			return -1;
+		}
 	}
 	if (mdp_ppp_verify_req(req)) {
 		printk(KERN_ERR "mdp_ppp: invalid image!\n");
@@ -1340,6 +1539,18 @@ int mdp_ppp_blit(struct fb_info *info, struct mdp_blit_req *req)
 		return -1;
 	}
 
+	/* pre-flushed images must not be flushed again per slice */
+	if (imgs && imgs->flushed) {
+		p_src_flush = NULL;
+		p_dst_flush = NULL;
+	} else if (imgs) {
+		p_src_flush = imgs->p_src_file;
+		p_dst_flush = imgs->p_dst_file;
+	} else {
+		p_src_flush = p_src_file;
+		p_dst_flush = p_dst_file;
+	}
+
 	iBuf.ibuf_width = req->dst.width;
 	iBuf.ibuf_height = req->dst.height;
 	iBuf.bpp = bytes_per_pixel[req->dst.format];
@@ -1464,12 +1675,31 @@ int mdp_ppp_blit(struct fb_info *info, struct mdp_blit_req *req)
 #endif
 	}
 
+	mdp_ppp_dst_claim(&dst_claim, dst_start, dst_len);
+
+	/*
+	 * Forced software blits, to compare the software blitter against
+	 * the PPP.  Scaled output differs, the software blitter samples
+	 * the nearest source pixel.
+	 */
+	if (mdp_ppp_sw_mode == MDP_PPP_SW_FORCE && src_vaddr && dst_vaddr &&
+	    mdp_ppp_sw_supported(req)) {
+		flush_imgs(req, bytes_per_pixel[req->src.format], 0,
+			   imgs ? imgs->p_src_file : p_src_file, NULL);
+		mdp_ppp_sw_blit(req, (uint8 *)src_vaddr, (uint8 *)dst_vaddr);
+		flush_dst_img(req, imgs ? imgs->p_dst_file : p_dst_file);
+		mdp_ppp_dst_release(&dst_claim);
+		put_img(p_src_file);
+		put_img(p_dst_file);
+		return 0;
+	}
+
 	down(&mdp_ppp_mutex);
 	/* MDP cmd block enable */
 	mdp_pipe_ctrl(MDP_CMD_BLOCK, MDP_BLOCK_POWER_ON, FALSE);
 
 #ifndef CONFIG_FB_MSM_MDP22
-	mdp_start_ppp(mfd, &iBuf, req, p_src_file, p_dst_file);
+	mdp_start_ppp(mfd, &iBuf, req, p_src_flush, p_dst_flush);
 #else
 	/* bg tile fetching HW workaround */
 	if (((iBuf.mdpImg.mdpOp & (MDPOP_TRANSP | MDPOP_ALPHAB)) ||
@@ -1501,7 +1731,8 @@ int mdp_ppp_blit(struct fb_info *info, struct mdp_blit_req *req)
 				    (MDP_SCALE_Q_FACTOR * iBuf.roi.dst_height) /
 				    MDP_MIN_X_SCALE_FACTOR;
 
-			mdp_start_ppp(mfd, &iBuf, req, p_src_file, p_dst_file);
+			mdp_start_ppp(mfd, &iBuf, req, p_src_flush,
+				      p_dst_flush);
 
 			/* next tile location */
 			iBuf.roi.lcd_y += 16;
@@ -1553,16 +1784,18 @@ int mdp_ppp_blit(struct fb_info *info, struct mdp_blit_req *req)
 				iBuf.roi.width = tmp_v;
 			}
 
-			mdp_start_ppp(mfd, &iBuf, req, p_src_file, p_dst_file);
+			mdp_start_ppp(mfd, &iBuf, req, p_src_flush,
+				      p_dst_flush);
 		}
 	} else {
-		mdp_start_ppp(mfd, &iBuf, req, p_src_file, p_dst_file);
+		mdp_start_ppp(mfd, &iBuf, req, p_src_flush, p_dst_flush);
 	}
 #endif
 
 	/* MDP cmd block disable */
 	mdp_pipe_ctrl(MDP_CMD_BLOCK, MDP_BLOCK_POWER_OFF, FALSE);
 	up(&mdp_ppp_mutex);
+	mdp_ppp_dst_release(&dst_claim);
 
 	put_img(p_src_file);
 	put_img(p_dst_file);
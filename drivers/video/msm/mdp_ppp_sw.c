@@ -0,0 +1,459 @@
+/* drivers/video/msm/mdp_ppp_sw.c
+ *
+ * Software implementation of the PPP blit semantics.
+ *
+ * Copyright (c) 2012, Code Aurora Forum. All rights reserved.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/fb.h>
+#include <linux/msm_mdp.h>
+
+#include "mdp.h"
+#include "msm_fb.h"
+
+/*
+ * The software blitter walks the destination rectangle and samples the
+ * source with nearest neighbour scaling, so scaled output only
+ * approximates the PPP polyphase scaler and is not bit exact.  YUV is
+ * supported as a source format, using the same colour conversion matrix
+ * programmed into the PPP (mdp_ccs_yuv2rgb).
+ */
+
+int mdp_ppp_sw_mode = MDP_PPP_SW_OFF;
+module_param_named(ppp_sw_mode, mdp_ppp_sw_mode, int, 0644);
+
+extern struct mdp_ccs mdp_ccs_yuv2rgb;
+
+struct mdp_sw_src {
+	uint8 *base;		/* first byte of plane 0 */
+	uint8 *cbcr;		/* first byte of plane 1, pseudo planar */
+	uint32 format;
+	uint32 width;		/* line length in pixels */
+	uint32 bpp;
+};
+
+static int mdp_sw_is_rgb(uint32 format)
+{
+	switch (format) {
+	case MDP_RGB_565:
+	case MDP_BGR_565:
+	case MDP_RGB_888:
+	case MDP_XRGB_8888:
+	case MDP_ARGB_8888:
+	case MDP_RGBA_8888:
+	case MDP_BGRA_8888:
+	case MDP_RGBX_8888:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+static int mdp_sw_is_yuv(uint32 format)
+{
+	switch (format) {
+	case MDP_Y_CBCR_H2V1:
+	case MDP_Y_CBCR_H2V2:
+	case MDP_Y_CRCB_H2V1:
+	case MDP_Y_CRCB_H2V2:
+	case MDP_YCRYCB_H2V1:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+static int mdp_sw_has_alpha(uint32 format)
+{
+	return format == MDP_ARGB_8888 || format == MDP_RGBA_8888 ||
+		format == MDP_BGRA_8888;
+}
+
+static uint32 mdp_sw_bpp(uint32 format)
+{
+	switch (format) {
+	case MDP_RGB_565:
+	case MDP_BGR_565:
+	case MDP_YCRYCB_H2V1:
+		return 2;
+	case MDP_RGB_888:
+		return 3;
+	case MDP_XRGB_8888:
+	case MDP_ARGB_8888:
+	case MDP_RGBA_8888:
+	case MDP_BGRA_8888:
+	case MDP_RGBX_8888:
+		return 4;
+	default:
+		return 1;
+	}
+}
+
+/*
+ * Raw pixel value as the PPP packs it (see the pack patterns in
+ * mdp_ppp.c); this is what transp_mask is compared against.
+ */
+static uint32 mdp_sw_read_raw(const uint8 *p, uint32 format)
+{
+	switch (format) {
+	case MDP_RGB_565:
+	case MDP_BGR_565:
+		return p[0] | (p[1] << 8);
+	case MDP_RGB_888:
+		return p[0] | (p[1] << 8) | (p[2] << 16);
+	default:
+		return p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24);
+	}
+}
+
+/* returns 0xAARRGGBB */
+static uint32 mdp_sw_unpack(uint32 raw, uint32 format)
+{
+	uint32 r, g, b;
+
+	switch (format) {
+	case MDP_RGB_565:
+		r = (raw >> 11) & 0x1f;
+		g = (raw >> 5) & 0x3f;
+		b = raw & 0x1f;
+		return 0xff000000 | ((r << 3 | r >> 2) << 16) |
+			((g << 2 | g >> 4) << 8) | (b << 3 | b >> 2);
+	case MDP_BGR_565:
+		b = (raw >> 11) & 0x1f;
+		g = (raw >> 5) & 0x3f;
+		r = raw & 0x1f;
+		return 0xff000000 | ((r << 3 | r >> 2) << 16) |
+			((g << 2 | g >> 4) << 8) | (b << 3 | b >> 2);
+	case MDP_RGB_888:
+		return 0xff000000 | raw;
+	case MDP_XRGB_8888:
+		return 0xff000000 | raw;
+	case MDP_ARGB_8888:
+	case MDP_BGRA_8888:
+		return raw;
+	case MDP_RGBX_8888:
+		raw |= 0xff000000;
+		/* fall through */
+	case MDP_RGBA_8888:
+	default:
+		return (raw & 0xff00ff00) | ((raw >> 16) & 0xff) |
+			((raw & 0xff) << 16);
+	}
+}
+
+static void mdp_sw_pack(uint8 *p, uint32 format, uint32 argb)
+{
+	uint32 raw;
+
+	switch (format) {
+	case MDP_RGB_565:
+		raw = ((argb >> 8) & 0xf800) | ((argb >> 5) & 0x07e0) |
+			((argb >> 3) & 0x001f);
+		p[0] = raw;
+		p[1] = raw >> 8;
+		return;
+	case MDP_BGR_565:
+		raw = ((argb << 8) & 0xf800) | ((argb >> 5) & 0x07e0) |
+			((argb >> 19) & 0x001f);
+		p[0] = raw;
+		p[1] = raw >> 8;
+		return;
+	case MDP_RGB_888:
+		p[0] = argb;
+		p[1] = argb >> 8;
+		p[2] = argb >> 16;
+		return;
+	case MDP_RGBA_8888:
+	case MDP_RGBX_8888:
+		raw = (argb & 0xff00ff00) | ((argb >> 16) & 0xff) |
+			((argb & 0xff) << 16);
+		break;
+	default:
+		raw = argb;
+		break;
+	}
+	p[0] = raw;
+	p[1] = raw >> 8;
+	p[2] = raw >> 16;
+	p[3] = raw >> 24;
+}
+
+static inline uint32 mdp_sw_clamp(int32 v)
+{
+	if (v < 0)
+		return 0;
+	if (v > 255)
+		return 255;
+	return v;
+}
+
+static inline int32 mdp_sw_ccs_bias(uint16 bv)
+{
+#ifdef CONFIG_FB_MSM_MDP31
+	/* 9 bit two's complement, added */
+	return ((int32)(bv << 23)) >> 23;
+#else
+	/* subtracted */
+	return -(int32)bv;
+#endif
+}
+
+static uint32 mdp_sw_yuv2rgb(uint32 y, uint32 cb, uint32 cr)
+{
+	struct mdp_ccs *ccs = &mdp_ccs_yuv2rgb;
+	int32 c0, c1, c2, out[3];
+	int i;
+
+	c0 = y + mdp_sw_ccs_bias(ccs->bv[0]);
+	c1 = cb + mdp_sw_ccs_bias(ccs->bv[1]);
+	c2 = cr + mdp_sw_ccs_bias(ccs->bv[2]);
+
+	/* Q9 coefficients, one row per output component R, G, B */
+	for (i = 0; i < 3; i++)
+		out[i] = ((int16)ccs->ccs[3 * i] * c0 +
+			  (int16)ccs->ccs[3 * i + 1] * c1 +
+			  (int16)ccs->ccs[3 * i + 2] * c2 + 256) >> 9;
+
+	return 0xff000000 | (mdp_sw_clamp(out[0]) << 16) |
+		(mdp_sw_clamp(out[1]) << 8) | mdp_sw_clamp(out[2]);
+}
+
+static uint32 mdp_sw_fetch(struct mdp_sw_src *src, uint32 x, uint32 y,
+			   uint32 *raw)
+{
+	const uint8 *c;
+	uint32 luma;
+
+	if (!mdp_sw_is_yuv(src->format)) {
+		*raw = mdp_sw_read_raw(src->base +
+				       (y * src->width + x) * src->bpp,
+				       src->format);
+		return mdp_sw_unpack(*raw, src->format);
+	}
+
+	*raw = 0;
+	if (src->format == MDP_YCRYCB_H2V1) {
+		c = src->base + (y * src->width + (x & ~1)) * 2;
+		return mdp_sw_yuv2rgb(c[(x & 1) * 2], c[3], c[1]);
+	}
+
+	/* chroma pairs are shared by two horizontal luma samples */
+	luma = src->base[y * src->width + x];
+	if (src->format == MDP_Y_CBCR_H2V2 || src->format == MDP_Y_CRCB_H2V2)
+		y >>= 1;
+	c = src->cbcr + y * src->width + (x & ~1);
+
+	if (src->format == MDP_Y_CBCR_H2V1 || src->format == MDP_Y_CBCR_H2V2)
+		return mdp_sw_yuv2rgb(luma, c[0], c[1]);
+	return mdp_sw_yuv2rgb(luma, c[1], c[0]);
+}
+
+static inline uint32 mdp_sw_mix(uint32 s, uint32 d, uint32 a, int premult)
+{
+	if (premult)
+		return mdp_sw_clamp(s + (d * (255 - a) + 127) / 255);
+	return (s * a + d * (255 - a) + 127) / 255;
+}
+
+static uint32 mdp_sw_blend(uint32 s, uint32 d, uint32 a, int premult)
+{
+	uint32 out_a;
+
+	out_a = a + (((d >> 24) * (255 - a) + 127) / 255);
+	return (out_a << 24) |
+		(mdp_sw_mix((s >> 16) & 0xff, (d >> 16) & 0xff, a, premult)
+		 << 16) |
+		(mdp_sw_mix((s >> 8) & 0xff, (d >> 8) & 0xff, a, premult)
+		 << 8) |
+		mdp_sw_mix(s & 0xff, d & 0xff, a, premult);
+}
+
+int mdp_ppp_sw_supported(struct mdp_blit_req *req)
+{
+	if (!mdp_sw_is_rgb(req->dst.format))
+		return 0;
+	if (!mdp_sw_is_rgb(req->src.format) && !mdp_sw_is_yuv(req->src.format))
+		return 0;
+	if (req->flags & (MDP_DEINTERLACE | MDP_SHARPENING | MDP_BLUR |
+			  MDP_BLIT_SRC_GEM | MDP_BLIT_DST_GEM))
+		return 0;
+	return 1;
+}
+
+/*
+ * Blit @req from @src_base to @dst_base, the kernel addresses of the
+ * start of the source and destination buffers (before img.offset).
+ * The request must have passed mdp_ppp_verify_req() and
+ * mdp_ppp_sw_supported().
+ *
+ * Flips are applied in source orientation, followed by the 90 degree
+ * clockwise rotation, as the PPP does.
+ */
+void mdp_ppp_sw_blit(struct mdp_blit_req *req, uint8 *src_base,
+		     uint8 *dst_base)
+{
+	struct mdp_sw_src src;
+	uint32 dst_bpp = mdp_sw_bpp(req->dst.format);
+	uint32 ow, oh;		/* output size in source orientation */
+	uint32 x_step, y_step;
+	uint32 i, j, u, v, sx, sy, raw, s, d, a;
+	uint32 const_alpha = req->alpha & 0xff;
+	int rot = req->flags & MDP_ROT_90;
+	int premult = req->flags & MDP_BLEND_FG_PREMULT;
+	int pixel_alpha = mdp_sw_has_alpha(req->src.format);
+	int transp = req->transp_mask != MDP_TRANSP_NOP;
+	int blend = pixel_alpha || const_alpha < MDP_ALPHA_NOP;
+	uint8 *dp;
+
+	src.format = req->src.format;
+	src.width = req->src.width;
+	src.bpp = mdp_sw_bpp(src.format);
+	src.base = src_base + req->src.offset;
+	src.cbcr = src.base + req->src.width * req->src.height;
+
+	ow = rot ? req->dst_rect.h : req->dst_rect.w;
+	oh = rot ? req->dst_rect.w : req->dst_rect.h;
+	x_step = (req->src_rect.w << 16) / ow;
+	y_step = (req->src_rect.h << 16) / oh;
+
+	/* plain copy: one memcpy per line */
+	if (src.format == req->dst.format && !rot && !blend && !transp &&
+	    !(req->flags & (MDP_FLIP_LR | MDP_FLIP_UD)) &&
+	    req->src_rect.w == req->dst_rect.w &&
+	    req->src_rect.h == req->dst_rect.h && mdp_sw_is_rgb(src.format)) {
+		for (j = 0; j < req->dst_rect.h; j++)
+			memcpy(dst_base + req->dst.offset +
+			       ((req->dst_rect.y + j) * req->dst.width +
+				req->dst_rect.x) * dst_bpp,
+			       src.base + ((req->src_rect.y + j) * src.width +
+					   req->src_rect.x) * src.bpp,
+			       req->dst_rect.w * dst_bpp);
+		return;
+	}
+
+	for (j = 0; j < req->dst_rect.h; j++) {
+		dp = dst_base + req->dst.offset +
+			((req->dst_rect.y + j) * req->dst.width +
+			 req->dst_rect.x) * dst_bpp;
+		for (i = 0; i < req->dst_rect.w; i++, dp += dst_bpp) {
+			if (rot) {
+				u = j;
+				v = oh - 1 - i;
+			} else {
+				u = i;
+				v = j;
+			}
+			if (req->flags & MDP_FLIP_LR)
+				u = ow - 1 - u;
+			if (req->flags & MDP_FLIP_UD)
+				v = oh - 1 - v;
+
+			sx = req->src_rect.x +
+				min((u * x_step + (x_step >> 1)) >> 16,
+				    req->src_rect.w - 1);
+			sy = req->src_rect.y +
+				min((v * y_step + (y_step >> 1)) >> 16,
+				    req->src_rect.h - 1);
+
+			s = mdp_sw_fetch(&src, sx, sy, &raw);
+			if (transp && mdp_sw_is_rgb(src.format) &&
+			    (raw & 0xffffff) == (req->transp_mask & 0xffffff))
+				continue;
+
+			if (blend) {
+				a = pixel_alpha ? s >> 24 : 0xff;
+				if (const_alpha < MDP_ALPHA_NOP)
+					a = (a * const_alpha + 127) / 255;
+				d = mdp_sw_unpack(mdp_sw_read_raw(dp,
+						req->dst.format),
+						req->dst.format);
+				s = mdp_sw_blend(s, d, a, premult);
+			}
+			mdp_sw_pack(dp, req->dst.format, s);
+		}
+	}
+}
+
+#define MDP_SW_BENCH_W		320
+#define MDP_SW_BENCH_H		240
+#define MDP_SW_BENCH_LOOPS	4
+
+static const uint32 mdp_sw_bench_fmt[] = {
+	MDP_RGB_565, MDP_BGR_565, MDP_RGB_888, MDP_XRGB_8888,
+	MDP_ARGB_8888, MDP_RGBA_8888, MDP_BGRA_8888, MDP_RGBX_8888,
+	MDP_Y_CBCR_H2V2, MDP_Y_CRCB_H2V2, MDP_Y_CBCR_H2V1,
+	MDP_Y_CRCB_H2V1, MDP_YCRYCB_H2V1,
+};
+
+/*
+ * Throughput of an unscaled full frame blit for every supported
+ * source/destination format pair, in kilopixels per second.
+ */
+int mdp_ppp_sw_bench(char *buf, int len)
+{
+	struct mdp_blit_req req;
+	uint8 *src, *dst;
+	ktime_t start;
+	s64 us;
+	int i, j, k, n = 0;
+
+	src = vmalloc(MDP_SW_BENCH_W * MDP_SW_BENCH_H * 4);
+	dst = vmalloc(MDP_SW_BENCH_W * MDP_SW_BENCH_H * 4);
+	if (!src || !dst) {
+		vfree(src);
+		vfree(dst);
+		return -ENOMEM;
+	}
+	memset(src, 0x5a, MDP_SW_BENCH_W * MDP_SW_BENCH_H * 4);
+
+	memset(&req, 0, sizeof(req));
+	req.src.width = req.dst.width = MDP_SW_BENCH_W;
+	req.src.height = req.dst.height = MDP_SW_BENCH_H;
+	req.src_rect.w = req.dst_rect.w = MDP_SW_BENCH_W;
+	req.src_rect.h = req.dst_rect.h = MDP_SW_BENCH_H;
+	req.alpha = MDP_ALPHA_NOP;
+	req.transp_mask = MDP_TRANSP_NOP;
+
+	for (i = 0; i < ARRAY_SIZE(mdp_sw_bench_fmt); i++) {
+		for (j = 0; j < ARRAY_SIZE(mdp_sw_bench_fmt); j++) {
+			req.src.format = mdp_sw_bench_fmt[i];
+			req.dst.format = mdp_sw_bench_fmt[j];
+			if (!mdp_ppp_sw_supported(&req) ||
+			    mdp_ppp_verify_req(&req))
+				continue;
+
+			start = ktime_get();
+			for (k = 0; k < MDP_SW_BENCH_LOOPS; k++)
+				mdp_ppp_sw_blit(&req, src, dst);
+			us = ktime_to_us(ktime_sub(ktime_get(), start));
+			if (us <= 0)
+				us = 1;
+
+			n += scnprintf(buf + n, len - n, "%2u -> %2u: %llu\n",
+				       req.src.format, req.dst.format,
+				       div64_u64((u64)MDP_SW_BENCH_W *
+						 MDP_SW_BENCH_H *
+						 MDP_SW_BENCH_LOOPS * 1000,
+						 us));
+		}
+	}
+
+	vfree(src);
+	vfree(dst);
+	return n;
+}
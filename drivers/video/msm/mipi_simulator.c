@@ -10,6 +10,12 @@
  * GNU General Public License for more details.
  */
 
+#include <linux/debugfs.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/uaccess.h>
 #include "msm_fb.h"
 #include "mipi_dsi.h"
 #include "mipi_simulator.h"
@@ -30,6 +36,229 @@ static struct dsi_cmd_desc display_off_cmds[] = {
 				display_off}
 };
 
+/*
+ * Frame timing.  Bucket n of a histogram counts samples below
+ * (SIM_HIST_BASE_US << n) microseconds, the last bucket everything else.
+ */
+#define SIM_HIST_BUCKETS	10
+#define SIM_HIST_BASE_US	250
+
+struct sim_hist {
+	u32 bucket[SIM_HIST_BUCKETS];
+	u32 count;
+	u32 max_us;
+	u64 total_us;
+};
+
+static struct sim_timing {
+	int enabled;
+	u32 frame_us;
+	ktime_t commit_time;
+	ktime_t dma_time;
+	int commit_pending;
+	int dma_pending;
+	u32 frames;
+	u32 missed_vsync;
+	u32 merged_commits;
+	struct sim_hist latency;	/* commit to scanout */
+	struct sim_hist dma;		/* DMA kickoff to done */
+} sim_timing;
+
+static DEFINE_SPINLOCK(sim_timing_lock);
+
+static void sim_hist_add(struct sim_hist *hist, u32 us)
+{
+	int i = 0;
+
+	while (i < SIM_HIST_BUCKETS - 1 && us >= (SIM_HIST_BASE_US << i))
+		i++;
+	hist->bucket[i]++;
+	hist->count++;
+	hist->total_us += us;
+	if (us > hist->max_us)
+		hist->max_us = us;
+}
+
+void mipi_simulator_commit(void)
+{
+	unsigned long flag;
+
+	spin_lock_irqsave(&sim_timing_lock, flag);
+	if (sim_timing.enabled) {
+		/* a commit not yet on screen is superseded by this one */
+		if (sim_timing.commit_pending)
+			sim_timing.merged_commits++;
+		else
+			sim_timing.commit_time = ktime_get();
+		sim_timing.commit_pending = TRUE;
+	}
+	spin_unlock_irqrestore(&sim_timing_lock, flag);
+}
+
+void mipi_simulator_dma_start(void)
+{
+	unsigned long flag;
+
+	spin_lock_irqsave(&sim_timing_lock, flag);
+	if (sim_timing.enabled) {
+		sim_timing.dma_time = ktime_get();
+		sim_timing.dma_pending = TRUE;
+	}
+	spin_unlock_irqrestore(&sim_timing_lock, flag);
+}
+
+/*
+ * A frame is counted per completed DMA; vsync interrupts are only armed
+ * while someone waits on them and would miss NOWAIT updates.
+ */
+static void sim_timing_dma_done(ktime_t now)
+{
+	if (!sim_timing.dma_pending)
+		return;
+	sim_hist_add(&sim_timing.dma,
+		     ktime_to_us(ktime_sub(now, sim_timing.dma_time)));
+	sim_timing.dma_pending = FALSE;
+	sim_timing.frames++;
+}
+
+void mipi_simulator_dma_done(void)
+{
+	unsigned long flag;
+
+	spin_lock_irqsave(&sim_timing_lock, flag);
+	if (sim_timing.enabled)
+		sim_timing_dma_done(ktime_get());
+	spin_unlock_irqrestore(&sim_timing_lock, flag);
+}
+
+/* the frame start latches the last programmed buffer for scanout */
+void mipi_simulator_vsync(void)
+{
+	unsigned long flag;
+	ktime_t now;
+	u32 us;
+
+	spin_lock_irqsave(&sim_timing_lock, flag);
+	if (sim_timing.enabled) {
+		now = ktime_get();
+		/* video mode DMA has no done interrupt of its own */
+		sim_timing_dma_done(now);
+		if (sim_timing.commit_pending) {
+			us = ktime_to_us(ktime_sub(now,
+						   sim_timing.commit_time));
+			sim_hist_add(&sim_timing.latency, us);
+			sim_timing.missed_vsync += us / sim_timing.frame_us;
+			sim_timing.commit_pending = FALSE;
+		}
+	}
+	spin_unlock_irqrestore(&sim_timing_lock, flag);
+}
+
+static void sim_timing_enable(struct msm_fb_data_type *mfd, int enable)
+{
+	unsigned long flag;
+	u32 frame_rate = mfd->panel_info.mipi.frame_rate;
+
+	if (!frame_rate)
+		frame_rate = 60;
+
+	spin_lock_irqsave(&sim_timing_lock, flag);
+	sim_timing.enabled = enable;
+	sim_timing.frame_us = USEC_PER_SEC / frame_rate;
+	sim_timing.commit_pending = FALSE;
+	sim_timing.dma_pending = FALSE;
+	spin_unlock_irqrestore(&sim_timing_lock, flag);
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int sim_hist_print(char *buf, int len, const char *name,
+			  struct sim_hist *hist)
+{
+	int i, n;
+
+	n = scnprintf(buf, len, "%s: count %u avg %llu max %u us\n", name,
+		      hist->count,
+		      hist->count ? div_u64(hist->total_us, hist->count) : 0,
+		      hist->max_us);
+	for (i = 0; i < SIM_HIST_BUCKETS - 1; i++)
+		n += scnprintf(buf + n, len - n, "  < %6u us: %u\n",
+			       SIM_HIST_BASE_US << i, hist->bucket[i]);
+	n += scnprintf(buf + n, len - n, "  >=%6u us: %u\n",
+		       SIM_HIST_BASE_US << (SIM_HIST_BUCKETS - 2),
+		       hist->bucket[SIM_HIST_BUCKETS - 1]);
+	return n;
+}
+
+static ssize_t sim_timing_read(struct file *file, char __user *buff,
+			       size_t count, loff_t *ppos)
+{
+	struct sim_timing snap;
+	unsigned long flag;
+	char *bp;
+	int len = PAGE_SIZE;
+	int n;
+	ssize_t ret;
+
+	bp = kmalloc(len, GFP_KERNEL);
+	if (!bp)
+		return -ENOMEM;
+
+	spin_lock_irqsave(&sim_timing_lock, flag);
+	snap = sim_timing;
+	spin_unlock_irqrestore(&sim_timing_lock, flag);
+
+	n = scnprintf(bp, len, "enabled: %d\nframe period: %u us\n"
+		      "frames: %u\nmissed vsync: %u\nmerged commits: %u\n",
+		      snap.enabled, snap.frame_us, snap.frames,
+		      snap.missed_vsync, snap.merged_commits);
+	n += sim_hist_print(bp + n, len - n, "commit to scanout",
+			    &snap.latency);
+	n += sim_hist_print(bp + n, len - n, "dma", &snap.dma);
+
+	ret = simple_read_from_buffer(buff, count, ppos, bp, n);
+	kfree(bp);
+	return ret;
+}
+
+/* any write clears the statistics */
+static ssize_t sim_timing_write(struct file *file, const char __user *buff,
+				size_t count, loff_t *ppos)
+{
+	unsigned long flag;
+
+	spin_lock_irqsave(&sim_timing_lock, flag);
+	sim_timing.frames = 0;
+	sim_timing.missed_vsync = 0;
+	sim_timing.merged_commits = 0;
+	memset(&sim_timing.latency, 0, sizeof(sim_timing.latency));
+	memset(&sim_timing.dma, 0, sizeof(sim_timing.dma));
+	spin_unlock_irqrestore(&sim_timing_lock, flag);
+
+	return count;
+}
+
+static const struct file_operations sim_timing_fops = {
+	.read = sim_timing_read,
+	.write = sim_timing_write,
+};
+
+static void mipi_simulator_debugfs_init(void)
+{
+	struct dentry *dent = debugfs_create_dir("mipi_simulator", NULL);
+
+	if (IS_ERR_OR_NULL(dent)) {
+		pr_err("%s: debugfs_create_dir fail\n", __func__);
+		return;
+	}
+
+	if (debugfs_create_file("timing", 0644, dent, NULL,
+				&sim_timing_fops) == NULL)
+		pr_err("%s: debugfs_create_file fail\n", __func__);
+}
+#else
+static void mipi_simulator_debugfs_init(void) { }
+#endif
+
 static int mipi_simulator_lcd_on(struct platform_device *pdev)
 {
 	struct msm_fb_data_type *mfd;
@@ -49,6 +278,7 @@ static int mipi_simulator_lcd_on(struct platform_device *pdev)
 	if (mipi->mode == DSI_VIDEO_MODE) {
 		mipi_dsi_cmds_tx(mfd, &simulator_tx_buf, display_on_cmds,
 			ARRAY_SIZE(display_on_cmds));
+		sim_timing_enable(mfd, TRUE);
 	} else {
 		pr_err("%s:%d, CMD MODE NOT SUPPORTED", __func__, __LINE__);
 		return -EINVAL;
@@ -73,6 +303,7 @@ static int mipi_simulator_lcd_off(struct platform_device *pdev)
 	pr_debug("%s:%d, debug info", __func__, __LINE__);
 
 	if (mipi->mode == DSI_VIDEO_MODE) {
+		sim_timing_enable(mfd, FALSE);
 		mipi_dsi_cmds_tx(mfd, &simulator_tx_buf, display_off_cmds,
 			ARRAY_SIZE(display_off_cmds));
 	} else {
@@ -155,6 +386,7 @@ static int __init mipi_simulator_lcd_init(void)
 {
 	mipi_dsi_buf_alloc(&simulator_tx_buf, DSI_BUF_SIZE);
 	mipi_dsi_buf_alloc(&simulator_rx_buf, DSI_BUF_SIZE);
+	mipi_simulator_debugfs_init();
 
 	return platform_driver_register(&this_driver);
 }
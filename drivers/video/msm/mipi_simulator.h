@@ -16,4 +16,21 @@
 int mipi_simulator_device_register(struct msm_panel_info *pinfo,
 					u32 channel, u32 panel);
 
+/*
+ * Frame timing hooks.  msm_fb and the MDP DMA/ISR paths report commits,
+ * DMA starts/completions and vsyncs; while the simulator panel is on
+ * they are turned into latency histograms under debugfs mipi_simulator/.
+ */
+#ifdef CONFIG_FB_MSM_MIPI_DSI_SIMULATOR
+void mipi_simulator_commit(void);
+void mipi_simulator_dma_start(void);
+void mipi_simulator_dma_done(void);
+void mipi_simulator_vsync(void);
+#else
+static inline void mipi_simulator_commit(void) { }
+static inline void mipi_simulator_dma_start(void) { }
+static inline void mipi_simulator_dma_done(void) { }
+static inline void mipi_simulator_vsync(void) { }
+#endif
+
 #endif  /* MIPI_SIMULATOR_H */
@@ -47,6 +47,7 @@
 #include "tvenc.h"
 #include "mdp.h"
 #include "mdp4.h"
+#include "mipi_simulator.h"
 
 #ifdef CONFIG_FB_MSM_LOGO
 #define INIT_IMAGE_FILE "/initlogo.rle"
@@ -1525,6 +1526,7 @@ static int msm_fb_pan_display(struct fb_var_screeninfo *var,
 	add_timer(&mfd->msmfb_no_update_notify_timer);
 	mutex_unlock(&msm_fb_notify_update_sem);
 
+	mipi_simulator_commit();
 	down(&msm_fb_pan_sem);
 	mdp_set_dma_pan_info(info, dirtyPtr,
 			     (var->activate == FB_ACTIVATE_VBL));
@@ -1737,7 +1739,8 @@ int msm_fb_resume_sw_refresher(struct msm_fb_data_type *mfd)
 
 #if defined CONFIG_FB_MSM_MDP31
 static int mdp_blit_split_height(struct fb_info *info,
-				struct mdp_blit_req *req)
+				struct mdp_blit_req *req,
+				struct mdp_ppp_imgs *imgs)
 {
 	int ret;
 	struct mdp_blit_req splitreq;
@@ -1833,7 +1836,7 @@ static int mdp_blit_split_height(struct fb_info *info,
 		splitreq.dst_rect.x = d_x_1;
 		splitreq.dst_rect.w = d_w_1;
 	}
-	ret = mdp_ppp_blit(info, &splitreq);
+	ret = mdp_ppp_blit_imgs(info, &splitreq, imgs);
 	if (ret)
 		return ret;
 
@@ -1858,12 +1861,17 @@ static int mdp_blit_split_height(struct fb_info *info,
 		splitreq.dst_rect.x = d_x_0;
 		splitreq.dst_rect.w = d_w_0;
 	}
-	ret = mdp_ppp_blit(info, &splitreq);
+	ret = mdp_ppp_blit_imgs(info, &splitreq, imgs);
 	return ret;
 }
 #endif
 
-int mdp_blit(struct fb_info *info, struct mdp_blit_req *req)
+/*
+ * Blit one request, applying the MDP3.x split workarounds.  @imgs carries
+ * the pre-resolved images of the async blit queue or is NULL.
+ */
+static int mdp_blit_imgs(struct fb_info *info, struct mdp_blit_req *req,
+			 struct mdp_ppp_imgs *imgs)
 {
 	int ret;
 #if defined CONFIG_FB_MSM_MDP31 || defined CONFIG_FB_MSM_MDP30
@@ -2019,9 +2027,9 @@ int mdp_blit(struct fb_info *info, struct mdp_blit_req *req)
 		if ((splitreq.dst_rect.h % 32 == 3) ||
 			((req->dst_rect.h % 32) == 1 && req->dst_rect.h != 1) ||
 			((req->dst_rect.h % 32) == 2 && req->dst_rect.h != 2))
-			ret = mdp_blit_split_height(info, &splitreq);
+			ret = mdp_blit_split_height(info, &splitreq, imgs);
 		else
-			ret = mdp_ppp_blit(info, &splitreq);
+			ret = mdp_ppp_blit_imgs(info, &splitreq, imgs);
 		if (ret)
 			return ret;
 		/* blit second region */
@@ -2048,17 +2056,17 @@ int mdp_blit(struct fb_info *info, struct mdp_blit_req *req)
 		if (((splitreq.dst_rect.h % 32) == 3) ||
 			((req->dst_rect.h % 32) == 1 && req->dst_rect.h != 1) ||
 			((req->dst_rect.h % 32) == 2 && req->dst_rect.h != 2))
-			ret = mdp_blit_split_height(info, &splitreq);
+			ret = mdp_blit_split_height(info, &splitreq, imgs);
 		else
-			ret = mdp_ppp_blit(info, &splitreq);
+			ret = mdp_ppp_blit_imgs(info, &splitreq, imgs);
 		if (ret)
 			return ret;
 	} else if ((req->dst_rect.h % 32) == 3 ||
 		((req->dst_rect.h % 32) == 1 && req->dst_rect.h != 1) ||
 		((req->dst_rect.h % 32) == 2 && req->dst_rect.h != 2))
-		ret = mdp_blit_split_height(info, req);
+		ret = mdp_blit_split_height(info, req, imgs);
 	else
-		ret = mdp_ppp_blit(info, req);
+		ret = mdp_ppp_blit_imgs(info, req, imgs);
 	return ret;
 #elif defined CONFIG_FB_MSM_MDP30
 	/* MDP width split workaround */
@@ -2164,7 +2172,7 @@ int mdp_blit(struct fb_info *info, struct mdp_blit_req *req)
 		}
 
 		/* No need to split in height */
-		ret = mdp_ppp_blit(info, &splitreq);
+		ret = mdp_ppp_blit_imgs(info, &splitreq, imgs);
 
 		if (ret)
 			return ret;
@@ -2192,20 +2200,25 @@ int mdp_blit(struct fb_info *info, struct mdp_blit_req *req)
 		}
 
 		/* No need to split in height ... just width */
-		ret = mdp_ppp_blit(info, &splitreq);
+		ret = mdp_ppp_blit_imgs(info, &splitreq, imgs);
 
 		if (ret)
 			return ret;
 
 	} else
-		ret = mdp_ppp_blit(info, req);
+		ret = mdp_ppp_blit_imgs(info, req, imgs);
 	return ret;
 #else
-	ret = mdp_ppp_blit(info, req);
+	ret = mdp_ppp_blit_imgs(info, req, imgs);
 	return ret;
 #endif
 }
 
+int mdp_blit(struct fb_info *info, struct mdp_blit_req *req)
+{
+	return mdp_blit_imgs(info, req, NULL);
+}
+
 typedef void (*msm_dma_barrier_function_pointer) (void *, size_t);
 
 static inline void msm_fb_dma_barrier_for_rect(struct fb_info *info,
@@ -2432,7 +2445,43 @@ static void msm_fb_ensure_memory_coherency_after_dma(struct fb_info *info,
  * those areas. Hence it would be enough to perform barrier/cache operations
  * only on the START and END operations.
  */
-static int msmfb_blit(struct fb_info *info, void __user *p)
+DEFINE_SEMAPHORE(msm_fb_ioctl_ppp_sem);
+
+/*
+ * Blit one request.  A caller that found the PPP busy runs without
+ * msm_fb_ioctl_ppp_sem (*locked is 0) and has the request done in
+ * software; if that cannot be done it takes the semaphore and the rest
+ * of the list goes to the PPP.
+ */
+static int msmfb_blit_req(struct fb_info *info, struct mdp_blit_req *req,
+			  int *locked)
+{
+#ifndef CONFIG_FB_MSM_MDP40
+	int ret;
+
+	if (!*locked) {
+		ret = mdp_ppp_sw_blit_req(info, req);
+		if (ret != -EAGAIN)
+			return ret;
+		down(&msm_fb_ioctl_ppp_sem);
+		*locked = 1;
+	}
+#endif
+	return mdp_blit(info, req);
+}
+
+/* Returns 0 if the PPP is busy and the blit may go to software. */
+static int msmfb_blit_lock(void)
+{
+#ifndef CONFIG_FB_MSM_MDP40
+	if (mdp_ppp_sw_mode == MDP_PPP_SW_FALLBACK)
+		return !down_trylock(&msm_fb_ioctl_ppp_sem);
+#endif
+	down(&msm_fb_ioctl_ppp_sem);
+	return 1;
+}
+
+static int msmfb_blit(struct fb_info *info, void __user *p, int *locked)
 {
 	/*
 	 * CAUTION: The names of the struct types intentionally *DON'T* match
@@ -2484,7 +2533,8 @@ static int msmfb_blit(struct fb_info *info, void __user *p)
 		for (i = 0; i < req_list_count; i++) {
 			if (!(req_list[i].flags & MDP_NO_BLIT)) {
 				/* Do the actual blit. */
-				int ret = mdp_blit(info, &(req_list[i]));
+				int ret = msmfb_blit_req(info, &(req_list[i]),
+							 locked);
 
 				/*
 				 * Note that early returns don't guarantee
@@ -2511,6 +2561,210 @@ static int msmfb_blit(struct fb_info *info, void __user *p)
 	return 0;
 }
 
+#ifndef CONFIG_FB_MSM_MDP40
+/*
+ * Asynchronous blit queue.  MSMFB_ASYNC_BLIT resolves, validates and
+ * flushes every request of the list in the caller's context, then hands
+ * the whole list to a single threaded workqueue which feeds the PPP back
+ * to back.  Lists are retired in submission order, so a handle is a plain
+ * sequence number and waiting is a comparison against the last retired one.
+ * The first failure is kept until a wait covering its handle reports it.
+ */
+#define MSMFB_ASYNC_BLIT_MAX_PENDING 4
+
+struct msmfb_async_blit_job {
+	struct work_struct work;
+	struct fb_info *info;
+	u32 handle;
+	int count;
+	struct mdp_blit_req *req_list;
+	struct mdp_ppp_imgs *imgs;
+};
+
+static struct workqueue_struct *msm_fb_blit_wq;
+static DECLARE_WAIT_QUEUE_HEAD(msm_fb_blit_waitq);
+static DEFINE_SPINLOCK(msm_fb_blit_lock);
+static u32 msm_fb_blit_submitted;
+static u32 msm_fb_blit_retired;
+static u32 msm_fb_blit_err_handle;
+static int msm_fb_blit_err;
+
+static void msmfb_async_blit_put_imgs(struct msmfb_async_blit_job *job)
+{
+	int i;
+
+	for (i = 0; i < job->count; i++)
+		mdp_ppp_put_imgs(&job->imgs[i]);
+	job->count = 0;
+}
+
+static void msmfb_async_blit_work(struct work_struct *work)
+{
+	struct msmfb_async_blit_job *job =
+		container_of(work, struct msmfb_async_blit_job, work);
+	unsigned long flag;
+	int i, ret = 0;
+
+	down(&msm_fb_ioctl_ppp_sem);
+	for (i = 0; i < job->count; i++) {
+		if (job->req_list[i].flags & MDP_NO_BLIT)
+			continue;
+		ret = mdp_blit_imgs(job->info, &job->req_list[i],
+				    &job->imgs[i]);
+		if (ret) {
+			printk(KERN_ERR "%s: blit %d of handle %u failed\n",
+			       __func__, i, job->handle);
+			break;
+		}
+	}
+	msm_fb_ensure_memory_coherency_after_dma(job->info, job->req_list,
+						 job->count);
+	up(&msm_fb_ioctl_ppp_sem);
+
+	spin_lock_irqsave(&msm_fb_blit_lock, flag);
+	msm_fb_blit_retired = job->handle;
+	if (ret && !msm_fb_blit_err) {
+		msm_fb_blit_err_handle = job->handle;
+		msm_fb_blit_err = ret;
+	}
+	spin_unlock_irqrestore(&msm_fb_blit_lock, flag);
+	wake_up_all(&msm_fb_blit_waitq);
+
+	msmfb_async_blit_put_imgs(job);
+	kfree(job);
+}
+
+/* take the next handle if fewer than MAX_PENDING lists are in flight */
+static bool msmfb_async_blit_reserve(u32 *handle)
+{
+	unsigned long flag;
+	bool ok;
+
+	spin_lock_irqsave(&msm_fb_blit_lock, flag);
+	ok = (msm_fb_blit_submitted - msm_fb_blit_retired) <
+		MSMFB_ASYNC_BLIT_MAX_PENDING;
+	if (ok)
+		*handle = ++msm_fb_blit_submitted;
+	spin_unlock_irqrestore(&msm_fb_blit_lock, flag);
+	return ok;
+}
+
+static bool msmfb_async_blit_retired(u32 handle)
+{
+	unsigned long flag;
+	bool done;
+
+	spin_lock_irqsave(&msm_fb_blit_lock, flag);
+	done = (s32)(msm_fb_blit_retired - handle) >= 0;
+	spin_unlock_irqrestore(&msm_fb_blit_lock, flag);
+	return done;
+}
+
+static int msmfb_async_blit(struct fb_info *info, void __user *p)
+{
+	struct mdp_async_blit_req_list hdr;
+	struct msmfb_async_blit_job *job;
+	int i, ret;
+
+	if (!msm_fb_blit_wq)
+		return -ENODEV;
+
+	if (copy_from_user(&hdr, p, sizeof(hdr)))
+		return -EFAULT;
+	if (hdr.count == 0 || hdr.count >= MAX_BLIT_REQ)
+		return -EINVAL;
+
+	job = kzalloc(sizeof(*job) + hdr.count *
+		      (sizeof(struct mdp_blit_req) +
+		       sizeof(struct mdp_ppp_imgs)), GFP_KERNEL);
+	if (!job)
+		return -ENOMEM;
+	job->info = info;
+	job->req_list = (struct mdp_blit_req *)(job + 1);
+	job->imgs = (struct mdp_ppp_imgs *)(job->req_list + hdr.count);
+
+	if (copy_from_user(job->req_list, p + sizeof(hdr),
+			   sizeof(struct mdp_blit_req) * hdr.count)) {
+		kfree(job);
+		return -EFAULT;
+	}
+
+	/*
+	 * The worker cannot look up the caller's descriptors, so every
+	 * image is resolved and pinned here.  Anything that would fail
+	 * verification fails the ioctl before a single blit is queued.
+	 */
+	for (i = 0; i < hdr.count; i++) {
+		if (job->req_list[i].flags & MDP_NO_BLIT)
+			continue;
+		ret = mdp_ppp_get_imgs(info, &job->req_list[i],
+				       &job->imgs[i]);
+		if (ret) {
+			job->count = i;
+			goto out_free;
+		}
+	}
+	job->count = hdr.count;
+
+	msm_fb_ensure_memory_coherency_before_dma(info, job->req_list,
+						  job->count);
+
+	ret = wait_event_interruptible(msm_fb_blit_waitq,
+				       msmfb_async_blit_reserve(&job->handle));
+	if (ret)
+		goto out_free;
+
+	/*
+	 * The handle is taken and has to retire in order, so if it cannot
+	 * be handed back the list is still queued, but with nothing to blit.
+	 */
+	hdr.handle = job->handle;
+	if (copy_to_user(p, &hdr, sizeof(hdr))) {
+		msmfb_async_blit_put_imgs(job);
+		ret = -EFAULT;
+	}
+
+	INIT_WORK(&job->work, msmfb_async_blit_work);
+	queue_work(msm_fb_blit_wq, &job->work);
+	return ret;
+
+out_free:
+	msmfb_async_blit_put_imgs(job);
+	kfree(job);
+	return ret;
+}
+
+static int msmfb_async_blit_wait(struct fb_info *info, void __user *p)
+{
+	unsigned long flag;
+	u32 handle;
+	int ret;
+
+	if (copy_from_user(&handle, p, sizeof(handle)))
+		return -EFAULT;
+
+	spin_lock_irqsave(&msm_fb_blit_lock, flag);
+	ret = (s32)(handle - msm_fb_blit_submitted) > 0 ? -EINVAL : 0;
+	spin_unlock_irqrestore(&msm_fb_blit_lock, flag);
+	if (ret)
+		return ret;
+
+	ret = wait_event_interruptible(msm_fb_blit_waitq,
+				       msmfb_async_blit_retired(handle));
+	if (ret)
+		return ret;
+
+	spin_lock_irqsave(&msm_fb_blit_lock, flag);
+	if (msm_fb_blit_err &&
+	    (s32)(handle - msm_fb_blit_err_handle) >= 0) {
+		ret = msm_fb_blit_err;
+		msm_fb_blit_err = 0;
+	}
+	spin_unlock_irqrestore(&msm_fb_blit_lock, flag);
+	return ret;
+}
+#endif
+
 #ifdef CONFIG_FB_MSM_OVERLAY
 static int msmfb_overlay_get(struct fb_info *info, void __user *p)
 {
@@ -2696,7 +2950,6 @@ static int msmfb_overlay_3d_sbys(struct fb_info *info, unsigned long *argp)
 
 #endif
 
-DEFINE_SEMAPHORE(msm_fb_ioctl_ppp_sem);
 DEFINE_MUTEX(msm_fb_ioctl_lut_sem);
 DEFINE_MUTEX(msm_fb_ioctl_hist_sem);
 
@@ -2774,6 +3027,7 @@ static int msm_fb_ioctl(struct fb_info *info, unsigned int cmd,
 	struct mdp_ccs ccs_matrix;
 #endif
 	struct mdp_page_protection fb_page_protection;
+	int locked;
 	int ret = 0;
 
 	switch (cmd) {
@@ -2820,12 +3074,29 @@ static int msm_fb_ioctl(struct fb_info *info, unsigned int cmd,
 		break;
 #endif
 	case MSMFB_BLIT:
-		down(&msm_fb_ioctl_ppp_sem);
-		ret = msmfb_blit(info, argp);
-		up(&msm_fb_ioctl_ppp_sem);
+		locked = msmfb_blit_lock();
+		ret = msmfb_blit(info, argp, &locked);
+		if (locked)
+			up(&msm_fb_ioctl_ppp_sem);
 
 		break;
 
+	case MSMFB_ASYNC_BLIT:
+#ifndef CONFIG_FB_MSM_MDP40
+		ret = msmfb_async_blit(info, argp);
+#else
+		ret = -EINVAL;
+#endif
+		break;
+
+	case MSMFB_ASYNC_BLIT_WAIT:
+#ifndef CONFIG_FB_MSM_MDP40
+		ret = msmfb_async_blit_wait(info, argp);
+#else
+		ret = -EINVAL;
+#endif
+		break;
+
 	/* Ioctl for setting ccs matrix from user space */
 	case MSMFB_SET_CCS_MATRIX:
 #ifndef CONFIG_FB_MSM_MDP40
@@ -3136,6 +3407,12 @@ int __init msm_fb_init(void)
 	if (msm_fb_register_driver())
 		return rc;
 
+#ifndef CONFIG_FB_MSM_MDP40
+	msm_fb_blit_wq = create_singlethread_workqueue("msm_fb_blit");
+	if (!msm_fb_blit_wq)
+		printk(KERN_ERR "%s: async blit disabled\n", __func__);
+#endif
+
 #ifdef MSM_FB_ENABLE_DBGFS
 	{
 		struct dentry *root;
@@ -909,6 +909,15 @@ struct ext4_inode_info {
 #define EXT4_MOUNT_DISCARD		0x40000000 /* Issue DISCARD requests */
 #define EXT4_MOUNT_INIT_INODE_TABLE	0x80000000 /* Initialize uninitialized itables */
 
+/* s_erase_unit until mount asks the device for its preferred erase size */
+#define EXT4_ERASE_UNIT_PROBE		UINT_MAX
+
+/* fsync latency histogram, /proc/fs/ext4/<dev>/fsync_hist */
+#define EXT4_FSYNC_FLUSH		0	/* metadata already committed */
+#define EXT4_FSYNC_COMMIT		1	/* waited for a commit */
+#define EXT4_FSYNC_NR_PATHS		2
+#define EXT4_FSYNC_HIST_SLOTS		24
+
 #define clear_opt(sb, opt)		EXT4_SB(sb)->s_mount_opt &= \
 						~EXT4_MOUNT_##opt
 #define set_opt(sb, opt)		EXT4_SB(sb)->s_mount_opt |= \
@@ -1154,6 +1163,7 @@ struct ext4_sb_info {
 
 	/* tunables */
 	unsigned long s_stripe;
+	unsigned int s_erase_unit;
 	unsigned int s_mb_stream_request;
 	unsigned int s_mb_max_to_scan;
 	unsigned int s_mb_min_to_scan;
@@ -1181,13 +1191,16 @@ struct ext4_sb_info {
 	atomic_t s_mb_discarded;
 	atomic_t s_lock_busy;
 
-	/* locality groups */
+	/* locality groups, EXT4_LG_CLASSES per cpu */
 	struct ext4_locality_group __percpu *s_locality_groups;
 
 	/* for write statistics */
 	unsigned long s_sectors_written_start;
 	u64 s_kbytes_written;
 
+	/* fsync latency, log2 buckets of microseconds per path */
+	atomic_t s_fsync_hist[EXT4_FSYNC_NR_PATHS][EXT4_FSYNC_HIST_SLOTS];
+
 	unsigned int s_log_groups_per_flex;
 	struct flex_groups *s_flex_groups;
 
@@ -1672,6 +1685,7 @@ extern void ext4_htree_free_dir_info(struct dir_private_info *p);
 
 /* fsync.c */
 extern int ext4_sync_file(struct file *, int);
+extern const struct file_operations ext4_fsync_hist_fops;
 extern int ext4_flush_completed_IO(struct inode *);
 
 /* hash.c */
@@ -28,6 +28,9 @@
 #include <linux/writeback.h>
 #include <linux/jbd2.h>
 #include <linux/blkdev.h>
+#include <linux/ktime.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
 
 #include "ext4.h"
 #include "ext4_jbd2.h"
@@ -140,6 +143,56 @@ static void ext4_sync_parent(struct inode *inode)
 	}
 }
 
+static void ext4_fsync_account(struct super_block *sb, int path,
+			       ktime_t start)
+{
+	s64 us = ktime_us_delta(ktime_get(), start);
+	int slot = us > 0 ? fls64((u64)us) : 0;
+
+	slot = min(slot, EXT4_FSYNC_HIST_SLOTS - 1);
+	atomic_inc(&EXT4_SB(sb)->s_fsync_hist[path][slot]);
+}
+
+static int ext4_fsync_hist_show(struct seq_file *seq, void *v)
+{
+	struct ext4_sb_info *sbi = seq->private;
+	atomic_t *flush = sbi->s_fsync_hist[EXT4_FSYNC_FLUSH];
+	atomic_t *commit = sbi->s_fsync_hist[EXT4_FSYNC_COMMIT];
+	int i, last = EXT4_FSYNC_HIST_SLOTS - 1;
+
+	seq_printf(seq, "%-10s %10s %10s\n", "usecs", "flush", "commit");
+	for (i = 0; i < last; i++)
+		seq_printf(seq, "<%-9lu %10u %10u\n", 1UL << i,
+			   atomic_read(&flush[i]), atomic_read(&commit[i]));
+	seq_printf(seq, ">=%-8lu %10u %10u\n", 1UL << (last - 1),
+		   atomic_read(&flush[last]), atomic_read(&commit[last]));
+	return 0;
+}
+
+static int ext4_fsync_hist_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ext4_fsync_hist_show, PDE(inode)->data);
+}
+
+const struct file_operations ext4_fsync_hist_fops = {
+	.owner		= THIS_MODULE,
+	.open		= ext4_fsync_hist_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/* Has the transaction with this tid, if any, reached the journal? */
+static int ext4_fsync_tid_committed(journal_t *journal, tid_t tid)
+{
+	int ret;
+
+	read_lock(&journal->j_state_lock);
+	ret = tid_geq(journal->j_commit_sequence, tid);
+	read_unlock(&journal->j_state_lock);
+	return ret;
+}
+
 /*
  * akpm: A new design for ext4_sync_file().
  *
@@ -149,7 +202,10 @@ static void ext4_sync_parent(struct inode *inode)
  * state in the journalling system.
  *
  * What we do is just kick off a commit and wait on it.  This will snapshot the
- * inode to disk.
+ * inode to disk.  If the transaction that last changed the inode (or, for
+ * fdatasync, its block mapping) has committed already, as it has for an
+ * overwrite of allocated blocks, the caller has written the data and only
+ * the disk cache needs flushing.
  *
  * i_mutex lock is held when entering and exiting this function
  */
@@ -159,6 +215,7 @@ int ext4_sync_file(struct file *file, int datasync)
 	struct inode *inode = file->f_mapping->host;
 	struct ext4_inode_info *ei = EXT4_I(inode);
 	journal_t *journal = EXT4_SB(inode->i_sb)->s_journal;
+	ktime_t start = ktime_get();
 	int ret;
 	tid_t commit_tid;
 
@@ -177,6 +234,7 @@ int ext4_sync_file(struct file *file, int datasync)
 		ret = generic_file_fsync(file, datasync);
 		if (!ret && !list_empty(&inode->i_dentry))
 			ext4_sync_parent(inode);
+		ext4_fsync_account(inode->i_sb, EXT4_FSYNC_FLUSH, start);
 		return ret;
 	}
 
@@ -194,26 +252,39 @@ int ext4_sync_file(struct file *file, int datasync)
 	 *  (they were dirtied by commit).  But that's OK - the blocks are
 	 *  safe in-journal, which is all fsync() needs to ensure.
 	 */
-	if (ext4_should_journal_data(inode))
-		return ext4_force_commit(inode->i_sb);
+	if (ext4_should_journal_data(inode)) {
+		ret = ext4_force_commit(inode->i_sb);
+		ext4_fsync_account(inode->i_sb, EXT4_FSYNC_COMMIT, start);
+		return ret;
+	}
 
 	commit_tid = datasync ? ei->i_datasync_tid : ei->i_sync_tid;
-	if (jbd2_log_start_commit(journal, commit_tid)) {
-		/*
-		 * When the journal is on a different device than the
-		 * fs data disk, we need to issue the barrier in
-		 * writeback mode.  (In ordered mode, the jbd2 layer
-		 * will take care of issuing the barrier.  In
-		 * data=journal, all of the data blocks are written to
-		 * the journal device.)
-		 */
-		if (ext4_should_writeback_data(inode) &&
-		    (journal->j_fs_dev != journal->j_dev) &&
-		    (journal->j_flags & JBD2_BARRIER))
+	if (ext4_fsync_tid_committed(journal, commit_tid)) {
+		if (journal->j_flags & JBD2_BARRIER)
 			blkdev_issue_flush(inode->i_sb->s_bdev, GFP_KERNEL,
 					NULL);
-		ret = jbd2_log_wait_commit(journal, commit_tid);
-	} else if (journal->j_flags & JBD2_BARRIER)
+		ext4_fsync_account(inode->i_sb, EXT4_FSYNC_FLUSH, start);
+		return ret;
+	}
+
+	/*
+	 * The transaction may be committing already, in which case
+	 * there is nothing to start but we still have to wait for it.
+	 */
+	jbd2_log_start_commit(journal, commit_tid);
+	/*
+	 * When the journal is on a different device than the
+	 * fs data disk, we need to issue the barrier in
+	 * writeback mode.  (In ordered mode, the jbd2 layer
+	 * will take care of issuing the barrier.  In
+	 * data=journal, all of the data blocks are written to
+	 * the journal device.)
+	 */
+	if (ext4_should_writeback_data(inode) &&
+	    (journal->j_fs_dev != journal->j_dev) &&
+	    (journal->j_flags & JBD2_BARRIER))
 		blkdev_issue_flush(inode->i_sb->s_bdev, GFP_KERNEL, NULL);
+	ret = jbd2_log_wait_commit(journal, commit_tid);
+	ext4_fsync_account(inode->i_sb, EXT4_FSYNC_COMMIT, start);
 	return ret;
 }
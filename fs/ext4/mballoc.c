@@ -89,7 +89,9 @@
  * ext4_sb_info.s_locality_groups[smp_processor_id()]
  *
  * The reason for having a per cpu locality group is to reduce the contention
- * between CPUs. It is possible to get scheduled at this point.
+ * between CPUs. It is possible to get scheduled at this point. Each cpu has
+ * EXT4_LG_CLASSES of them; with an erase unit set appends to existing files
+ * use their own, to keep them out of the erase units of new small files.
  *
  * The locality group prealloc space is used looking at whether we have
  * enough free space (pa_free) withing the prealloc space.
@@ -131,7 +133,8 @@
  * /sys/fs/ext4/<partition/mb_group_prealloc. The value is represented in
  * terms of number of blocks. If we have mounted the file system with -O
  * stripe=<value> option the group prealloc request is normalized to the
- * stripe value (sbi->s_stripe)
+ * stripe value (sbi->s_stripe), else with the erase_unit option to the
+ * flash erase unit (sbi->s_erase_unit).
  *
  * The regular allocator(using the buddy cache) supports few tunables.
  *
@@ -144,7 +147,9 @@
  * value of s_mb_order2_reqs can be tuned via
  * /sys/fs/ext4/<partition>/mb_order2_req.  If the request len is equal to
  * stripe size (sbi->s_stripe), we try to search for contiguous block in
- * stripe size. This should result in better allocation on RAID setups. If
+ * stripe size. This should result in better allocation on RAID setups.
+ * Without a stripe the erase unit (sbi->s_erase_unit) is used the same
+ * way, so that flash sees whole erase units written together. If
  * not, we search in the specific group using bitmap for best extents. The
  * tunable min_to_scan and max_to_scan control the behaviour here.
  * min_to_scan indicate how long the mballoc __must__ look for a best
@@ -419,6 +424,12 @@ static inline int mb_find_next_bit(void *addr, int max, int start)
 	return ret;
 }
 
+/* allocations are aligned to the raid stripe, else to the erase unit */
+static inline unsigned int ext4_mb_align_unit(struct ext4_sb_info *sbi)
+{
+	return sbi->s_stripe ? sbi->s_stripe : sbi->s_erase_unit;
+}
+
 static void *mb_find_buddy(struct ext4_buddy *e4b, int order, int *max)
 {
 	char *bb;
@@ -1775,13 +1786,14 @@ int ext4_mb_find_by_goal(struct ext4_allocation_context *ac,
 	max = mb_find_extent(e4b, 0, ac->ac_g_ex.fe_start,
 			     ac->ac_g_ex.fe_len, &ex);
 
-	if (max >= ac->ac_g_ex.fe_len && ac->ac_g_ex.fe_len == sbi->s_stripe) {
+	if (max >= ac->ac_g_ex.fe_len &&
+	    ac->ac_g_ex.fe_len == ext4_mb_align_unit(sbi)) {
 		ext4_fsblk_t start;
 
 		start = ext4_group_first_block_no(ac->ac_sb, e4b->bd_group) +
 			ex.fe_start;
 		/* use do_div to get remainder (would be 64-bit modulo) */
-		if (do_div(start, sbi->s_stripe) == 0) {
+		if (do_div(start, ac->ac_g_ex.fe_len) == 0) {
 			ac->ac_found++;
 			ac->ac_b_ex = ex;
 			ext4_mb_use_best_found(ac, e4b);
@@ -1913,15 +1925,15 @@ void ext4_mb_complex_scan_group(struct ext4_allocation_context *ac,
 }
 
 /*
- * This is a special case for storages like raid5
- * we try to find stripe-aligned chunks for stripe-size-multiple requests
+ * This is a special case for storages like raid5 and for flash with an
+ * erase unit: we try to find aligned chunks for unit-size-multiple requests
  */
 static noinline_for_stack
 void ext4_mb_scan_aligned(struct ext4_allocation_context *ac,
 				 struct ext4_buddy *e4b)
 {
 	struct super_block *sb = ac->ac_sb;
-	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	unsigned int unit = ext4_mb_align_unit(EXT4_SB(sb));
 	void *bitmap = EXT4_MB_BITMAP(e4b);
 	struct ext4_free_extent ex;
 	ext4_fsblk_t first_group_block;
@@ -1929,26 +1941,26 @@ void ext4_mb_scan_aligned(struct ext4_allocation_context *ac,
 	ext4_grpblk_t i;
 	int max;
 
-	BUG_ON(sbi->s_stripe == 0);
+	BUG_ON(unit == 0);
 
-	/* find first stripe-aligned block in group */
+	/* find first unit-aligned block in group */
 	first_group_block = ext4_group_first_block_no(sb, e4b->bd_group);
 
-	a = first_group_block + sbi->s_stripe - 1;
-	do_div(a, sbi->s_stripe);
-	i = (a * sbi->s_stripe) - first_group_block;
+	a = first_group_block + unit - 1;
+	do_div(a, unit);
+	i = (a * unit) - first_group_block;
 
 	while (i < EXT4_BLOCKS_PER_GROUP(sb)) {
 		if (!mb_test_bit(i, bitmap)) {
-			max = mb_find_extent(e4b, 0, i, sbi->s_stripe, &ex);
-			if (max >= sbi->s_stripe) {
+			max = mb_find_extent(e4b, 0, i, unit, &ex);
+			if (max >= unit) {
 				ac->ac_found++;
 				ac->ac_b_ex = ex;
 				ext4_mb_use_best_found(ac, e4b);
 				break;
 			}
 		}
-		i += sbi->s_stripe;
+		i += unit;
 	}
 }
 
@@ -2013,12 +2025,14 @@ ext4_mb_regular_allocator(struct ext4_allocation_context *ac)
 	ext4_group_t ngroups, group, i;
 	int cr;
 	int err = 0;
+	unsigned int unit;
 	struct ext4_sb_info *sbi;
 	struct super_block *sb;
 	struct ext4_buddy e4b;
 
 	sb = ac->ac_sb;
 	sbi = EXT4_SB(sb);
+	unit = ext4_mb_align_unit(sbi);
 	ngroups = ext4_get_groups_count(sb);
 	/* non-extent files are limited to low blocks/groups */
 	if (!(ext4_test_inode_flag(ac->ac_inode, EXT4_INODE_EXTENTS)))
@@ -2105,8 +2119,8 @@ repeat:
 			ac->ac_groups_scanned++;
 			if (cr == 0)
 				ext4_mb_simple_scan_group(ac, &e4b);
-			else if (cr == 1 && sbi->s_stripe &&
-					!(ac->ac_g_ex.fe_len % sbi->s_stripe))
+			else if (cr == 1 && unit &&
+					!(ac->ac_g_ex.fe_len % unit))
 				ext4_mb_scan_aligned(ac, &e4b);
 			else
 				ext4_mb_complex_scan_group(ac, &e4b);
@@ -2526,18 +2540,24 @@ int ext4_mb_init(struct super_block *sb, int needs_recovery)
 	sbi->s_mb_order2_reqs = MB_DEFAULT_ORDER2_REQS;
 	sbi->s_mb_group_prealloc = MB_DEFAULT_GROUP_PREALLOC;
 
-	sbi->s_locality_groups = alloc_percpu(struct ext4_locality_group);
+	sbi->s_locality_groups = __alloc_percpu(EXT4_LG_CLASSES *
+				sizeof(struct ext4_locality_group),
+				__alignof__(struct ext4_locality_group));
 	if (sbi->s_locality_groups == NULL) {
 		ret = -ENOMEM;
 		goto out;
 	}
 	for_each_possible_cpu(i) {
 		struct ext4_locality_group *lg;
+		int k;
+
 		lg = per_cpu_ptr(sbi->s_locality_groups, i);
-		mutex_init(&lg->lg_mutex);
-		for (j = 0; j < PREALLOC_TB_SIZE; j++)
-			INIT_LIST_HEAD(&lg->lg_prealloc_list[j]);
-		spin_lock_init(&lg->lg_prealloc_lock);
+		for (k = 0; k < EXT4_LG_CLASSES; k++, lg++) {
+			mutex_init(&lg->lg_mutex);
+			for (j = 0; j < PREALLOC_TB_SIZE; j++)
+				INIT_LIST_HEAD(&lg->lg_prealloc_list[j]);
+			spin_lock_init(&lg->lg_prealloc_lock);
+		}
 	}
 
 	if (sbi->s_proc)
@@ -2890,8 +2910,8 @@ out_err:
 /*
  * here we normalize request for locality group
  * Group request are normalized to s_strip size if we set the same via mount
- * option. If not we set it to s_mb_group_prealloc which can be configured via
- * /sys/fs/ext4/<partition>/mb_group_prealloc
+ * option, else to the erase unit. If neither is set we use s_mb_group_prealloc
+ * which can be configured via /sys/fs/ext4/<partition>/mb_group_prealloc
  *
  * XXX: should we try to preallocate more than the group has now?
  */
@@ -2899,10 +2919,11 @@ static void ext4_mb_normalize_group_request(struct ext4_allocation_context *ac)
 {
 	struct super_block *sb = ac->ac_sb;
 	struct ext4_locality_group *lg = ac->ac_lg;
+	unsigned int unit = ext4_mb_align_unit(EXT4_SB(sb));
 
 	BUG_ON(lg == NULL);
-	if (EXT4_SB(sb)->s_stripe)
-		ac->ac_g_ex.fe_len = EXT4_SB(sb)->s_stripe;
+	if (unit)
+		ac->ac_g_ex.fe_len = unit;
 	else
 		ac->ac_g_ex.fe_len = EXT4_SB(sb)->s_mb_group_prealloc;
 	mb_debug(1, "#%u: goal %u blocks for locality group\n",
@@ -4009,6 +4030,8 @@ static void ext4_mb_group_or_file(struct ext4_allocation_context *ac)
 	 * request from multiple CPUs.
 	 */
 	ac->ac_lg = __this_cpu_ptr(sbi->s_locality_groups);
+	if (sbi->s_erase_unit && ac->ac_o_ex.fe_logical)
+		ac->ac_lg += EXT4_LG_APPEND;
 
 	/* we're going to use group allocation */
 	ac->ac_flags |= EXT4_MB_HINT_GROUP_ALLOC;
@@ -162,6 +162,14 @@ struct ext4_locality_group {
 	spinlock_t		lg_prealloc_lock;
 };
 
+/*
+ * With an erase unit set, new small files and appends to existing files
+ * use separate locality groups, so each class fills its own erase units.
+ */
+#define EXT4_LG_NEW		0
+#define EXT4_LG_APPEND		1
+#define EXT4_LG_CLASSES		2
+
 struct ext4_allocation_context {
 	struct inode *ac_inode;
 	struct super_block *ac_sb;
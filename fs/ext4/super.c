@@ -749,6 +749,7 @@ static void ext4_put_super(struct super_block *sb)
 		ext4_commit_super(sb, 1);
 	}
 	if (sbi->s_proc) {
+		remove_proc_entry("fsync_hist", sbi->s_proc);
 		remove_proc_entry(sb->s_id, ext4_proc_root);
 	}
 	kobject_del(&sbi->s_kobj);
@@ -1046,6 +1047,8 @@ static int ext4_show_options(struct seq_file *seq, struct vfsmount *vfs)
 		seq_puts(seq, ",mblk_io_submit");
 	if (sbi->s_stripe)
 		seq_printf(seq, ",stripe=%lu", sbi->s_stripe);
+	if (sbi->s_erase_unit)
+		seq_printf(seq, ",erase_unit=%u", sbi->s_erase_unit);
 	/*
 	 * journal mode get enabled in different ways
 	 * So just print the value even if we didn't specify it
@@ -1263,6 +1266,7 @@ enum {
 	Opt_dioread_nolock, Opt_dioread_lock,
 	Opt_discard, Opt_nodiscard,
 	Opt_init_inode_table, Opt_noinit_inode_table,
+	Opt_erase_unit, Opt_erase_unit_probe,
 };
 
 static const match_table_t tokens = {
@@ -1319,6 +1323,8 @@ static const match_table_t tokens = {
 	{Opt_nobarrier, "nobarrier"},
 	{Opt_i_version, "i_version"},
 	{Opt_stripe, "stripe=%u"},
+	{Opt_erase_unit, "erase_unit=%u"},
+	{Opt_erase_unit_probe, "erase_unit"},
 	{Opt_resize, "resize"},
 	{Opt_delalloc, "delalloc"},
 	{Opt_nodelalloc, "nodelalloc"},
@@ -1758,6 +1764,16 @@ set_qf_format:
 				return 0;
 			sbi->s_stripe = option;
 			break;
+		case Opt_erase_unit:
+			if (match_int(&args[0], &option))
+				return 0;
+			if (option < 0)
+				return 0;
+			sbi->s_erase_unit = option;
+			break;
+		case Opt_erase_unit_probe:
+			sbi->s_erase_unit = EXT4_ERASE_UNIT_PROBE;
+			break;
 		case Opt_delalloc:
 			set_opt(sb, DELALLOC);
 			break;
@@ -2355,6 +2371,28 @@ static unsigned long ext4_get_stripe_size(struct ext4_sb_info *sbi)
 	return 0;
 }
 
+/**
+ * ext4_get_erase_unit: Get the flash erase unit size in blocks.
+ * @sb: super block
+ *
+ * A bare "erase_unit" option takes the optimal I/O size of the device,
+ * which the MMC driver sets to the preferred erase size of the card (from
+ * EXT_CSD, or the SD allocation unit).  As with the stripe size the
+ * allocator needs it to be less than blocks per group, else return 0.
+ */
+static unsigned int ext4_get_erase_unit(struct super_block *sb)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	unsigned int unit = sbi->s_erase_unit;
+
+	if (unit == EXT4_ERASE_UNIT_PROBE)
+		unit = bdev_io_opt(sb->s_bdev) >> sb->s_blocksize_bits;
+
+	if (unit < 2 || unit > sbi->s_blocks_per_group)
+		return 0;
+	return unit;
+}
+
 /* sysfs supprt */
 
 struct ext4_attr {
@@ -2427,6 +2465,23 @@ static ssize_t inode_readahead_blks_store(struct ext4_attr *a,
 	return count;
 }
 
+static ssize_t erase_unit_store(struct ext4_attr *a,
+				struct ext4_sb_info *sbi,
+				const char *buf, size_t count)
+{
+	unsigned long t;
+
+	if (parse_strtoul(buf, sbi->s_blocks_per_group, &t))
+		return -EINVAL;
+
+	/* 0 turns it off; otherwise as checked by ext4_get_erase_unit() */
+	if (t == 1)
+		return -EINVAL;
+
+	sbi->s_erase_unit = t;
+	return count;
+}
+
 static ssize_t sbi_ui_show(struct ext4_attr *a,
 			   struct ext4_sb_info *sbi, char *buf)
 {
@@ -2477,6 +2532,8 @@ EXT4_RW_ATTR_SBI_UI(mb_min_to_scan, s_mb_min_to_scan);
 EXT4_RW_ATTR_SBI_UI(mb_order2_req, s_mb_order2_reqs);
 EXT4_RW_ATTR_SBI_UI(mb_stream_req, s_mb_stream_request);
 EXT4_RW_ATTR_SBI_UI(mb_group_prealloc, s_mb_group_prealloc);
+EXT4_ATTR_OFFSET(erase_unit, 0644, sbi_ui_show,
+		 erase_unit_store, s_erase_unit);
 EXT4_RW_ATTR_SBI_UI(max_writeback_mb_bump, s_max_writeback_mb_bump);
 
 static struct attribute *ext4_attrs[] = {
@@ -2491,6 +2548,7 @@ static struct attribute *ext4_attrs[] = {
 	ATTR_LIST(mb_order2_req),
 	ATTR_LIST(mb_stream_req),
 	ATTR_LIST(mb_group_prealloc),
+	ATTR_LIST(erase_unit),
 	ATTR_LIST(max_writeback_mb_bump),
 	NULL,
 };
@@ -3370,6 +3428,9 @@ static int ext4_fill_super(struct super_block *sb, void *data, int silent)
 #ifdef CONFIG_PROC_FS
 	if (ext4_proc_root)
 		sbi->s_proc = proc_mkdir(sb->s_id, ext4_proc_root);
+	if (sbi->s_proc)
+		proc_create_data("fsync_hist", S_IRUGO, sbi->s_proc,
+				 &ext4_fsync_hist_fops, sbi);
 #endif
 
 	bgl_lock_init(sbi->s_blockgroup_lock);
@@ -3419,6 +3480,7 @@ static int ext4_fill_super(struct super_block *sb, void *data, int silent)
 	}
 
 	sbi->s_stripe = ext4_get_stripe_size(sbi);
+	sbi->s_erase_unit = ext4_get_erase_unit(sb);
 	sbi->s_max_writeback_mb_bump = 128;
 
 	/*
@@ -3695,6 +3757,7 @@ failed_mount2:
 	kfree(sbi->s_group_desc);
 failed_mount:
 	if (sbi->s_proc) {
+		remove_proc_entry("fsync_hist", sbi->s_proc);
 		remove_proc_entry(sb->s_id, ext4_proc_root);
 	}
 #ifdef CONFIG_QUOTA
@@ -4203,6 +4266,7 @@ struct ext4_mount_options {
 	gid_t s_resgid;
 	unsigned long s_commit_interval;
 	u32 s_min_batch_time, s_max_batch_time;
+	unsigned int s_erase_unit;
 #ifdef CONFIG_QUOTA
 	int s_jquota_fmt;
 	char *s_qf_names[MAXQUOTAS];
@@ -4235,6 +4299,7 @@ static int ext4_remount(struct super_block *sb, int *flags, char *data)
 	old_opts.s_commit_interval = sbi->s_commit_interval;
 	old_opts.s_min_batch_time = sbi->s_min_batch_time;
 	old_opts.s_max_batch_time = sbi->s_max_batch_time;
+	old_opts.s_erase_unit = sbi->s_erase_unit;
 #ifdef CONFIG_QUOTA
 	old_opts.s_jquota_fmt = sbi->s_jquota_fmt;
 	for (i = 0; i < MAXQUOTAS; i++)
@@ -4251,6 +4316,7 @@ static int ext4_remount(struct super_block *sb, int *flags, char *data)
 		err = -EINVAL;
 		goto restore_opts;
 	}
+	sbi->s_erase_unit = ext4_get_erase_unit(sb);
 
 	if (sbi->s_mount_flags & EXT4_MF_FS_ABORTED)
 		ext4_abort(sb, "Abort forced by user");
@@ -4389,6 +4455,7 @@ restore_opts:
 	sbi->s_commit_interval = old_opts.s_commit_interval;
 	sbi->s_min_batch_time = old_opts.s_min_batch_time;
 	sbi->s_max_batch_time = old_opts.s_max_batch_time;
+	sbi->s_erase_unit = old_opts.s_erase_unit;
 #ifdef CONFIG_QUOTA
 	sbi->s_jquota_fmt = old_opts.s_jquota_fmt;
 	for (i = 0; i < MAXQUOTAS; i++) {
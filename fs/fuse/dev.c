@@ -34,34 +34,55 @@ static struct fuse_conn *fuse_get_conn(struct file *file)
 	return file->private_data;
 }
 
-static void fuse_request_init(struct fuse_req *req)
+static void fuse_request_init(struct fuse_req *req, struct page **pages,
+			      unsigned npages)
 {
 	memset(req, 0, sizeof(*req));
 	INIT_LIST_HEAD(&req->list);
 	INIT_LIST_HEAD(&req->intr_entry);
 	init_waitqueue_head(&req->waitq);
 	atomic_set(&req->count, 1);
+	req->pages = pages;
+	req->max_pages = npages;
 }
 
-struct fuse_req *fuse_request_alloc(void)
+static struct fuse_req *__fuse_request_alloc(unsigned npages, gfp_t flags)
 {
-	struct fuse_req *req = kmem_cache_alloc(fuse_req_cachep, GFP_KERNEL);
-	if (req)
-		fuse_request_init(req);
+	struct fuse_req *req = kmem_cache_alloc(fuse_req_cachep, flags);
+	struct page **pages;
+
+	if (!req)
+		return NULL;
+
+	if (npages <= FUSE_MAX_PAGES_PER_REQ) {
+		pages = req->inline_pages;
+		npages = FUSE_MAX_PAGES_PER_REQ;
+	} else {
+		pages = kmalloc(sizeof(struct page *) * npages, flags);
+		if (!pages) {
+			kmem_cache_free(fuse_req_cachep, req);
+			return NULL;
+		}
+	}
+	fuse_request_init(req, pages, npages);
 	return req;
 }
+
+struct fuse_req *fuse_request_alloc(void)
+{
+	return __fuse_request_alloc(FUSE_MAX_PAGES_PER_REQ, GFP_KERNEL);
+}
 EXPORT_SYMBOL_GPL(fuse_request_alloc);
 
 struct fuse_req *fuse_request_alloc_nofs(void)
 {
-	struct fuse_req *req = kmem_cache_alloc(fuse_req_cachep, GFP_NOFS);
-	if (req)
-		fuse_request_init(req);
-	return req;
+	return __fuse_request_alloc(FUSE_MAX_PAGES_PER_REQ, GFP_NOFS);
 }
 
 void fuse_request_free(struct fuse_req *req)
 {
+	if (req->pages != req->inline_pages)
+		kfree(req->pages);
 	kmem_cache_free(fuse_req_cachep, req);
 }
 
@@ -97,7 +118,7 @@ static void fuse_req_init_context(struct fuse_req *req)
 	req->in.h.pid = current->pid;
 }
 
-struct fuse_req *fuse_get_req(struct fuse_conn *fc)
+struct fuse_req *fuse_get_req_pages(struct fuse_conn *fc, unsigned npages)
 {
 	struct fuse_req *req;
 	sigset_t oldset;
@@ -116,7 +137,7 @@ struct fuse_req *fuse_get_req(struct fuse_conn *fc)
 	if (!fc->connected)
 		goto out;
 
-	req = fuse_request_alloc();
+	req = __fuse_request_alloc(npages, GFP_KERNEL);
 	err = -ENOMEM;
 	if (!req)
 		goto out;
@@ -129,6 +150,11 @@ struct fuse_req *fuse_get_req(struct fuse_conn *fc)
 	atomic_dec(&fc->num_waiting);
 	return ERR_PTR(err);
 }
+
+struct fuse_req *fuse_get_req(struct fuse_conn *fc)
+{
+	return fuse_get_req_pages(fc, FUSE_MAX_PAGES_PER_REQ);
+}
 EXPORT_SYMBOL_GPL(fuse_get_req);
 
 /*
@@ -166,7 +192,7 @@ static void put_reserved_req(struct fuse_conn *fc, struct fuse_req *req)
 	struct fuse_file *ff = file->private_data;
 
 	spin_lock(&fc->lock);
-	fuse_request_init(req);
+	fuse_request_init(req, req->inline_pages, FUSE_MAX_PAGES_PER_REQ);
 	BUG_ON(ff->reserved_req);
 	ff->reserved_req = req;
 	wake_up_all(&fc->reserved_req_waitq);
@@ -1372,7 +1398,59 @@ static int fuse_notify_inval_entry(struct fuse_conn *fc, unsigned int size,
 	down_read(&fc->killsb);
 	err = -ENOENT;
 	if (fc->sb)
-		err = fuse_reverse_inval_entry(fc->sb, outarg.parent, &name);
+		err = fuse_reverse_inval_entry(fc->sb, outarg.parent, 0, &name);
+	up_read(&fc->killsb);
+	kfree(buf);
+	return err;
+
+err:
+	kfree(buf);
+	fuse_copy_finish(cs);
+	return err;
+}
+
+static int fuse_notify_delete(struct fuse_conn *fc, unsigned int size,
+			      struct fuse_copy_state *cs)
+{
+	struct fuse_notify_delete_out outarg;
+	int err = -ENOMEM;
+	char *buf;
+	struct qstr name;
+
+	buf = kzalloc(FUSE_NAME_MAX + 1, GFP_KERNEL);
+	if (!buf)
+		goto err;
+
+	err = -EINVAL;
+	if (size < sizeof(outarg))
+		goto err;
+
+	err = fuse_copy_one(cs, &outarg, sizeof(outarg));
+	if (err)
+		goto err;
+
+	err = -ENAMETOOLONG;
+	if (outarg.namelen > FUSE_NAME_MAX)
+		goto err;
+
+	err = -EINVAL;
+	if (size != sizeof(outarg) + outarg.namelen + 1)
+		goto err;
+
+	name.name = buf;
+	name.len = outarg.namelen;
+	err = fuse_copy_one(cs, buf, outarg.namelen + 1);
+	if (err)
+		goto err;
+	fuse_copy_finish(cs);
+	buf[outarg.namelen] = 0;
+	name.hash = full_name_hash(name.name, name.len);
+
+	down_read(&fc->killsb);
+	err = -ENOENT;
+	if (fc->sb)
+		err = fuse_reverse_inval_entry(fc->sb, outarg.parent,
+					       outarg.child, &name);
 	up_read(&fc->killsb);
 	kfree(buf);
 	return err;
@@ -1383,6 +1461,93 @@ err:
 	return err;
 }
 
+/*
+ * Apply a batch of inode and entry invalidations.  The records are
+ * copied in first, so the copy state is finished before taking
+ * fc->killsb, and then all of them are applied under one hold of it.
+ * Inodes and entries that are not cached are skipped.
+ */
+static int fuse_notify_inval_batch(struct fuse_conn *fc, unsigned int size,
+				   struct fuse_copy_state *cs)
+{
+	struct fuse_notify_inval_batch_out outarg;
+	struct fuse_notify_inval_batch_entry *ent;
+	unsigned int i;
+	size_t reclen = 0;
+	char *buf;
+	char *p;
+	int err;
+
+	err = -EINVAL;
+	if (!fc->inval_batch)
+		goto err;
+	if (size < sizeof(outarg) || size > FUSE_NOTIFY_INVAL_BATCH_MAX)
+		goto err;
+
+	err = fuse_copy_one(cs, &outarg, sizeof(outarg));
+	if (err)
+		goto err;
+
+	size -= sizeof(outarg);
+	err = -ENOMEM;
+	buf = kmalloc(size, GFP_KERNEL);
+	if (!buf)
+		goto err;
+
+	err = fuse_copy_one(cs, buf, size);
+	fuse_copy_finish(cs);
+	if (err)
+		goto out_free;
+
+	/* Check every record before acting on any */
+	err = -EINVAL;
+	for (i = 0, p = buf; i < outarg.count; i++, p += reclen) {
+		ent = (struct fuse_notify_inval_batch_entry *) p;
+		if (p + sizeof(*ent) > buf + size)
+			goto out_free;
+		if (ent->namelen > FUSE_NAME_MAX) {
+			err = -ENAMETOOLONG;
+			goto out_free;
+		}
+		reclen = FUSE_INVAL_BATCH_ENTRY_SIZE(ent);
+		if (p + reclen > buf + size)
+			goto out_free;
+		if (ent->namelen && ent->name[ent->namelen])
+			goto out_free;
+	}
+
+	down_read(&fc->killsb);
+	err = -ENOENT;
+	if (fc->sb) {
+		err = 0;
+		for (i = 0, p = buf; i < outarg.count; i++, p += reclen) {
+			ent = (struct fuse_notify_inval_batch_entry *) p;
+			reclen = FUSE_INVAL_BATCH_ENTRY_SIZE(ent);
+			if (ent->namelen) {
+				struct qstr name;
+
+				name.name = ent->name;
+				name.len = ent->namelen;
+				name.hash = full_name_hash(name.name, name.len);
+				fuse_reverse_inval_entry(fc->sb, ent->ino, 0,
+							 &name);
+			} else {
+				fuse_reverse_inval_inode(fc->sb, ent->ino,
+							 ent->off, ent->len);
+			}
+		}
+	}
+	up_read(&fc->killsb);
+
+out_free:
+	kfree(buf);
+	return err;
+
+err:
+	fuse_copy_finish(cs);
+	return err;
+}
+
 static int fuse_notify_store(struct fuse_conn *fc, unsigned int size,
 			     struct fuse_copy_state *cs)
 {
@@ -1590,6 +1755,12 @@ static int fuse_notify(struct fuse_conn *fc, enum fuse_notify_code code,
 	case FUSE_NOTIFY_RETRIEVE:
 		return fuse_notify_retrieve(fc, size, cs);
 
+	case FUSE_NOTIFY_DELETE:
+		return fuse_notify_delete(fc, size, cs);
+
+	case FUSE_NOTIFY_INVAL_BATCH:
+		return fuse_notify_inval_batch(fc, size, cs);
+
 	default:
 		fuse_copy_finish(cs);
 		return -EINVAL;
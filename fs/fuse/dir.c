@@ -89,6 +89,18 @@ void fuse_invalidate_attr(struct inode *inode)
 	get_fuse_inode(inode)->i_time = 0;
 }
 
+/*
+ * Mark the attributes as stale after a read or write, since the
+ * filesystem may have changed the times.  Not done if the attributes
+ * were declared authoritative: the filesystem then invalidates them
+ * itself, and size and mtime are kept up to date locally.
+ */
+void fuse_invalidate_attr_io(struct inode *inode)
+{
+	if (!get_fuse_conn(inode)->attr_authoritative)
+		fuse_invalidate_attr(inode);
+}
+
 /*
  * Just mark the entry as stale, so that a next attempt to look it up
  * will result in a new lookup call to userspace
@@ -867,7 +879,7 @@ int fuse_update_attributes(struct inode *inode, struct kstat *stat,
 }
 
 int fuse_reverse_inval_entry(struct super_block *sb, u64 parent_nodeid,
-			     struct qstr *name)
+			     u64 child_nodeid, struct qstr *name)
 {
 	int err = -ENOTDIR;
 	struct inode *parent;
@@ -894,8 +906,36 @@ int fuse_reverse_inval_entry(struct super_block *sb, u64 parent_nodeid,
 
 	fuse_invalidate_attr(parent);
 	fuse_invalidate_entry(entry);
+
+	if (child_nodeid != 0 && entry->d_inode) {
+		mutex_lock(&entry->d_inode->i_mutex);
+		if (get_node_id(entry->d_inode) != child_nodeid) {
+			err = -ENOENT;
+			goto badentry;
+		}
+		if (d_mountpoint(entry)) {
+			err = -EBUSY;
+			goto badentry;
+		}
+		if (S_ISDIR(entry->d_inode->i_mode)) {
+			shrink_dcache_parent(entry);
+			if (!simple_empty(entry)) {
+				err = -ENOTEMPTY;
+				goto badentry;
+			}
+			entry->d_inode->i_flags |= S_DEAD;
+		}
+		dont_mount(entry);
+		clear_nlink(entry->d_inode);
+		err = 0;
+ badentry:
+		mutex_unlock(&entry->d_inode->i_mutex);
+		if (!err)
+			d_delete(entry);
+	} else {
+		err = 0;
+	}
 	dput(entry);
-	err = 0;
 
  unlock:
 	mutex_unlock(&parent->i_mutex);
@@ -1062,6 +1102,162 @@ static int parse_dirfile(char *buf, size_t nbytes, struct file *file,
 	return 0;
 }
 
+/*
+ * Instantiate a dentry and inode from a READDIRPLUS entry, as a lookup
+ * of the name would.  The filesystem took a lookup reference for the
+ * entry, which the caller drops with a FORGET if this fails.
+ */
+static int fuse_direntplus_link(struct file *file,
+				struct fuse_direntplus *direntplus,
+				u64 attr_version)
+{
+	int err;
+	struct fuse_entry_out *o = &direntplus->entry_out;
+	struct fuse_dirent *dirent = &direntplus->dirent;
+	struct dentry *parent = file->f_path.dentry;
+	struct inode *dir = parent->d_inode;
+	struct fuse_conn *fc = get_fuse_conn(dir);
+	struct qstr name;
+	struct dentry *dentry;
+	struct dentry *alias;
+	struct inode *inode;
+
+	/* Zero nodeid: the filesystem returned no entry for this name */
+	if (!o->nodeid)
+		return 0;
+
+	name.name = dirent->name;
+	name.len = dirent->namelen;
+	if (name.name[0] == '.') {
+		if (name.len == 1)
+			return 0;
+		if (name.name[1] == '.' && name.len == 2)
+			return 0;
+	}
+
+	if (invalid_nodeid(o->nodeid))
+		return -EIO;
+	if (!fuse_valid_type(o->attr.mode))
+		return -EIO;
+
+	name.hash = full_name_hash(name.name, name.len);
+	dentry = d_lookup(parent, &name);
+	if (dentry) {
+		inode = dentry->d_inode;
+		if (!inode) {
+			d_drop(dentry);
+		} else if (get_node_id(inode) != o->nodeid ||
+			   ((o->attr.mode ^ inode->i_mode) & S_IFMT)) {
+			err = d_invalidate(dentry);
+			if (err)
+				goto out;
+		} else if (is_bad_inode(inode)) {
+			err = -EIO;
+			goto out;
+		} else {
+			struct fuse_inode *fi = get_fuse_inode(inode);
+
+			spin_lock(&fc->lock);
+			fi->nlookup++;
+			spin_unlock(&fc->lock);
+
+			fuse_change_attributes(inode, &o->attr,
+					       entry_attr_timeout(o),
+					       attr_version);
+			goto found;
+		}
+		dput(dentry);
+	}
+
+	err = -ENOMEM;
+	dentry = d_alloc(parent, &name);
+	if (!dentry)
+		return err;
+
+	inode = fuse_iget(dir->i_sb, o->nodeid, o->generation,
+			  &o->attr, entry_attr_timeout(o), attr_version);
+	if (!inode)
+		goto out;
+
+	if (S_ISDIR(inode->i_mode)) {
+		mutex_lock(&fc->inst_mutex);
+		alias = fuse_d_add_directory(dentry, inode);
+		mutex_unlock(&fc->inst_mutex);
+		if (IS_ERR(alias))
+			iput(inode);
+	} else {
+		alias = d_splice_alias(inode, dentry);
+	}
+	if (IS_ERR(alias)) {
+		/* The lookup reference went with the inode */
+		err = 0;
+		goto out;
+	}
+
+	if (alias) {
+		dput(dentry);
+		dentry = alias;
+	}
+
+found:
+	fuse_change_entry_timeout(dentry, o);
+	err = 0;
+out:
+	dput(dentry);
+	return err;
+}
+
+static void fuse_force_forget(struct file *file, u64 nodeid)
+{
+	struct fuse_conn *fc = get_fuse_conn(file->f_path.dentry->d_inode);
+	struct fuse_forget_link *forget = fuse_alloc_forget();
+
+	/* Without memory the lookup reference leaks, as in fuse_lookup */
+	if (forget)
+		fuse_queue_forget(fc, forget, nodeid, 1);
+}
+
+static int parse_dirplusfile(char *buf, size_t nbytes, struct file *file,
+			     void *dstbuf, filldir_t filldir,
+			     u64 attr_version)
+{
+	int over = 0;
+
+	while (nbytes >= FUSE_NAME_OFFSET_DIRENTPLUS) {
+		struct fuse_direntplus *direntplus;
+		struct fuse_dirent *dirent;
+		size_t reclen;
+
+		direntplus = (struct fuse_direntplus *) buf;
+		dirent = &direntplus->dirent;
+		reclen = FUSE_DIRENTPLUS_SIZE(direntplus);
+		if (!dirent->namelen || dirent->namelen > FUSE_NAME_MAX)
+			return -EIO;
+		if (reclen > nbytes)
+			break;
+
+		/*
+		 * Keep going once the user buffer is full: every entry
+		 * returned carries a lookup reference, and linking it
+		 * saves the lookup when it is read again.
+		 */
+		if (!over) {
+			over = filldir(dstbuf, dirent->name, dirent->namelen,
+				       file->f_pos, dirent->ino, dirent->type);
+			if (!over)
+				file->f_pos = dirent->off;
+		}
+
+		buf += reclen;
+		nbytes -= reclen;
+
+		if (fuse_direntplus_link(file, direntplus, attr_version))
+			fuse_force_forget(file, direntplus->entry_out.nodeid);
+	}
+
+	return 0;
+}
+
 static int fuse_readdir(struct file *file, void *dstbuf, filldir_t filldir)
 {
 	int err;
@@ -1070,6 +1266,8 @@ static int fuse_readdir(struct file *file, void *dstbuf, filldir_t filldir)
 	struct inode *inode = file->f_path.dentry->d_inode;
 	struct fuse_conn *fc = get_fuse_conn(inode);
 	struct fuse_req *req;
+	u64 attr_version = 0;
+	int plus = fc->do_readdirplus;
 
 	if (is_bad_inode(inode))
 		return -EIO;
@@ -1086,17 +1284,30 @@ static int fuse_readdir(struct file *file, void *dstbuf, filldir_t filldir)
 	req->out.argpages = 1;
 	req->num_pages = 1;
 	req->pages[0] = page;
-	fuse_read_fill(req, file, file->f_pos, PAGE_SIZE, FUSE_READDIR);
+	if (plus) {
+		attr_version = fuse_get_attr_version(fc);
+		fuse_read_fill(req, file, file->f_pos, PAGE_SIZE,
+			       FUSE_READDIRPLUS);
+	} else {
+		fuse_read_fill(req, file, file->f_pos, PAGE_SIZE,
+			       FUSE_READDIR);
+	}
 	fuse_request_send(fc, req);
 	nbytes = req->out.args[0].size;
 	err = req->out.h.error;
 	fuse_put_request(fc, req);
-	if (!err)
-		err = parse_dirfile(page_address(page), nbytes, file, dstbuf,
-				    filldir);
+	if (!err) {
+		if (plus)
+			err = parse_dirplusfile(page_address(page), nbytes,
+						file, dstbuf, filldir,
+						attr_version);
+		else
+			err = parse_dirfile(page_address(page), nbytes, file,
+					    dstbuf, filldir);
+	}
 
 	__free_page(page);
-	fuse_invalidate_attr(inode); /* atime changed */
+	fuse_invalidate_attr_io(inode); /* atime changed */
 	return err;
 }
 
@@ -1129,7 +1340,7 @@ static char *read_link(struct dentry *dentry)
 		link[req->out.args[0].size] = '\0';
  out:
 	fuse_put_request(fc, req);
-	fuse_invalidate_attr(inode); /* atime changed */
+	fuse_invalidate_attr_io(inode); /* atime changed */
 	return link;
 }
 
@@ -554,7 +554,7 @@ static int fuse_readpage(struct file *file, struct page *page)
 		SetPageUptodate(page);
 	}
 
-	fuse_invalidate_attr(inode); /* atime changed */
+	fuse_invalidate_attr_io(inode); /* atime changed */
  out:
 	unlock_page(page);
 	return err;
@@ -583,7 +583,7 @@ static void fuse_readpages_end(struct fuse_conn *fc, struct fuse_req *req)
 			fuse_read_update_size(inode, pos,
 					      req->misc.read.attr_ver);
 		}
-		fuse_invalidate_attr(inode); /* atime changed */
+		fuse_invalidate_attr_io(inode); /* atime changed */
 	}
 
 	for (i = 0; i < req->num_pages; i++) {
@@ -638,11 +638,11 @@ static int fuse_readpages_fill(void *_data, struct page *page)
 	fuse_wait_on_page_writeback(inode, page->index);
 
 	if (req->num_pages &&
-	    (req->num_pages == FUSE_MAX_PAGES_PER_REQ ||
+	    (req->num_pages == req->max_pages ||
 	     (req->num_pages + 1) * PAGE_CACHE_SIZE > fc->max_read ||
 	     req->pages[req->num_pages - 1]->index + 1 != page->index)) {
 		fuse_send_readpages(req, data->file);
-		data->req = req = fuse_get_req(fc);
+		data->req = req = fuse_get_req_pages(fc, fc->max_pages);
 		if (IS_ERR(req)) {
 			unlock_page(page);
 			return PTR_ERR(req);
@@ -668,7 +668,7 @@ static int fuse_readpages(struct file *file, struct address_space *mapping,
 
 	data.file = file;
 	data.inode = inode;
-	data.req = fuse_get_req(fc);
+	data.req = fuse_get_req_pages(fc, min(nr_pages, fc->max_pages));
 	err = PTR_ERR(data.req);
 	if (IS_ERR(data.req))
 		goto out;
@@ -764,6 +764,8 @@ void fuse_write_update_size(struct inode *inode, loff_t pos)
 	fi->attr_version = ++fc->attr_version;
 	if (pos > inode->i_size)
 		i_size_write(inode, pos);
+	if (fc->attr_authoritative)
+		inode->i_mtime = inode->i_ctime = current_fs_time(inode->i_sb);
 	spin_unlock(&fc->lock);
 }
 
@@ -804,7 +806,7 @@ static int fuse_buffered_write(struct file *file, struct inode *inode,
 		if (count == PAGE_CACHE_SIZE)
 			SetPageUptodate(page);
 	}
-	fuse_invalidate_attr(inode);
+	fuse_invalidate_attr_io(inode);
 	return err ? err : nres;
 }
 
@@ -917,7 +919,7 @@ static ssize_t fuse_fill_write_pages(struct fuse_req *req,
 		if (!fc->big_writes)
 			break;
 	} while (iov_iter_count(ii) && count < fc->max_write &&
-		 req->num_pages < FUSE_MAX_PAGES_PER_REQ && offset == 0);
+		 req->num_pages < req->max_pages && offset == 0);
 
 	return count > 0 ? count : err;
 }
@@ -938,7 +940,7 @@ static ssize_t fuse_perform_write(struct file *file,
 		struct fuse_req *req;
 		ssize_t count;
 
-		req = fuse_get_req(fc);
+		req = fuse_get_req_pages(fc, fc->max_pages);
 		if (IS_ERR(req)) {
 			err = PTR_ERR(req);
 			break;
@@ -968,11 +970,51 @@ static ssize_t fuse_perform_write(struct file *file,
 	if (res > 0)
 		fuse_write_update_size(inode, pos);
 
-	fuse_invalidate_attr(inode);
+	fuse_invalidate_attr_io(inode);
 
 	return res > 0 ? res : err;
 }
 
+/*
+ * Send a big cached write from the user's pages, like direct I/O, so
+ * that a daemon splicing from the device gets them without a copy into
+ * the page cache.  Cached pages in the range are written back before
+ * and dropped after.  Returns 0 if the write has to be copied after
+ * all.
+ */
+static ssize_t fuse_write_user_pages(struct file *file,
+				     const struct iovec *iov,
+				     unsigned long nr_segs, size_t count,
+				     loff_t pos)
+{
+	struct address_space *mapping = file->f_mapping;
+	struct inode *inode = mapping->host;
+	pgoff_t start = pos >> PAGE_CACHE_SHIFT;
+	pgoff_t end = (pos + count - 1) >> PAGE_CACHE_SHIFT;
+	ssize_t written;
+	int err;
+
+	if (nr_segs != 1 || is_bad_inode(inode))
+		return 0;
+
+	err = filemap_write_and_wait_range(mapping, pos, pos + count - 1);
+	if (err)
+		return err;
+
+	/* Mapped pages that can't be dropped: copy instead */
+	if (invalidate_inode_pages2_range(mapping, start, end))
+		return 0;
+
+	written = fuse_direct_io(file, iov->iov_base, count, &pos, 1);
+	if (written > 0) {
+		fuse_write_update_size(inode, pos);
+		invalidate_inode_pages2_range(mapping, start, end);
+	}
+	fuse_invalidate_attr_io(inode);
+
+	return written;
+}
+
 static ssize_t fuse_file_aio_write(struct kiocb *iocb, const struct iovec *iov,
 				   unsigned long nr_segs, loff_t pos)
 {
@@ -981,6 +1023,7 @@ static ssize_t fuse_file_aio_write(struct kiocb *iocb, const struct iovec *iov,
 	size_t count = 0;
 	ssize_t written = 0;
 	struct inode *inode = mapping->host;
+	struct fuse_conn *fc = get_fuse_conn(inode);
 	ssize_t err;
 	struct iov_iter i;
 
@@ -1009,8 +1052,13 @@ static ssize_t fuse_file_aio_write(struct kiocb *iocb, const struct iovec *iov,
 
 	file_update_time(file);
 
-	iov_iter_init(&i, iov, nr_segs, count, 0);
-	written = fuse_perform_write(file, mapping, &i, pos);
+	if (fc->direct_write_min && count >= fc->direct_write_min)
+		written = fuse_write_user_pages(file, iov, nr_segs, count, pos);
+
+	if (!written) {
+		iov_iter_init(&i, iov, nr_segs, count, 0);
+		written = fuse_perform_write(file, mapping, &i, pos);
+	}
 	if (written >= 0)
 		iocb->ki_pos = pos + written;
 
@@ -1051,9 +1099,9 @@ static int fuse_get_user_pages(struct fuse_req *req, const char __user *buf,
 		return 0;
 	}
 
-	nbytes = min_t(size_t, nbytes, FUSE_MAX_PAGES_PER_REQ << PAGE_SHIFT);
+	nbytes = min_t(size_t, nbytes, req->max_pages << PAGE_SHIFT);
 	npages = (nbytes + offset + PAGE_SIZE - 1) >> PAGE_SHIFT;
-	npages = clamp(npages, 1, FUSE_MAX_PAGES_PER_REQ);
+	npages = clamp(npages, 1, (int) req->max_pages);
 	npages = get_user_pages_fast(user_addr, npages, !write, req->pages);
 	if (npages < 0)
 		return npages;
@@ -1082,7 +1130,7 @@ ssize_t fuse_direct_io(struct file *file, const char __user *buf,
 	ssize_t res = 0;
 	struct fuse_req *req;
 
-	req = fuse_get_req(fc);
+	req = fuse_get_req_pages(fc, fc->max_pages);
 	if (IS_ERR(req))
 		return PTR_ERR(req);
 
@@ -1118,7 +1166,7 @@ ssize_t fuse_direct_io(struct file *file, const char __user *buf,
 			break;
 		if (count) {
 			fuse_put_request(fc, req);
-			req = fuse_get_req(fc);
+			req = fuse_get_req_pages(fc, fc->max_pages);
 			if (IS_ERR(req))
 				break;
 		}
@@ -1143,7 +1191,7 @@ static ssize_t fuse_direct_read(struct file *file, char __user *buf,
 
 	res = fuse_direct_io(file, buf, count, ppos, 0);
 
-	fuse_invalidate_attr(inode);
+	fuse_invalidate_attr_io(inode);
 
 	return res;
 }
@@ -1167,7 +1215,7 @@ static ssize_t fuse_direct_write(struct file *file, const char __user *buf,
 	}
 	mutex_unlock(&inode->i_mutex);
 
-	fuse_invalidate_attr(inode);
+	fuse_invalidate_attr_io(inode);
 
 	return res;
 }
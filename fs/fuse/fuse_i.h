@@ -23,9 +23,12 @@
 #include <linux/poll.h>
 #include <linux/workqueue.h>
 
-/** Max number of pages that can be used in a single read request */
+/** Number of pages a request holds without a separate page vector */
 #define FUSE_MAX_PAGES_PER_REQ 32
 
+/** Max number of pages the filesystem may negotiate for a request */
+#define FUSE_MAX_MAX_PAGES 256
+
 /** Bias for fi->writectr, meaning new writepages must not be sent */
 #define FUSE_NOWRITE INT_MIN
 
@@ -286,7 +289,13 @@ struct fuse_req {
 	} misc;
 
 	/** page vector */
-	struct page *pages[FUSE_MAX_PAGES_PER_REQ];
+	struct page **pages;
+
+	/** size of the page vector */
+	unsigned max_pages;
+
+	/** inline page vector */
+	struct page *inline_pages[FUSE_MAX_PAGES_PER_REQ];
 
 	/** number of pages in vector */
 	unsigned num_pages;
@@ -342,6 +351,12 @@ struct fuse_conn {
 	/** Maximum write size */
 	unsigned max_write;
 
+	/** Maximum number of pages in a read or write request */
+	unsigned max_pages;
+
+	/** Cached writes at least this big go straight from user pages */
+	unsigned direct_write_min;
+
 	/** Readers of the connection are waiting on this */
 	wait_queue_head_t waitq;
 
@@ -473,6 +488,15 @@ struct fuse_conn {
 	/** Don't apply umask to creation modes */
 	unsigned dont_mask:1;
 
+	/** Use READDIRPLUS instead of READDIR */
+	unsigned do_readdirplus:1;
+
+	/** Attributes change only through us or invalidation notifies */
+	unsigned attr_authoritative:1;
+
+	/** Accept FUSE_NOTIFY_INVAL_BATCH */
+	unsigned inval_batch:1;
+
 	/** The number of requests waiting for completion */
 	atomic_t num_waiting;
 
@@ -657,6 +681,11 @@ void fuse_request_free(struct fuse_req *req);
  */
 struct fuse_req *fuse_get_req(struct fuse_conn *fc);
 
+/**
+ * Get a request with room for npages pages, may fail with -ENOMEM
+ */
+struct fuse_req *fuse_get_req_pages(struct fuse_conn *fc, unsigned npages);
+
 /**
  * Gets a requests for a file operation, always succeeds
  */
@@ -689,6 +718,12 @@ void fuse_abort_conn(struct fuse_conn *fc);
  */
 void fuse_invalidate_attr(struct inode *inode);
 
+/**
+ * Invalidate inode attributes after a read or write, unless the
+ * filesystem declared them authoritative
+ */
+void fuse_invalidate_attr_io(struct inode *inode);
+
 void fuse_invalidate_entry_cache(struct dentry *entry);
 
 /**
@@ -749,9 +784,15 @@ int fuse_reverse_inval_inode(struct super_block *sb, u64 nodeid,
 /**
  * File-system tells the kernel to invalidate parent attributes and
  * the dentry matching parent/name.
+ *
+ * If the child_nodeid is non-zero and:
+ *    - matches the inode number for the dentry matching parent/name,
+ *    - is not a mount point
+ *    - is a file or an empty directory
+ * then the dentry is unhashed (d_delete()).
  */
 int fuse_reverse_inval_entry(struct super_block *sb, u64 parent_nodeid,
-			     struct qstr *name);
+			     u64 child_nodeid, struct qstr *name);
 
 int fuse_do_open(struct fuse_conn *fc, u64 nodeid, struct file *file,
 		 bool isdir);
@@ -69,6 +69,9 @@ struct fuse_mount_data {
 	unsigned flags;
 	unsigned max_read;
 	unsigned blksize;
+	unsigned direct_write_min;
+	unsigned attr_authoritative:1;
+	unsigned inval_batch:1;
 };
 
 struct fuse_forget_link *fuse_alloc_forget()
@@ -405,6 +408,9 @@ enum {
 	OPT_ALLOW_OTHER,
 	OPT_MAX_READ,
 	OPT_BLKSIZE,
+	OPT_DIRECT_WRITE_MIN,
+	OPT_ATTR_AUTHORITATIVE,
+	OPT_INVAL_BATCH,
 	OPT_ERR
 };
 
@@ -417,6 +423,9 @@ static const match_table_t tokens = {
 	{OPT_ALLOW_OTHER,		"allow_other"},
 	{OPT_MAX_READ,			"max_read=%u"},
 	{OPT_BLKSIZE,			"blksize=%u"},
+	{OPT_DIRECT_WRITE_MIN,		"direct_write_min=%u"},
+	{OPT_ATTR_AUTHORITATIVE,	"attr_authoritative"},
+	{OPT_INVAL_BATCH,		"inval_batch"},
 	{OPT_ERR,			NULL}
 };
 
@@ -486,6 +495,20 @@ static int parse_fuse_opt(char *opt, struct fuse_mount_data *d, int is_bdev)
 			d->blksize = value;
 			break;
 
+		case OPT_DIRECT_WRITE_MIN:
+			if (match_int(&args[0], &value))
+				return 0;
+			d->direct_write_min = value;
+			break;
+
+		case OPT_ATTR_AUTHORITATIVE:
+			d->attr_authoritative = 1;
+			break;
+
+		case OPT_INVAL_BATCH:
+			d->inval_batch = 1;
+			break;
+
 		default:
 			return 0;
 		}
@@ -510,6 +533,12 @@ static int fuse_show_options(struct seq_file *m, struct vfsmount *mnt)
 		seq_puts(m, ",allow_other");
 	if (fc->max_read != ~0)
 		seq_printf(m, ",max_read=%u", fc->max_read);
+	if (fc->direct_write_min)
+		seq_printf(m, ",direct_write_min=%u", fc->direct_write_min);
+	if (fc->attr_authoritative)
+		seq_puts(m, ",attr_authoritative");
+	if (fc->inval_batch)
+		seq_puts(m, ",inval_batch");
 	if (mnt->mnt_sb->s_bdev &&
 	    mnt->mnt_sb->s_blocksize != FUSE_DEFAULT_BLKSIZE)
 		seq_printf(m, ",blksize=%lu", mnt->mnt_sb->s_blocksize);
@@ -535,6 +564,7 @@ void fuse_conn_init(struct fuse_conn *fc)
 	fc->forget_list_tail = &fc->forget_list_head;
 	atomic_set(&fc->num_waiting, 0);
 	fc->max_background = FUSE_DEFAULT_MAX_BACKGROUND;
+	fc->max_pages = FUSE_MAX_PAGES_PER_REQ;
 	fc->congestion_threshold = FUSE_DEFAULT_CONGESTION_THRESHOLD;
 	fc->khctr = 0;
 	fc->polled_files = RB_ROOT;
@@ -793,6 +823,8 @@ static void process_init_limits(struct fuse_conn *fc, struct fuse_init_out *arg)
 static void process_init_reply(struct fuse_conn *fc, struct fuse_req *req)
 {
 	struct fuse_init_out *arg = &req->misc.init_out;
+	unsigned max_pages_end = offsetof(struct fuse_init_out, max_pages) +
+				 sizeof(arg->max_pages);
 
 	if (req->out.h.error || arg->major != FUSE_KERNEL_VERSION)
 		fc->conn_error = 1;
@@ -813,11 +845,26 @@ static void process_init_reply(struct fuse_conn *fc, struct fuse_req *req)
 				/* LOOKUP has dependency on proto version */
 				if (arg->flags & FUSE_EXPORT_SUPPORT)
 					fc->export_support = 1;
+				/* so is the direntplus layout */
+				if (arg->flags & FUSE_DO_READDIRPLUS)
+					fc->do_readdirplus = 1;
 			}
 			if (arg->flags & FUSE_BIG_WRITES)
 				fc->big_writes = 1;
 			if (arg->flags & FUSE_DONT_MASK)
 				fc->dont_mask = 1;
+			/*
+			 * Older servers truncate init_out to the size they
+			 * know, and may use the flag bit for something else;
+			 * keep the default unless max_pages was really sent.
+			 */
+			if ((arg->flags & FUSE_MAX_PAGES) &&
+			    req->out.args[0].size >= max_pages_end &&
+			    arg->max_pages) {
+				fc->max_pages = min_t(unsigned,
+						      FUSE_MAX_MAX_PAGES,
+						      arg->max_pages);
+			}
 		} else {
 			ra_pages = fc->max_read / PAGE_CACHE_SIZE;
 			fc->no_lock = 1;
@@ -841,7 +888,8 @@ static void fuse_send_init(struct fuse_conn *fc, struct fuse_req *req)
 	arg->minor = FUSE_KERNEL_MINOR_VERSION;
 	arg->max_readahead = fc->bdi.ra_pages * PAGE_CACHE_SIZE;
 	arg->flags |= FUSE_ASYNC_READ | FUSE_POSIX_LOCKS | FUSE_ATOMIC_O_TRUNC |
-		FUSE_EXPORT_SUPPORT | FUSE_BIG_WRITES | FUSE_DONT_MASK;
+		FUSE_EXPORT_SUPPORT | FUSE_BIG_WRITES | FUSE_DONT_MASK |
+		FUSE_DO_READDIRPLUS | FUSE_MAX_PAGES;
 	req->in.h.opcode = FUSE_INIT;
 	req->in.numargs = 1;
 	req->in.args[0].size = sizeof(*arg);
@@ -971,6 +1019,9 @@ static int fuse_fill_super(struct super_block *sb, void *data, int silent)
 	fc->user_id = d.user_id;
 	fc->group_id = d.group_id;
 	fc->max_read = max_t(unsigned, 4096, d.max_read);
+	fc->direct_write_min = d.direct_write_min;
+	fc->attr_authoritative = d.attr_authoritative;
+	fc->inval_batch = d.inval_batch;
 
 	/* Used by get_root_inode() */
 	sb->s_fs_info = fc;
@@ -165,6 +165,32 @@ static int journal_wait_on_commit_record(journal_t *journal,
 	return ret;
 }
 
+/*
+ * Wait for the I/O on a list of log buffers to complete, last buffer
+ * first so that we are less likely to be woken up before all is done.
+ * The buffers stay on the list.  BJ_IO and BJ_LogCtl buffers are only
+ * moved by the commit thread, so j_list_lock is not needed.
+ */
+static int journal_wait_on_log_list(struct journal_head *head)
+{
+	struct journal_head *jh;
+	struct buffer_head *bh;
+	int ret = 0;
+
+	if (!head)
+		return 0;
+	jh = head;
+	do {
+		jh = jh->b_tprev;
+		bh = jh2bh(jh);
+		wait_on_buffer(bh);
+		if (unlikely(!buffer_uptodate(bh)))
+			ret = -EIO;
+	} while (jh != head);
+
+	return ret;
+}
+
 /*
  * write the filemap data using writepage() address_space_operations.
  * We don't do block allocation here even for delalloc. We don't
@@ -317,7 +343,7 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	int flags;
 	int err;
 	unsigned long long blocknr;
-	ktime_t start_time;
+	ktime_t start_time, locked_time;
 	u64 commit_time;
 	char *tagp = NULL;
 	journal_header_t *header;
@@ -373,6 +399,7 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	trace_jbd2_commit_locking(journal, commit_transaction);
 	stats.run.rs_wait = commit_transaction->t_max_wait;
 	stats.run.rs_locked = jiffies;
+	locked_time = ktime_get();
 	stats.run.rs_running = jbd2_time_diff(commit_transaction->t_start,
 					      stats.run.rs_locked);
 
@@ -697,6 +724,26 @@ start_journal_io:
 						 &cbh, crc32_sum);
 		if (err)
 			__jbd2_journal_abort_hard(journal);
+	} else {
+		/*
+		 * Without a checksum the commit record must not reach
+		 * the disk before the rest of the transaction, but it
+		 * can go as soon as that I/O has completed: the cache
+		 * flush in front of it covers everything completed.
+		 * Unfiling the log buffers below then overlaps with the
+		 * commit record write.
+		 */
+		err = journal_wait_on_log_list(
+					commit_transaction->t_iobuf_list);
+		if (!err)
+			err = journal_wait_on_log_list(
+					commit_transaction->t_log_list);
+		if (err)
+			jbd2_journal_abort(journal, err);
+		err = journal_submit_commit_record(journal, commit_transaction,
+						&cbh, crc32_sum);
+		if (err)
+			__jbd2_journal_abort_hard(journal);
 	}
 
 	/* Lo and behold: we have just managed to send a transaction to
@@ -801,13 +848,6 @@ wait_for_iobuf:
 
 	jbd_debug(3, "JBD: commit phase 5\n");
 
-	if (!JBD2_HAS_INCOMPAT_FEATURE(journal,
-				       JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT)) {
-		err = journal_submit_commit_record(journal, commit_transaction,
-						&cbh, crc32_sum);
-		if (err)
-			__jbd2_journal_abort_hard(journal);
-	}
 	if (!err && !is_journal_aborted(journal))
 		err = journal_wait_on_commit_record(journal, cbh);
 	if (JBD2_HAS_INCOMPAT_FEATURE(journal,
@@ -990,6 +1030,11 @@ restart_loop:
 	journal->j_commit_sequence = commit_transaction->t_tid;
 	journal->j_committing_transaction = NULL;
 	commit_time = ktime_to_ns(ktime_sub(ktime_get(), start_time));
+	spin_lock(&journal->j_history_lock);
+	jbd2_hist_add(journal->j_hist.th_locked,
+		      ktime_to_ns(ktime_sub(start_time, locked_time)));
+	jbd2_hist_add(journal->j_hist.th_commit, commit_time);
+	spin_unlock(&journal->j_history_lock);
 
 	/*
 	 * weight the commit time higher than the average time so we don't
@@ -811,6 +811,43 @@ static const struct file_operations jbd2_seq_info_fops = {
 	.release        = jbd2_seq_info_release,
 };
 
+static int jbd2_seq_hist_show(struct seq_file *seq, void *v)
+{
+	journal_t *journal = seq->private;
+	struct transaction_hist_s *h;
+	int i, last = JBD2_HIST_SLOTS - 1;
+
+	h = kmalloc(sizeof(*h), GFP_KERNEL);
+	if (h == NULL)
+		return -ENOMEM;
+	spin_lock(&journal->j_history_lock);
+	memcpy(h, &journal->j_hist, sizeof(*h));
+	spin_unlock(&journal->j_history_lock);
+
+	seq_printf(seq, "%-10s %10s %10s %10s\n",
+		   "usecs", "wait", "locked", "commit");
+	for (i = 0; i < last; i++)
+		seq_printf(seq, "<%-9lu %10lu %10lu %10lu\n", 1UL << i,
+			   h->th_wait[i], h->th_locked[i], h->th_commit[i]);
+	seq_printf(seq, ">=%-8lu %10lu %10lu %10lu\n", 1UL << (last - 1),
+		   h->th_wait[last], h->th_locked[last], h->th_commit[last]);
+	kfree(h);
+	return 0;
+}
+
+static int jbd2_seq_hist_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, jbd2_seq_hist_show, PDE(inode)->data);
+}
+
+static const struct file_operations jbd2_seq_hist_fops = {
+	.owner		= THIS_MODULE,
+	.open		= jbd2_seq_hist_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static struct proc_dir_entry *proc_jbd2_stats;
 
 static void jbd2_stats_proc_init(journal_t *journal)
@@ -819,11 +856,14 @@ static void jbd2_stats_proc_init(journal_t *journal)
 	if (journal->j_proc_entry) {
 		proc_create_data("info", S_IRUGO, journal->j_proc_entry,
 				 &jbd2_seq_info_fops, journal);
+		proc_create_data("hist", S_IRUGO, journal->j_proc_entry,
+				 &jbd2_seq_hist_fops, journal);
 	}
 }
 
 static void jbd2_stats_proc_exit(journal_t *journal)
 {
+	remove_proc_entry("hist", journal->j_proc_entry);
 	remove_proc_entry("info", journal->j_proc_entry);
 	remove_proc_entry(journal->j_devname, proc_jbd2_stats);
 }
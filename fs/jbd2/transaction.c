@@ -107,6 +107,13 @@ static inline void update_t_max_wait(transaction_t *transaction)
 #endif
 }
 
+/* Note when a handle first has to wait, for the j_hist wait histogram. */
+static inline void handle_wait_start(ktime_t *wait_start)
+{
+	if (!wait_start->tv64)
+		*wait_start = ktime_get();
+}
+
 /*
  * start_this_handle: Given a handle, deal with any locking or stalling
  * needed to make sure that there is enough journal space for the handle
@@ -121,6 +128,7 @@ static int start_this_handle(journal_t *journal, handle_t *handle,
 	tid_t		tid;
 	int		needed, need_to_start;
 	int		nblocks = handle->h_buffer_credits;
+	ktime_t		wait_start = { .tv64 = 0 };
 
 	if (nblocks > journal->j_max_transaction_buffers) {
 		printk(KERN_ERR "JBD: %s wants too many credits (%d > %d)\n",
@@ -167,6 +175,7 @@ repeat:
 	/* Wait on the journal's transaction barrier if necessary */
 	if (journal->j_barrier_count) {
 		read_unlock(&journal->j_state_lock);
+		handle_wait_start(&wait_start);
 		wait_event(journal->j_wait_transaction_locked,
 				journal->j_barrier_count == 0);
 		goto repeat;
@@ -197,6 +206,7 @@ repeat:
 		prepare_to_wait(&journal->j_wait_transaction_locked,
 					&wait, TASK_UNINTERRUPTIBLE);
 		read_unlock(&journal->j_state_lock);
+		handle_wait_start(&wait_start);
 		schedule();
 		finish_wait(&journal->j_wait_transaction_locked, &wait);
 		goto repeat;
@@ -227,6 +237,7 @@ repeat:
 		read_unlock(&journal->j_state_lock);
 		if (need_to_start)
 			jbd2_log_start_commit(journal, tid);
+		handle_wait_start(&wait_start);
 		schedule();
 		finish_wait(&journal->j_wait_transaction_locked, &wait);
 		goto repeat;
@@ -261,6 +272,7 @@ repeat:
 		jbd_debug(2, "Handle %p waiting for checkpoint...\n", handle);
 		atomic_sub(nblocks, &transaction->t_outstanding_credits);
 		read_unlock(&journal->j_state_lock);
+		handle_wait_start(&wait_start);
 		write_lock(&journal->j_state_lock);
 		if (__jbd2_log_space_left(journal) < jbd_space_needed(journal))
 			__jbd2_log_wait_for_space(journal);
@@ -281,6 +293,14 @@ repeat:
 		  __jbd2_log_space_left(journal));
 	read_unlock(&journal->j_state_lock);
 
+	if (wait_start.tv64) {
+		u64 ns = ktime_to_ns(ktime_sub(ktime_get(), wait_start));
+
+		spin_lock(&journal->j_history_lock);
+		jbd2_hist_add(journal->j_hist.th_wait, ns);
+		spin_unlock(&journal->j_history_lock);
+	}
+
 	lock_map_acquire(&handle->h_lockdep_map);
 	kfree(new_transaction);
 	return 0;
@@ -81,6 +81,7 @@
 #include <linux/pid_namespace.h>
 #include <linux/ptrace.h>
 #include <linux/tracehook.h>
+#include <linux/bulkstat.h>
 
 #include <asm/pgtable.h>
 #include <asm/processor.h>
@@ -529,6 +530,96 @@ int proc_tgid_stat(struct seq_file *m, struct pid_namespace *ns,
 	return do_task_stat(m, ns, pid, task, 1);
 }
 
+static u64 cputime_to_ns(cputime_t t)
+{
+	struct timespec ts;
+
+	cputime_to_timespec(t, &ts);
+	return timespec_to_ns(&ts);
+}
+
+/*
+ * Fill in the /proc/bulkstat record of a thread group, the values
+ * do_task_stat() shows for the whole group plus statm and a few from
+ * status.
+ */
+void task_bulk_stat(struct pid_namespace *ns, struct task_struct *task,
+		    struct bulkstat_task *bs)
+{
+	const struct cred *cred;
+	struct mm_struct *mm;
+	cputime_t utime, stime;
+	unsigned long flags;
+
+	memset(bs, 0, sizeof(*bs));
+	bs->bs_size = sizeof(*bs);
+	bs->bs_pid = task_tgid_nr_ns(task, ns);
+	get_task_comm(bs->bs_comm, task);
+	bs->bs_state = *get_task_state(task);
+
+	rcu_read_lock();
+	cred = __task_cred(task);
+	bs->bs_uid = cred->uid;
+	bs->bs_euid = cred->euid;
+	bs->bs_gid = cred->gid;
+	rcu_read_unlock();
+
+	if (lock_task_sighand(task, &flags)) {
+		struct signal_struct *sig = task->signal;
+		struct task_struct *t = task;
+
+		do {
+			bs->bs_min_flt += t->min_flt;
+			bs->bs_maj_flt += t->maj_flt;
+			bs->bs_nvcsw += t->nvcsw;
+			bs->bs_nivcsw += t->nivcsw;
+			t = next_thread(t);
+		} while (t != task);
+		bs->bs_min_flt += sig->min_flt;
+		bs->bs_maj_flt += sig->maj_flt;
+		bs->bs_nvcsw += sig->nvcsw;
+		bs->bs_nivcsw += sig->nivcsw;
+
+		thread_group_times(task, &utime, &stime);
+		bs->bs_utime = cputime_to_ns(utime);
+		bs->bs_stime = cputime_to_ns(stime);
+		bs->bs_cutime = cputime_to_ns(sig->cutime);
+		bs->bs_cstime = cputime_to_ns(sig->cstime);
+
+		bs->bs_num_threads = get_nr_threads(task);
+		bs->bs_oom_adj = sig->oom_adj;
+		bs->bs_oom_score_adj = sig->oom_score_adj;
+		bs->bs_sid = task_session_nr_ns(task, ns);
+		bs->bs_ppid = task_tgid_nr_ns(task->real_parent, ns);
+		bs->bs_pgid = task_pgrp_nr_ns(task, ns);
+
+		unlock_task_sighand(task, &flags);
+	}
+
+	bs->bs_prio = task_prio(task);
+	bs->bs_nice = task_nice(task);
+	bs->bs_policy = task->policy;
+	bs->bs_rt_priority = task->rt_priority;
+	bs->bs_cpu = task_cpu(task);
+	bs->bs_flags = task->flags;
+	bs->bs_start_time = timespec_to_ns(&task->real_start_time);
+
+	mm = get_task_mm(task);
+	if (mm) {
+		unsigned long shared, text, data, resident;
+
+		bs->bs_vm_size = task_statm(mm, &shared, &text, &data,
+					    &resident);
+		bs->bs_vm_rss = resident;
+		bs->bs_vm_shared = shared;
+		bs->bs_vm_text = text;
+		bs->bs_vm_data = data;
+		bs->bs_vm_hwm = get_mm_hiwater_rss(mm);
+		bs->bs_vm_swap = get_mm_counter(mm, MM_SWAPENTS);
+		mmput(mm);
+	}
+}
+
 int proc_pid_statm(struct seq_file *m, struct pid_namespace *ns,
 			struct pid *pid, struct task_struct *task)
 {
@@ -83,6 +83,7 @@
 #include <linux/pid_namespace.h>
 #include <linux/fs_struct.h>
 #include <linux/slab.h>
+#include <linux/cpufreq.h>
 #include "internal.h"
 
 /* NOTE:
@@ -2851,6 +2852,9 @@ static const struct pid_entry tgid_base_stuff[] = {
 #ifdef CONFIG_SCHEDSTATS
 	INF("schedstat",  S_IRUGO, proc_pid_schedstat),
 #endif
+#ifdef CONFIG_CPU_FREQ_STAT_TASK
+	INF("time_in_state", S_IRUGO, proc_time_in_state_show),
+#endif
 #ifdef CONFIG_LATENCYTOP
 	REG("latency",  S_IRUGO, proc_lstats_operations),
 #endif
@@ -3192,6 +3196,9 @@ static const struct pid_entry tid_base_stuff[] = {
 #ifdef CONFIG_SCHEDSTATS
 	INF("schedstat", S_IRUGO, proc_pid_schedstat),
 #endif
+#ifdef CONFIG_CPU_FREQ_STAT_TASK
+	INF("time_in_state", S_IRUGO, proc_time_in_state_show),
+#endif
 #ifdef CONFIG_LATENCYTOP
 	REG("latency",  S_IRUGO, proc_lstats_operations),
 #endif
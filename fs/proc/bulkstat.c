@@ -0,0 +1,168 @@
+#include <linux/fs.h>
+#include <linux/init.h>
+#include <linux/mutex.h>
+#include <linux/pid.h>
+#include <linux/pid_namespace.h>
+#include <linux/proc_fs.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+#include <linux/bulkstat.h>
+#include "internal.h"
+
+/*
+ * /proc/bulkstat: fixed size records of many processes per read(2), so a
+ * monitor sampling every process costs a few system calls instead of an
+ * open, read and close of stat, status and statm for each.  The record
+ * layout and the pid filter are described in <linux/bulkstat.h>.
+ */
+
+struct bulkstat_file {
+	struct mutex	lock;		/* filter and position */
+	unsigned int	nr_pids;
+	pid_t		*pids;
+};
+
+/*
+ * Next thread group leader at or after *pos, with a reference held, and
+ * *pos advanced past it.
+ */
+static struct task_struct *bulkstat_next(struct bulkstat_file *bf,
+					 struct pid_namespace *ns, loff_t *pos)
+{
+	struct task_struct *task = NULL;
+	struct pid *pid;
+
+	rcu_read_lock();
+	if (bf->nr_pids) {
+		while (!task && *pos < bf->nr_pids) {
+			pid = find_pid_ns(bf->pids[*pos], ns);
+			task = pid_task(pid, PIDTYPE_PID);
+			(*pos)++;
+		}
+	} else {
+		while (!task && *pos < PID_MAX_LIMIT) {
+			pid = find_ge_pid(*pos, ns);
+			if (!pid)
+				break;
+			*pos = pid_nr_ns(pid, ns) + 1;
+			task = pid_task(pid, PIDTYPE_PID);
+			if (task && !has_group_leader_pid(task))
+				task = NULL;
+		}
+	}
+	if (task)
+		get_task_struct(task);
+	rcu_read_unlock();
+	return task;
+}
+
+static ssize_t bulkstat_read(struct file *file, char __user *buf,
+			     size_t count, loff_t *ppos)
+{
+	struct bulkstat_file *bf = file->private_data;
+	struct pid_namespace *ns = file->f_path.dentry->d_sb->s_fs_info;
+	struct bulkstat_task *bs;
+	struct task_struct *task = NULL;
+	ssize_t done = 0;
+	loff_t pos;
+
+	if (count < sizeof(*bs))
+		return -EINVAL;
+	bs = kmalloc(sizeof(*bs), GFP_KERNEL);
+	if (!bs)
+		return -ENOMEM;
+
+	mutex_lock(&bf->lock);
+	pos = *ppos;
+	while (count - done >= sizeof(*bs)) {
+		task = bulkstat_next(bf, ns, &pos);
+		if (!task)
+			break;
+		task_bulk_stat(ns, task, bs);
+		put_task_struct(task);
+
+		if (copy_to_user(buf + done, bs, sizeof(*bs))) {
+			if (!done)
+				done = -EFAULT;
+			break;
+		}
+		done += sizeof(*bs);
+		*ppos = pos;
+	}
+	if (!task)
+		*ppos = pos;
+	mutex_unlock(&bf->lock);
+
+	kfree(bs);
+	return done;
+}
+
+static ssize_t bulkstat_write(struct file *file, const char __user *buf,
+			      size_t count, loff_t *ppos)
+{
+	struct bulkstat_file *bf = file->private_data;
+	pid_t *pids = NULL;
+	unsigned int nr = count / sizeof(pid_t);
+
+	if (!nr || count % sizeof(pid_t) || nr > BULKSTAT_MAX_PIDS)
+		return -EINVAL;
+
+	pids = kmalloc(count, GFP_KERNEL);
+	if (!pids)
+		return -ENOMEM;
+	if (copy_from_user(pids, buf, count)) {
+		kfree(pids);
+		return -EFAULT;
+	}
+	if (nr == 1 && pids[0] == 0) {
+		kfree(pids);
+		pids = NULL;
+		nr = 0;
+	}
+
+	mutex_lock(&bf->lock);
+	kfree(bf->pids);
+	bf->pids = pids;
+	bf->nr_pids = nr;
+	*ppos = 0;
+	mutex_unlock(&bf->lock);
+
+	return count;
+}
+
+static int bulkstat_open(struct inode *inode, struct file *file)
+{
+	struct bulkstat_file *bf;
+
+	bf = kzalloc(sizeof(*bf), GFP_KERNEL);
+	if (!bf)
+		return -ENOMEM;
+	mutex_init(&bf->lock);
+	file->private_data = bf;
+	return 0;
+}
+
+static int bulkstat_release(struct inode *inode, struct file *file)
+{
+	struct bulkstat_file *bf = file->private_data;
+
+	kfree(bf->pids);
+	kfree(bf);
+	return 0;
+}
+
+static const struct file_operations bulkstat_proc_fops = {
+	.open		= bulkstat_open,
+	.read		= bulkstat_read,
+	.write		= bulkstat_write,
+	.llseek		= default_llseek,
+	.release	= bulkstat_release,
+};
+
+static int __init proc_bulkstat_init(void)
+{
+	proc_create("bulkstat", S_IRUGO | S_IWUGO, NULL, &bulkstat_proc_fops);
+	return 0;
+}
+module_init(proc_bulkstat_init);
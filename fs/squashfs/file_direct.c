@@ -0,0 +1,182 @@
+/*
+ * Squashfs - a compressed read only filesystem for Linux
+ *
+ * Copyright (c) 2002, 2003, 2004, 2005, 2006, 2007, 2008, 2009
+ * Phillip Lougher <phillip@lougher.demon.co.uk>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * file_direct.c
+ */
+
+
+#include <linux/fs.h>
+#include <linux/vfs.h>
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/highmem.h>
+#include <linux/mutex.h>
+#include <linux/pagemap.h>
+
+#include "squashfs_fs.h"
+#include "squashfs_fs_sb.h"
+#include "squashfs_fs_i.h"
+#include "squashfs.h"
+
+/*
+ * Datablocks are decompressed straight into the page cache pages they
+ * cover, rather than into the read_page cache and then copied.  This
+ * saves a copy of every block, and readers of different blocks do not
+ * contend for the read_page entries.  If any of the pages is already
+ * present (uptodate or locked by another reader) the block is read
+ * through the cache instead, as the decompressors need a destination
+ * for all of the data.
+ */
+
+/*
+ * A datablock of highmem pages holds up to 256 kmap slots until it is
+ * decompressed.  Readers mapping their pages one at a time could each
+ * end up holding part of the pool and waiting for the rest, so the
+ * mapping is serialised: every reader that is not mapping holds a full
+ * set and will release it.
+ */
+static DEFINE_MUTEX(squashfs_kmap_mutex);
+
+static int squashfs_read_cache(struct page *target_page, u64 block, int bsize)
+{
+	struct inode *i = target_page->mapping->host;
+	struct squashfs_cache_entry *buffer = squashfs_get_datablock(i->i_sb,
+		block, bsize);
+	int res = buffer->error;
+
+	if (res)
+		ERROR("Unable to read page, block %llx, size %x\n", block,
+			bsize);
+	else
+		squashfs_copy_cache(target_page, buffer, buffer->length, 0);
+
+	squashfs_cache_put(buffer);
+	return res;
+}
+
+
+/* Read separately compressed datablock directly into page cache */
+int squashfs_readpage_block(struct page *target_page, u64 block, int bsize)
+{
+	struct inode *inode = target_page->mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int file_end = (i_size_read(inode) - 1) >> PAGE_CACHE_SHIFT;
+	int mask = (1 << (msblk->block_log - PAGE_CACHE_SHIFT)) - 1;
+	int start_index = target_page->index & ~mask;
+	int end_index = start_index | mask;
+	int i, n, pages, bytes, missing_pages = 0, res = -ENOMEM;
+	struct page **page;
+	void **pageaddr;
+
+	if (end_index > file_end)
+		end_index = file_end;
+
+	pages = end_index - start_index + 1;
+
+	page = kmalloc(pages * sizeof(*page), GFP_KERNEL);
+	if (page == NULL)
+		return res;
+
+	pageaddr = kmalloc(pages * sizeof(*pageaddr), GFP_KERNEL);
+	if (pageaddr == NULL)
+		goto out;
+
+	/* Try to grab all the pages covered by the datablock */
+	for (i = 0, n = start_index; i < pages; i++, n++) {
+		page[i] = (n == target_page->index) ? target_page :
+			grab_cache_page_nowait(target_page->mapping, n);
+
+		if (page[i] == NULL) {
+			missing_pages++;
+			continue;
+		}
+
+		if (PageUptodate(page[i])) {
+			unlock_page(page[i]);
+			page_cache_release(page[i]);
+			page[i] = NULL;
+			missing_pages++;
+		}
+	}
+
+	if (missing_pages) {
+		/*
+		 * Couldn't get one or more pages, they are either still
+		 * in the page cache and uptodate, or locked by another
+		 * reader of the same datablock.  Fall back to using the
+		 * read_page cache.
+		 */
+		for (i = 0; i < pages; i++) {
+			if (page[i] == NULL || page[i] == target_page)
+				continue;
+			unlock_page(page[i]);
+			page_cache_release(page[i]);
+		}
+		res = squashfs_read_cache(target_page, block, bsize);
+		goto out;
+	}
+
+	mutex_lock(&squashfs_kmap_mutex);
+	for (i = 0; i < pages; i++)
+		pageaddr[i] = kmap(page[i]);
+	mutex_unlock(&squashfs_kmap_mutex);
+
+	/*
+	 * Decompress into the pages.  Passing the size of the pages as the
+	 * maximum makes squashfs_read_data reject a corrupted block that
+	 * would overrun them.
+	 */
+	res = squashfs_read_data(inode->i_sb, pageaddr, block, bsize, NULL,
+		pages << PAGE_CACHE_SHIFT, pages);
+
+	if (res >= 0) {
+		/* Zero whatever the datablock did not fill */
+		for (i = res >> PAGE_CACHE_SHIFT; i < pages; i++) {
+			bytes = i == res >> PAGE_CACHE_SHIFT ?
+				res & (PAGE_CACHE_SIZE - 1) : 0;
+			memset(pageaddr[i] + bytes, 0, PAGE_CACHE_SIZE - bytes);
+		}
+	}
+
+	for (i = 0; i < pages; i++) {
+		kunmap(page[i]);
+		if (res >= 0) {
+			flush_dcache_page(page[i]);
+			SetPageUptodate(page[i]);
+		}
+		if (page[i] == target_page)
+			continue;
+		unlock_page(page[i]);
+		page_cache_release(page[i]);
+	}
+
+	if (res < 0)
+		ERROR("Unable to read page, block %llx, size %x\n", block,
+			bsize);
+	else {
+		unlock_page(target_page);
+		res = 0;
+	}
+
+out:
+	kfree(pageaddr);
+	kfree(page);
+	return res;
+}
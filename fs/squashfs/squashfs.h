@@ -49,6 +49,13 @@ extern int squashfs_read_table(struct super_block *, void *, u64, int);
 /* decompressor.c */
 extern const struct squashfs_decompressor *squashfs_lookup_decompressor(int);
 
+/* file.c */
+extern void squashfs_copy_cache(struct page *, struct squashfs_cache_entry *,
+				int, int);
+
+/* file_cache.c or file_direct.c */
+extern int squashfs_readpage_block(struct page *, u64, int);
+
 /* export.c */
 extern __le64 *squashfs_read_inode_lookup_table(struct super_block *, u64,
 				unsigned int);
@@ -26,6 +26,7 @@
 #include "yaffs_yaffs2.h"
 #include "yaffs_bitmap.h"
 #include "yaffs_verify.h"
+#include "yaffs_summary.h"
 
 #include "yaffs_nand.h"
 #include "yaffs_packedtags2.h"
@@ -474,8 +475,10 @@ static int yaffs_alloc_chunk(struct yaffs_dev *dev, int use_reserver,
 
 		dev->n_free_chunks--;
 
-		/* If the block is full set the state to full */
-		if (dev->alloc_page >= dev->param.chunks_per_block) {
+		/* If the block is full set the state to full.  The chunks
+		 * after chunks_per_summary are left for the block summary.
+		 */
+		if (dev->alloc_page >= dev->chunks_per_summary) {
 			bi->block_state = YAFFS_BLOCK_STATE_FULL;
 			dev->alloc_block = -1;
 		}
@@ -609,6 +612,8 @@ static int yaffs_write_new_chunk(struct yaffs_dev *dev,
 
 	if (!write_ok)
 		chunk = -1;
+	else
+		yaffs_summary_add(dev, tags, chunk);
 
 	if (attempts > 1) {
 		yaffs_trace(YAFFS_TRACE_ERROR,
@@ -1394,47 +1399,115 @@ static int yaffs_change_obj_name(struct yaffs_obj *obj,
  *   In Linux, the page cache provides read buffering and the short op cache 
  *   provides write buffering.
  *
- *   There are a limited number (~10) of cache chunks per device so that we don't
- *   need a very intelligent search.
+ *   Cache entries are hashed on (obj_id, chunk_id) and kept on an LRU list,
+ *   so lookups and replacement do not depend on the number of entries and
+ *   the cache can be sized in the hundreds for small write workloads.
  */
 
-static int yaffs_obj_cache_dirty(struct yaffs_obj *obj)
+static struct list_head *yaffs_cache_bucket(struct yaffs_dev *dev,
+					    const struct yaffs_obj *obj,
+					    int chunk_id)
+{
+	u32 hash = obj->obj_id * 31 + chunk_id;
+
+	return &dev->cache_hash[hash & dev->cache_hash_mask];
+}
+
+/* Hash a free cache entry in for obj/chunk_id and make it most recent. */
+static void yaffs_cache_assign(struct yaffs_dev *dev, struct yaffs_cache *cache,
+			       struct yaffs_obj *obj, int chunk_id)
+{
+	cache->object = obj;
+	cache->chunk_id = chunk_id;
+	cache->dirty = 0;
+	cache->locked = 0;
+	cache->n_bytes = 0;
+	list_add(&cache->hash_list, yaffs_cache_bucket(dev, obj, chunk_id));
+	list_add(&cache->obj_list, &obj->cache_list);
+	list_move(&cache->lru, &dev->cache_lru);
+}
+
+static void yaffs_cache_set_dirty(struct yaffs_dev *dev,
+				  struct yaffs_cache *cache)
+{
+	if (cache->dirty)
+		return;
+	cache->dirty = 1;
+	list_add_tail(&cache->dirty_list, &dev->cache_dirty);
+	cache->object->n_dirty_caches++;
+	dev->n_dirty_caches++;
+}
+
+static void yaffs_cache_clean(struct yaffs_dev *dev, struct yaffs_cache *cache)
+{
+	if (!cache->dirty)
+		return;
+	cache->dirty = 0;
+	list_del_init(&cache->dirty_list);
+	cache->object->n_dirty_caches--;
+	dev->n_dirty_caches--;
+}
+
+/* Drop a cache entry's contents and put it back on the free list. */
+static void yaffs_cache_release(struct yaffs_dev *dev,
+				struct yaffs_cache *cache)
+{
+	yaffs_cache_clean(dev, cache);
+	cache->object = NULL;
+	list_del_init(&cache->hash_list);
+	list_del_init(&cache->obj_list);
+	list_move(&cache->lru, &dev->cache_free);
+}
+
+static struct yaffs_cache *yaffs_cache_lookup(const struct yaffs_obj *obj,
+					      int chunk_id)
 {
 	struct yaffs_dev *dev = obj->my_dev;
-	int i;
+	struct list_head *bucket = yaffs_cache_bucket(dev, obj, chunk_id);
 	struct yaffs_cache *cache;
-	int n_caches = obj->my_dev->param.n_caches;
 
-	for (i = 0; i < n_caches; i++) {
-		cache = &dev->cache[i];
-		if (cache->object == obj && cache->dirty)
-			return 1;
+	list_for_each_entry(cache, bucket, hash_list) {
+		if (cache->object == obj && cache->chunk_id == chunk_id)
+			return cache;
 	}
+	return NULL;
+}
 
-	return 0;
+static int yaffs_obj_cache_dirty(struct yaffs_obj *obj)
+{
+	return obj->n_dirty_caches > 0;
 }
 
 static void yaffs_flush_file_cache(struct yaffs_obj *obj)
 {
 	struct yaffs_dev *dev = obj->my_dev;
 	int lowest = -99;	/* Stop compiler whining. */
-	int i;
 	struct yaffs_cache *cache;
+	struct yaffs_cache *next;
+	struct yaffs_cache *entry;
 	int chunk_written = 0;
-	int n_caches = obj->my_dev->param.n_caches;
 
-	if (n_caches > 0) {
+	if (obj->n_dirty_caches > 0) {
 		do {
-			cache = NULL;
+			/* Sequential writes: try the next chunk first */
+			next = NULL;
+			if (chunk_written > 0) {
+				next = yaffs_cache_lookup(obj, lowest + 1);
+				if (next && !next->dirty)
+					next = NULL;
+				if (next)
+					lowest = next->chunk_id;
+			}
+			cache = next;
 
 			/* Find the dirty cache for this object with the lowest chunk id. */
-			for (i = 0; i < n_caches; i++) {
-				if (dev->cache[i].object == obj &&
-				    dev->cache[i].dirty) {
-					if (!cache
-					    || dev->cache[i].chunk_id <
-					    lowest) {
-						cache = &dev->cache[i];
+			if (!next) {
+				list_for_each_entry(entry, &obj->cache_list,
+						    obj_list) {
+					if (entry->dirty &&
+					    (!cache ||
+					     entry->chunk_id < lowest)) {
+						cache = entry;
 						lowest = cache->chunk_id;
 					}
 				}
@@ -1448,8 +1521,7 @@ static void yaffs_flush_file_cache(struct yaffs_obj *obj)
 						      cache->chunk_id,
 						      cache->data,
 						      cache->n_bytes, 1);
-				cache->dirty = 0;
-				cache->object = NULL;
+				yaffs_cache_release(dev, cache);
 			}
 
 		} while (cache && chunk_written > 0);
@@ -1470,42 +1542,33 @@ static void yaffs_flush_file_cache(struct yaffs_obj *obj)
 
 void yaffs_flush_whole_cache(struct yaffs_dev *dev)
 {
-	struct yaffs_obj *obj;
-	int n_caches = dev->param.n_caches;
-	int i;
+	struct yaffs_cache *cache;
+	int n_dirty;
 
-	/* Find a dirty object in the cache and flush it...
-	 * until there are no further dirty objects.
+	/* Flush the object of the oldest dirty entry...
+	 * until there are no further dirty objects, or a flush makes no
+	 * progress (locked entry or no space).
 	 */
-	do {
-		obj = NULL;
-		for (i = 0; i < n_caches && !obj; i++) {
-			if (dev->cache[i].object && dev->cache[i].dirty)
-				obj = dev->cache[i].object;
-
-		}
-		if (obj)
-			yaffs_flush_file_cache(obj);
-
-	} while (obj);
-
+	while (dev->n_dirty_caches > 0) {
+		cache = list_entry(dev->cache_dirty.next, struct yaffs_cache,
+				   dirty_list);
+		n_dirty = dev->n_dirty_caches;
+		yaffs_flush_file_cache(cache->object);
+		if (dev->n_dirty_caches >= n_dirty)
+			break;
+	}
 }
 
 /* Grab us a cache chunk for use.
  * First look for an empty one.
- * Then look for the least recently used non-dirty one.
- * Then look for the least recently used dirty one...., flush and look again.
+ * Then take the least recently used one, flushing its object first if
+ * it is dirty, and look again.
  */
 static struct yaffs_cache *yaffs_grab_chunk_worker(struct yaffs_dev *dev)
 {
-	int i;
-
-	if (dev->param.n_caches > 0) {
-		for (i = 0; i < dev->param.n_caches; i++) {
-			if (!dev->cache[i].object)
-				return &dev->cache[i];
-		}
-	}
+	if (dev->param.n_caches > 0 && !list_empty(&dev->cache_free))
+		return list_entry(dev->cache_free.next, struct yaffs_cache,
+				  lru);
 
 	return NULL;
 }
@@ -1513,48 +1576,36 @@ static struct yaffs_cache *yaffs_grab_chunk_worker(struct yaffs_dev *dev)
 static struct yaffs_cache *yaffs_grab_chunk_cache(struct yaffs_dev *dev)
 {
 	struct yaffs_cache *cache;
-	struct yaffs_obj *the_obj;
-	int usage;
-	int i;
-	int pushout;
+	struct yaffs_cache *lru;
 
 	if (dev->param.n_caches > 0) {
-		/* Try find a non-dirty one... */
+		/* Try find a free one... */
 
 		cache = yaffs_grab_chunk_worker(dev);
 
 		if (!cache) {
-			/* They were all dirty, find the last recently used object and flush
-			 * its cache, then  find again.
-			 * NB what's here is not very accurate, we actually flush the object
-			 * the last recently used page.
-			 */
-
-			/* With locking we can't assume we can use entry zero */
-
-			the_obj = NULL;
-			usage = -1;
-			cache = NULL;
-			pushout = -1;
-
-			for (i = 0; i < dev->param.n_caches; i++) {
-				if (dev->cache[i].object &&
-				    !dev->cache[i].locked &&
-				    (dev->cache[i].last_use < usage
-				     || !cache)) {
-					usage = dev->cache[i].last_use;
-					the_obj = dev->cache[i].object;
-					cache = &dev->cache[i];
-					pushout = i;
+			/* With locking we can't assume we can use the tail */
+			list_for_each_entry_reverse(lru, &dev->cache_lru, lru) {
+				if (!lru->locked) {
+					cache = lru;
+					break;
 				}
 			}
 
-			if (!cache || cache->dirty) {
-				/* Flush and try again */
-				yaffs_flush_file_cache(the_obj);
-				cache = yaffs_grab_chunk_worker(dev);
-			}
+			if (!cache)
+				return NULL;
 
+			if (cache->dirty) {
+				/* Flush and try again.
+				 * NB this flushes everything the object has
+				 * cached, not just the least recently used
+				 * page.
+				 */
+				yaffs_flush_file_cache(cache->object);
+			} else {
+				yaffs_cache_release(dev, cache);
+			}
+			cache = yaffs_grab_chunk_worker(dev);
 		}
 		return cache;
 	} else {
@@ -1567,16 +1618,15 @@ static struct yaffs_cache *yaffs_find_chunk_cache(const struct yaffs_obj *obj,
 						  int chunk_id)
 {
 	struct yaffs_dev *dev = obj->my_dev;
-	int i;
-	if (dev->param.n_caches > 0) {
-		for (i = 0; i < dev->param.n_caches; i++) {
-			if (dev->cache[i].object == obj &&
-			    dev->cache[i].chunk_id == chunk_id) {
-				dev->cache_hits++;
+	struct yaffs_cache *cache;
 
-				return &dev->cache[i];
-			}
+	if (dev->param.n_caches > 0) {
+		cache = yaffs_cache_lookup(obj, chunk_id);
+		if (cache) {
+			dev->cache_hits++;
+			return cache;
 		}
+		dev->cache_misses++;
 	}
 	return NULL;
 }
@@ -1587,21 +1637,10 @@ static void yaffs_use_cache(struct yaffs_dev *dev, struct yaffs_cache *cache,
 {
 
 	if (dev->param.n_caches > 0) {
-		if (dev->cache_last_use < 0 || dev->cache_last_use > 100000000) {
-			/* Reset the cache usages */
-			int i;
-			for (i = 1; i < dev->param.n_caches; i++)
-				dev->cache[i].last_use = 0;
-
-			dev->cache_last_use = 0;
-		}
-
-		dev->cache_last_use++;
-
-		cache->last_use = dev->cache_last_use;
+		list_move(&cache->lru, &dev->cache_lru);
 
 		if (is_write)
-			cache->dirty = 1;
+			yaffs_cache_set_dirty(dev, cache);
 	}
 }
 
@@ -1613,10 +1652,10 @@ static void yaffs_invalidate_chunk_cache(struct yaffs_obj *object, int chunk_id)
 {
 	if (object->my_dev->param.n_caches > 0) {
 		struct yaffs_cache *cache =
-		    yaffs_find_chunk_cache(object, chunk_id);
+		    yaffs_cache_lookup(object, chunk_id);
 
 		if (cache)
-			cache->object = NULL;
+			yaffs_cache_release(object->my_dev, cache);
 	}
 }
 
@@ -1625,16 +1664,12 @@ static void yaffs_invalidate_chunk_cache(struct yaffs_obj *object, int chunk_id)
  */
 static void yaffs_invalidate_whole_cache(struct yaffs_obj *in)
 {
-	int i;
 	struct yaffs_dev *dev = in->my_dev;
+	struct yaffs_cache *cache;
+	struct yaffs_cache *tmp;
 
-	if (dev->param.n_caches > 0) {
-		/* Invalidate it. */
-		for (i = 0; i < dev->param.n_caches; i++) {
-			if (dev->cache[i].object == in)
-				dev->cache[i].object = NULL;
-		}
-	}
+	list_for_each_entry_safe(cache, tmp, &in->cache_list, obj_list)
+		yaffs_cache_release(dev, cache);
 }
 
 static void yaffs_unhash_obj(struct yaffs_obj *obj)
@@ -1857,6 +1892,7 @@ static struct yaffs_obj *yaffs_alloc_empty_obj(struct yaffs_dev *dev)
 		INIT_LIST_HEAD(&(obj->hard_links));
 		INIT_LIST_HEAD(&(obj->hash_link));
 		INIT_LIST_HEAD(&obj->siblings);
+		INIT_LIST_HEAD(&obj->cache_list);
 
 		/* Now make the directory sane */
 		if (dev->root_dir) {
@@ -2378,6 +2414,8 @@ void yaffs_block_became_dirty(struct yaffs_dev *dev, int block_no)
 
 	yaffs2_clear_oldest_dirty_seq(dev, bi);
 
+	yaffs_summary_gc(dev, block_no);
+
 	bi->block_state = YAFFS_BLOCK_STATE_DIRTY;
 
 	/* If this is the block being garbage collected then stop gc'ing this block */
@@ -2422,6 +2460,7 @@ void yaffs_block_became_dirty(struct yaffs_dev *dev, int block_no)
 		bi->pages_in_use = 0;
 		bi->soft_del_pages = 0;
 		bi->has_shrink_hdr = 0;
+		bi->has_summary = 0;
 		bi->skip_erased_check = 1;	/* Clean, so no need to check */
 		bi->gc_prioritise = 0;
 		yaffs_clear_chunk_bits(dev, block_no);
@@ -2475,6 +2514,9 @@ static int yaffs_gc_block(struct yaffs_dev *dev, int block, int whole_block)
 
 	dev->gc_disable = 1;
 
+	/* Summary chunks are not copied, just dropped */
+	yaffs_summary_gc(dev, block);
+
 	if (is_checkpt_block || !yaffs_still_some_chunks(dev, block)) {
 		yaffs_trace(YAFFS_TRACE_TRACING,
 			"Collecting block %d that has no chunks in use",
@@ -2856,6 +2898,8 @@ static unsigned yaffs_find_gc_block(struct yaffs_dev *dev,
 		dev->n_gc_blocks++;
 		if (background)
 			dev->bg_gcs++;
+		else
+			dev->fg_gcs++;
 
 		dev->gc_dirtiest = 0;
 		dev->gc_pages_in_use = 0;
@@ -2891,8 +2935,12 @@ static int yaffs_check_gc(struct yaffs_dev *dev, int background)
 	int min_erased;
 	int erased_chunks;
 	int checkpt_block_adjust;
+	unsigned gc_control = 1;
 
-	if (dev->param.gc_control && (dev->param.gc_control(dev) & 1) == 0)
+	if (dev->param.gc_control)
+		gc_control = dev->param.gc_control(dev);
+
+	if ((gc_control & 1) == 0)
 		return YAFFS_OK;
 
 	if (dev->gc_disable) {
@@ -2922,6 +2970,10 @@ static int yaffs_check_gc(struct yaffs_dev *dev, int background)
 			    && erased_chunks > (dev->n_free_chunks / 4))
 				break;
 
+			/* Leave passive gc to the background thread */
+			if (!background && (gc_control & 2))
+				break;
+
 			if (dev->gc_skip > 20)
 				dev->gc_skip = 20;
 			if (erased_chunks < dev->n_free_chunks / 2 ||
@@ -3062,6 +3114,10 @@ void yaffs_chunk_del(struct yaffs_dev *dev, int chunk_id, int mark_flash,
 
 		bi->pages_in_use--;
 
+		if (bi->block_state != YAFFS_BLOCK_STATE_ALLOCATING &&
+		    bi->block_state != YAFFS_BLOCK_STATE_NEEDS_SCANNING)
+			yaffs_summary_check_unused(dev, block);
+
 		if (bi->pages_in_use == 0 &&
 		    !bi->has_shrink_hdr &&
 		    bi->block_state != YAFFS_BLOCK_STATE_ALLOCATING &&
@@ -3581,10 +3637,8 @@ int yaffs_file_rd(struct yaffs_obj *in, u8 * buffer, loff_t offset, int n_bytes)
 				if (!cache) {
 					cache =
 					    yaffs_grab_chunk_cache(in->my_dev);
-					cache->object = in;
-					cache->chunk_id = chunk;
-					cache->dirty = 0;
-					cache->locked = 0;
+					yaffs_cache_assign(dev, cache, in,
+							   chunk);
 					yaffs_rd_data_obj(in, chunk,
 							  cache->data);
 					cache->n_bytes = 0;
@@ -3707,10 +3761,8 @@ int yaffs_do_file_wr(struct yaffs_obj *in, const u8 * buffer, loff_t offset,
 				if (!cache
 				    && yaffs_check_alloc_available(dev, 1)) {
 					cache = yaffs_grab_chunk_cache(dev);
-					cache->object = in;
-					cache->chunk_id = chunk;
-					cache->dirty = 0;
-					cache->locked = 0;
+					yaffs_cache_assign(dev, cache, in,
+							   chunk);
 					yaffs_rd_data_obj(in, chunk,
 							  cache->data);
 				} else if (cache &&
@@ -3740,7 +3792,7 @@ int yaffs_do_file_wr(struct yaffs_obj *in, const u8 * buffer, loff_t offset,
 						     cache->chunk_id,
 						     cache->data,
 						     cache->n_bytes, 1);
-						cache->dirty = 0;
+						yaffs_cache_clean(dev, cache);
 					}
 
 				} else {
@@ -4916,6 +4968,7 @@ int yaffs_guts_initialise(struct yaffs_dev *dev)
 	dev->passive_gc_count = 0;
 	dev->oldest_dirty_gc_count = 0;
 	dev->bg_gcs = 0;
+	dev->fg_gcs = 0;
 	dev->gc_block_finder = 0;
 	dev->buffered_block = -1;
 	dev->doing_buffered_block_rewrite = 0;
@@ -4939,38 +4992,59 @@ int yaffs_guts_initialise(struct yaffs_dev *dev)
 		init_failed = 1;
 
 	dev->cache = NULL;
+	dev->cache_hash = NULL;
 	dev->gc_cleanup_list = NULL;
+	dev->sum_tags = NULL;
 
 	if (!init_failed && dev->param.n_caches > 0) {
 		int i;
 		void *buf;
-		int cache_bytes =
-		    dev->param.n_caches * sizeof(struct yaffs_cache);
+		int cache_bytes;
+		int n_buckets = 1;
 
 		if (dev->param.n_caches > YAFFS_MAX_SHORT_OP_CACHES)
 			dev->param.n_caches = YAFFS_MAX_SHORT_OP_CACHES;
 
+		cache_bytes = dev->param.n_caches * sizeof(struct yaffs_cache);
+
+		while (n_buckets < dev->param.n_caches)
+			n_buckets <<= 1;
+
+		INIT_LIST_HEAD(&dev->cache_lru);
+		INIT_LIST_HEAD(&dev->cache_free);
+		INIT_LIST_HEAD(&dev->cache_dirty);
+		dev->n_dirty_caches = 0;
+		dev->cache_hash_mask = n_buckets - 1;
+		dev->cache_hash =
+		    kmalloc(n_buckets * sizeof(struct list_head), GFP_NOFS);
 		dev->cache = kmalloc(cache_bytes, GFP_NOFS);
 
 		buf = (u8 *) dev->cache;
+		if (!dev->cache_hash)
+			buf = NULL;
 
 		if (dev->cache)
 			memset(dev->cache, 0, cache_bytes);
 
+		for (i = 0; i < n_buckets && buf; i++)
+			INIT_LIST_HEAD(&dev->cache_hash[i]);
+
 		for (i = 0; i < dev->param.n_caches && buf; i++) {
 			dev->cache[i].object = NULL;
-			dev->cache[i].last_use = 0;
 			dev->cache[i].dirty = 0;
+			INIT_LIST_HEAD(&dev->cache[i].hash_list);
+			INIT_LIST_HEAD(&dev->cache[i].obj_list);
+			INIT_LIST_HEAD(&dev->cache[i].dirty_list);
+			list_add_tail(&dev->cache[i].lru, &dev->cache_free);
 			dev->cache[i].data = buf =
 			    kmalloc(dev->param.total_bytes_per_chunk, GFP_NOFS);
 		}
 		if (!buf)
 			init_failed = 1;
-
-		dev->cache_last_use = 0;
 	}
 
 	dev->cache_hits = 0;
+	dev->cache_misses = 0;
 
 	if (!init_failed) {
 		dev->gc_cleanup_list =
@@ -4980,6 +5054,9 @@ int yaffs_guts_initialise(struct yaffs_dev *dev)
 			init_failed = 1;
 	}
 
+	if (!init_failed && !yaffs_summary_init(dev))
+		init_failed = 1;
+
 	if (dev->param.is_yaffs2)
 		dev->param.use_header_file_size = 1;
 
@@ -5087,8 +5164,11 @@ void yaffs_deinitialise(struct yaffs_dev *dev)
 			kfree(dev->cache);
 			dev->cache = NULL;
 		}
+		kfree(dev->cache_hash);
+		dev->cache_hash = NULL;
 
 		kfree(dev->gc_cleanup_list);
+		yaffs_summary_deinit(dev);
 
 		for (i = 0; i < YAFFS_N_TEMP_BUFFERS; i++)
 			kfree(dev->temp_buffer[i].buffer);
@@ -5132,21 +5212,13 @@ int yaffs_get_n_free_chunks(struct yaffs_dev *dev)
 	/* This is what we report to the outside world */
 
 	int n_free;
-	int n_dirty_caches;
 	int blocks_for_checkpt;
-	int i;
 
 	n_free = dev->n_free_chunks;
 	n_free += dev->n_deleted_files;
 
-	/* Now count the number of dirty chunks in the cache and subtract those */
-
-	for (n_dirty_caches = 0, i = 0; i < dev->param.n_caches; i++) {
-		if (dev->cache[i].dirty)
-			n_dirty_caches++;
-	}
-
-	n_free -= n_dirty_caches;
+	/* Now subtract the number of dirty chunks in the cache */
+	n_free -= dev->n_dirty_caches;
 
 	n_free -=
 	    ((dev->param.n_reserved_blocks + 1) * dev->param.chunks_per_block);
@@ -83,7 +83,10 @@
 #define YAFFS_OBJECTID_CHECKPOINT_DATA	0x20
 #define YAFFS_SEQUENCE_CHECKPOINT_DATA  0x21
 
-#define YAFFS_MAX_SHORT_OP_CACHES	20
+/* Pseudo object id for block summaries */
+#define YAFFS_OBJECTID_SUMMARY		0x30
+
+#define YAFFS_MAX_SHORT_OP_CACHES	512
 
 #define YAFFS_N_TEMP_BUFFERS		6
 
@@ -108,9 +111,12 @@
 
 /* ChunkCache is used for short read/write operations.*/
 struct yaffs_cache {
+	struct list_head hash_list;	/* Hash chain, empty when free */
+	struct list_head lru;	/* LRU list, or free list when free */
+	struct list_head obj_list;	/* Entries of the same object */
+	struct list_head dirty_list;	/* On the device dirty list if dirty */
 	struct yaffs_obj *object;
 	int chunk_id;
-	int last_use;
 	int dirty;
 	int n_bytes;		/* Only valid if the cache is dirty */
 	int locked;		/* Can't push out or flush while locked. */
@@ -281,6 +287,7 @@ struct yaffs_block_info {
 
 #ifdef CONFIG_YAFFS_YAFFS2
 	u32 has_shrink_hdr:1;	/* This block has at least one shrink object header */
+	u32 has_summary:1;	/* Summary chunks of this block are in use */
 	u32 seq_number;		/* block sequence number for yaffs2 */
 #endif
 
@@ -413,6 +420,10 @@ struct yaffs_obj {
 	struct yaffs_obj *parent;
 	struct list_head siblings;
 
+	/* Short op cache entries of this object, and how many are dirty */
+	struct list_head cache_list;
+	int n_dirty_caches;
+
 	/* Where's my object header in NAND? */
 	int hdr_chunk;
 
@@ -506,8 +517,9 @@ struct yaffs_param {
 	/* reserved blocks on NOR and RAM. */
 
 	int n_caches;		/* If <= 0, then short op caching is disabled, else
-				 * the number of short op caches (don't use too many).
-				 * 10 to 20 is a good bet.
+				 * the number of short op caches. Lookup is
+				 * hashed, so this is bounded only by the memory
+				 * for one chunk per cache.
 				 */
 	int use_nand_ecc;	/* Flag to decide whether or not to use NANDECC on data (yaffs1) */
 	int no_tags_ecc;	/* Flag to decide whether or not to do ECC on packed tags (yaffs2) */
@@ -559,7 +571,11 @@ struct yaffs_param {
 	/* Callback to mark the superblock dirty */
 	void (*sb_dirty_fn) (struct yaffs_dev * dev);
 
-	/*  Callback to control garbage collection. */
+	/*  Callback to control garbage collection.
+	 *  Bit 0: gc enabled.
+	 *  Bit 1: a background thread does passive gc, so the write path
+	 *         only needs to gc when erased blocks run low.
+	 */
 	unsigned (*gc_control) (struct yaffs_dev * dev);
 
 	/* Debug control flags. Don't use unless you know what you're doing */
@@ -574,6 +590,8 @@ struct yaffs_param {
 	int auto_unicode;
 #endif
 	int always_check_erased;	/* Force chunk erased check always on */
+
+	int disable_summary;	/* yaffs2 only: don't write block summaries */
 };
 
 struct yaffs_dev {
@@ -646,6 +664,11 @@ struct yaffs_dev {
 	u32 alloc_page;
 	int alloc_block_finder;	/* Used to search for next allocation block */
 
+	/* Block summaries */
+	int chunks_per_summary;	/* Chunks in a block before the summary */
+	struct yaffs_summary_tags *sum_tags;
+	int sum_block;		/* Block that sum_tags is collecting for */
+
 	/* Object and Tnode memory management */
 	void *allocator;
 	int n_obj;
@@ -685,7 +708,12 @@ struct yaffs_dev {
 	int doing_buffered_block_rewrite;
 
 	struct yaffs_cache *cache;
-	int cache_last_use;
+	struct list_head *cache_hash;	/* Buckets hashed on obj_id, chunk_id */
+	u32 cache_hash_mask;
+	struct list_head cache_lru;	/* Most recently used first */
+	struct list_head cache_free;
+	struct list_head cache_dirty;	/* Oldest dirtied first */
+	int n_dirty_caches;
 
 	/* Stuff for background deletion and unlinked files. */
 	struct yaffs_obj *unlinked_dir;	/* Directory where unlinked and deleted files live. */
@@ -724,6 +752,7 @@ struct yaffs_dev {
 	u32 oldest_dirty_gc_count;
 	u32 n_gc_blocks;
 	u32 bg_gcs;
+	u32 fg_gcs;
 	u32 n_retired_writes;
 	u32 n_retired_blocks;
 	u32 n_ecc_fixed;
@@ -734,6 +763,7 @@ struct yaffs_dev {
 	u32 n_unmarked_deletions;
 	u32 refresh_count;
 	u32 cache_hits;
+	u32 cache_misses;
 
 };
 
@@ -24,6 +24,7 @@ struct yaffs_linux_context {
 	struct super_block *super;
 	struct task_struct *bg_thread;	/* Background thread for this device */
 	int bg_running;
+	unsigned long fg_activity;	/* jiffies of last foreground lock */
 	struct mutex gross_lock;	/* Gross locking mutex*/
 	u8 *spare_buffer;	/* For mtdif2 use. Don't know the size of the buffer
 				 * at compile time so we have to allocate it.
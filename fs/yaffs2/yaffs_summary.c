@@ -0,0 +1,359 @@
+/*
+ * YAFFS: Yet Another Flash File System. A NAND-flash specific file system.
+ *
+ * Copyright (C) 2002-2010 Aleph One Ltd.
+ *   for Toby Churchill Ltd and Brightstar Engineering
+ *
+ * Created by Charles Manning <charles@aleph1.co.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+/*
+ * Block summaries
+ *
+ * When a block has been filled, the tags of its chunks are written to the
+ * last chunk (or chunks) of the block.  A backwards scan can then read one
+ * chunk per block instead of the tags of every chunk.
+ *
+ * Summary chunks are in use like any other written chunk: they have a
+ * chunk bit and are counted in pages_in_use, and not in n_free_chunks.
+ * They are released, without being copied, when garbage collection starts
+ * on the block or when nothing else in the block is in use any more, so
+ * that the block can be erased.
+ *
+ * Entries for chunks written before the summary buffer was set up for the
+ * block (eg. after a checkpointed mount) are left zero, and the scan reads
+ * the tags of those chunks from NAND.
+ */
+
+#include "yaffs_summary.h"
+#include "yaffs_packedtags2.h"
+#include "yaffs_tagsvalidity.h"
+#include "yaffs_nand.h"
+#include "yaffs_getblockinfo.h"
+#include "yaffs_bitmap.h"
+#include "yaffs_trace.h"
+
+#define YAFFS_SUMMARY_VERSION	1
+
+/* On NAND summary structures */
+struct yaffs_summary_header {
+	unsigned version;
+	unsigned block;
+	unsigned seq;
+	unsigned sum;
+};
+
+struct yaffs_summary_tags {
+	unsigned obj_id;
+	unsigned chunk_id;
+	unsigned n_bytes;
+};
+
+static void yaffs_summary_clear(struct yaffs_dev *dev, int blk)
+{
+	memset(dev->sum_tags, 0,
+	       dev->chunks_per_summary * sizeof(struct yaffs_summary_tags));
+	dev->sum_block = blk;
+}
+
+static unsigned yaffs_summary_sum(struct yaffs_dev *dev)
+{
+	u8 *sum_buffer = (u8 *) dev->sum_tags;
+	int i;
+	unsigned sum = 0;
+
+	i = sizeof(struct yaffs_summary_tags) * dev->chunks_per_summary;
+	while (i > 0) {
+		sum += *sum_buffer;
+		sum_buffer++;
+		i--;
+	}
+
+	return sum;
+}
+
+int yaffs_summary_init(struct yaffs_dev *dev)
+{
+	int sum_bytes;
+	int chunks_used;
+
+	dev->chunks_per_summary = dev->param.chunks_per_block;
+	dev->sum_block = -1;
+
+	if (!dev->param.is_yaffs2 || dev->param.disable_summary)
+		return YAFFS_OK;
+
+	sum_bytes = dev->param.chunks_per_block *
+	    sizeof(struct yaffs_summary_tags);
+	chunks_used = (sum_bytes + dev->data_bytes_per_chunk -
+		       sizeof(struct yaffs_summary_header) - 1) /
+	    (dev->data_bytes_per_chunk - sizeof(struct yaffs_summary_header));
+
+	/* Not worth it if the summary would take a large part of a block */
+	if (chunks_used * 4 > dev->param.chunks_per_block)
+		return YAFFS_OK;
+
+	dev->sum_tags = kmalloc(sum_bytes, GFP_NOFS);
+	if (!dev->sum_tags)
+		return YAFFS_FAIL;
+
+	dev->chunks_per_summary = dev->param.chunks_per_block - chunks_used;
+	yaffs_summary_clear(dev, -1);
+
+	return YAFFS_OK;
+}
+
+void yaffs_summary_deinit(struct yaffs_dev *dev)
+{
+	kfree(dev->sum_tags);
+	dev->sum_tags = NULL;
+	dev->chunks_per_summary = dev->param.chunks_per_block;
+}
+
+/* Account a summary chunk, written or found by the scan, as in use. */
+static void yaffs_summary_use(struct yaffs_dev *dev,
+			      struct yaffs_block_info *bi, int blk,
+			      int chunk_in_block)
+{
+	yaffs_set_chunk_bit(dev, blk, chunk_in_block);
+	bi->pages_in_use++;
+	bi->has_summary = 1;
+}
+
+static void yaffs_summary_write(struct yaffs_dev *dev, int blk)
+{
+	struct yaffs_block_info *bi = yaffs_get_block_info(dev, blk);
+	struct yaffs_ext_tags tags;
+	struct yaffs_summary_header hdr;
+	u8 *buffer;
+	u8 *sum_buffer = (u8 *) dev->sum_tags;
+	int sum_bytes_per_chunk =
+	    dev->data_bytes_per_chunk - sizeof(struct yaffs_summary_header);
+	int n_bytes;
+	int this_tx;
+	int chunk_in_nand;
+	int result = YAFFS_OK;
+
+	hdr.version = YAFFS_SUMMARY_VERSION;
+	hdr.block = blk;
+	hdr.seq = bi->seq_number;
+	hdr.sum = yaffs_summary_sum(dev);
+
+	yaffs_init_tags(&tags);
+	tags.obj_id = YAFFS_OBJECTID_SUMMARY;
+	tags.chunk_id = 1;
+
+	n_bytes = sizeof(struct yaffs_summary_tags) * dev->chunks_per_summary;
+	chunk_in_nand = blk * dev->param.chunks_per_block +
+	    dev->chunks_per_summary;
+
+	buffer = yaffs_get_temp_buffer(dev, __LINE__);
+
+	while (result == YAFFS_OK && n_bytes > 0) {
+		this_tx = min(n_bytes, sum_bytes_per_chunk);
+		memset(buffer, 0xff, dev->data_bytes_per_chunk);
+		memcpy(buffer, &hdr, sizeof(hdr));
+		memcpy(buffer + sizeof(hdr), sum_buffer, this_tx);
+		tags.n_bytes = this_tx + sizeof(hdr);
+
+		result = yaffs_wr_chunk_tags_nand(dev, chunk_in_nand,
+						  buffer, &tags);
+		if (result == YAFFS_OK) {
+			yaffs_summary_use(dev, bi, blk,
+				chunk_in_nand % dev->param.chunks_per_block);
+			dev->n_free_chunks--;
+		}
+
+		n_bytes -= this_tx;
+		sum_buffer += this_tx;
+		chunk_in_nand++;
+		tags.chunk_id++;
+	}
+
+	yaffs_release_temp_buffer(dev, buffer, __LINE__);
+
+	if (result != YAFFS_OK)
+		yaffs_trace(YAFFS_TRACE_ERROR,
+			"Failed to write summary for block %d", blk);
+}
+
+/*
+ * Record the tags of a newly written chunk.  Once the last chunk before
+ * the summary area has been written, write out the summary.
+ */
+void yaffs_summary_add(struct yaffs_dev *dev, struct yaffs_ext_tags *tags,
+		       int chunk_in_nand)
+{
+	struct yaffs_packed_tags2_tags_only tags_only;
+	struct yaffs_summary_tags *sum_tags;
+	int blk = chunk_in_nand / dev->param.chunks_per_block;
+	int chunk_in_block = chunk_in_nand % dev->param.chunks_per_block;
+
+	if (!dev->sum_tags || chunk_in_block >= dev->chunks_per_summary)
+		return;
+
+	if (blk != dev->sum_block)
+		yaffs_summary_clear(dev, blk);
+
+	yaffs_pack_tags2_tags_only(&tags_only, tags);
+	sum_tags = &dev->sum_tags[chunk_in_block];
+	sum_tags->obj_id = tags_only.obj_id;
+	sum_tags->chunk_id = tags_only.chunk_id;
+	sum_tags->n_bytes = tags_only.n_bytes;
+
+	if (chunk_in_block == dev->chunks_per_summary - 1) {
+		yaffs_summary_write(dev, blk);
+		dev->sum_block = -1;
+	}
+}
+
+/*
+ * Read the summary of a block into the summary buffer.  Returns 1 if the
+ * block has a valid summary, 0 if its chunk tags have to be scanned.
+ */
+int yaffs_summary_read(struct yaffs_dev *dev, int blk)
+{
+	struct yaffs_block_info *bi = yaffs_get_block_info(dev, blk);
+	struct yaffs_ext_tags tags;
+	struct yaffs_summary_header hdr;
+	u8 *buffer;
+	u8 *sum_buffer = (u8 *) dev->sum_tags;
+	int sum_bytes_per_chunk =
+	    dev->data_bytes_per_chunk - sizeof(struct yaffs_summary_header);
+	int n_bytes;
+	int this_tx;
+	int chunk_id = 1;
+	int chunk_in_nand;
+	int ok = 1;
+
+	if (!dev->sum_tags)
+		return 0;
+
+	memset(&hdr, 0, sizeof(hdr));
+
+	/* The summary buffer is about to be overwritten */
+	dev->sum_block = -1;
+
+	n_bytes = sizeof(struct yaffs_summary_tags) * dev->chunks_per_summary;
+	chunk_in_nand = blk * dev->param.chunks_per_block +
+	    dev->chunks_per_summary;
+
+	buffer = yaffs_get_temp_buffer(dev, __LINE__);
+
+	while (ok && n_bytes > 0) {
+		this_tx = min(n_bytes, sum_bytes_per_chunk);
+
+		yaffs_rd_chunk_tags_nand(dev, chunk_in_nand, buffer, &tags);
+		memcpy(&hdr, buffer, sizeof(hdr));
+
+		ok = tags.chunk_used &&
+		    tags.ecc_result <= YAFFS_ECC_RESULT_FIXED &&
+		    tags.obj_id == YAFFS_OBJECTID_SUMMARY &&
+		    tags.chunk_id == chunk_id &&
+		    tags.n_bytes == this_tx + sizeof(hdr) &&
+		    tags.seq_number == bi->seq_number &&
+		    hdr.version == YAFFS_SUMMARY_VERSION &&
+		    hdr.block == blk && hdr.seq == bi->seq_number;
+
+		if (ok)
+			memcpy(sum_buffer, buffer + sizeof(hdr), this_tx);
+
+		n_bytes -= this_tx;
+		sum_buffer += this_tx;
+		chunk_in_nand++;
+		chunk_id++;
+	}
+
+	yaffs_release_temp_buffer(dev, buffer, __LINE__);
+
+	if (ok && hdr.sum != yaffs_summary_sum(dev))
+		ok = 0;
+
+	if (ok)
+		for (chunk_id = dev->chunks_per_summary;
+		     chunk_id < dev->param.chunks_per_block; chunk_id++)
+			yaffs_summary_use(dev, bi, blk, chunk_id);
+	else
+		yaffs_trace(YAFFS_TRACE_SCAN,
+			"Block %d has no valid summary", blk);
+
+	return ok;
+}
+
+/* The scan found a summary chunk of a block whose summary was not used. */
+void yaffs_summary_scanned(struct yaffs_dev *dev, int blk, int chunk_in_block)
+{
+	yaffs_summary_use(dev, yaffs_get_block_info(dev, blk), blk,
+			  chunk_in_block);
+}
+
+static int yaffs_summary_in_use(struct yaffs_dev *dev, int blk)
+{
+	int i;
+	int n = 0;
+
+	for (i = dev->chunks_per_summary; i < dev->param.chunks_per_block; i++)
+		if (yaffs_check_chunk_bit(dev, blk, i))
+			n++;
+	return n;
+}
+
+/* Release the summary chunks of a block that is being collected. */
+void yaffs_summary_gc(struct yaffs_dev *dev, int blk)
+{
+	struct yaffs_block_info *bi = yaffs_get_block_info(dev, blk);
+	int i;
+
+	if (!bi->has_summary)
+		return;
+
+	for (i = dev->chunks_per_summary;
+	     i < dev->param.chunks_per_block; i++) {
+		if (yaffs_check_chunk_bit(dev, blk, i)) {
+			yaffs_clear_chunk_bit(dev, blk, i);
+			bi->pages_in_use--;
+			dev->n_free_chunks++;
+		}
+	}
+	bi->has_summary = 0;
+}
+
+/*
+ * Release the summary chunks of a block once they are the only chunks in
+ * use, so that the block becomes dirty as it would without a summary.
+ */
+void yaffs_summary_check_unused(struct yaffs_dev *dev, int blk)
+{
+	struct yaffs_block_info *bi = yaffs_get_block_info(dev, blk);
+
+	if (bi->has_summary &&
+	    bi->pages_in_use == yaffs_summary_in_use(dev, blk))
+		yaffs_summary_gc(dev, blk);
+}
+
+/*
+ * Get the tags of a chunk from the summary that was read by
+ * yaffs_summary_read().  Returns 0 if the summary does not hold them.
+ */
+int yaffs_summary_fetch(struct yaffs_dev *dev, struct yaffs_ext_tags *tags,
+			int blk, int chunk_in_block)
+{
+	struct yaffs_packed_tags2_tags_only tags_only;
+	struct yaffs_summary_tags *sum_tags = &dev->sum_tags[chunk_in_block];
+
+	if (!sum_tags->obj_id)
+		return 0;
+
+	tags_only.seq_number = yaffs_get_block_info(dev, blk)->seq_number;
+	tags_only.obj_id = sum_tags->obj_id;
+	tags_only.chunk_id = sum_tags->chunk_id;
+	tags_only.n_bytes = sum_tags->n_bytes;
+	yaffs_unpack_tags2_tags_only(tags, &tags_only);
+	tags->ecc_result = YAFFS_ECC_RESULT_NO_ERROR;
+
+	return 1;
+}
@@ -97,6 +97,9 @@ unsigned int yaffs_wr_attempts = YAFFS_WR_ATTEMPTS;
 unsigned int yaffs_auto_checkpoint = 1;
 unsigned int yaffs_gc_control = 1;
 unsigned int yaffs_bg_enable = 1;
+unsigned int yaffs_bg_gc_idle_ms = 200;
+unsigned int yaffs_bg_gc_headroom = 50;
+unsigned int yaffs_bg_gc_idle_steps = 32;
 
 /* Module Parameters */
 module_param(yaffs_trace_mask, uint, 0644);
@@ -104,6 +107,9 @@ module_param(yaffs_wr_attempts, uint, 0644);
 module_param(yaffs_auto_checkpoint, uint, 0644);
 module_param(yaffs_gc_control, uint, 0644);
 module_param(yaffs_bg_enable, uint, 0644);
+module_param(yaffs_bg_gc_idle_ms, uint, 0644);
+module_param(yaffs_bg_gc_headroom, uint, 0644);
+module_param(yaffs_bg_gc_idle_steps, uint, 0644);
 
 
 #define yaffs_inode_to_obj_lv(iptr) ((iptr)->i_private)
@@ -118,14 +124,23 @@ module_param(yaffs_bg_enable, uint, 0644);
 
 static unsigned yaffs_gc_control_callback(struct yaffs_dev *dev)
 {
+	struct yaffs_linux_context *context = yaffs_dev_to_lc(dev);
+
+	if ((yaffs_gc_control & 1) && context->bg_running && yaffs_bg_enable)
+		return yaffs_gc_control | 2;
 	return yaffs_gc_control;
 }
 
 static void yaffs_gross_lock(struct yaffs_dev *dev)
 {
+	struct yaffs_linux_context *context = yaffs_dev_to_lc(dev);
+
 	yaffs_trace(YAFFS_TRACE_LOCK, "yaffs locking %p", current);
-	mutex_lock(&(yaffs_dev_to_lc(dev)->gross_lock));
+	mutex_lock(&context->gross_lock);
 	yaffs_trace(YAFFS_TRACE_LOCK, "yaffs locked %p", current);
+
+	if (current != context->bg_thread)
+		context->fg_activity = jiffies;
 }
 
 static void yaffs_gross_unlock(struct yaffs_dev *dev)
@@ -1552,22 +1567,69 @@ static unsigned yaffs_bg_gc_urgency(struct yaffs_dev *dev)
 	    dev->n_erased_blocks * dev->param.chunks_per_block;
 	struct yaffs_linux_context *context = yaffs_dev_to_lc(dev);
 	unsigned scattered = 0;	/* Free chunks not in an erased block */
+	unsigned headroom;	/* Erased chunks we try to keep */
 
 	if (erased_chunks < dev->n_free_chunks)
 		scattered = (dev->n_free_chunks - erased_chunks);
 
+	headroom = dev->n_free_chunks * min(yaffs_bg_gc_headroom, 100U) / 100;
+
 	if (!context->bg_running)
 		return 0;
 	else if (scattered < (dev->param.chunks_per_block * 2))
 		return 0;
-	else if (erased_chunks > dev->n_free_chunks / 2)
+	else if (erased_chunks > headroom)
 		return 0;
-	else if (erased_chunks > dev->n_free_chunks / 4)
+	else if (erased_chunks > headroom / 2)
 		return 1;
 	else
 		return 2;
 }
 
+/*
+ * The device counts as idle once no one but the background thread has
+ * taken the gross lock for yaffs_bg_gc_idle_ms.
+ */
+static unsigned long yaffs_bg_idle_from(struct yaffs_dev *dev)
+{
+	struct yaffs_linux_context *context = yaffs_dev_to_lc(dev);
+
+	return context->fg_activity + msecs_to_jiffies(yaffs_bg_gc_idle_ms);
+}
+
+static int yaffs_bg_idle(struct yaffs_dev *dev, unsigned long now)
+{
+	return time_after_eq(now, yaffs_bg_idle_from(dev));
+}
+
+/*
+ * Idle: collect until the headroom is restored, dropping the lock between
+ * steps so a new request is not held up by more than one of them.  Stop
+ * after a step that freed nothing and left no block part way collected,
+ * or after yaffs_bg_gc_idle_steps steps.  Called with the gross lock held.
+ */
+static void yaffs_bg_gc_idle(struct yaffs_dev *dev, unsigned urgency)
+{
+	struct yaffs_linux_context *context = yaffs_dev_to_lc(dev);
+	unsigned int steps = 0;
+	int n_erased, n_free;
+
+	do {
+		n_erased = dev->n_erased_blocks;
+		n_free = dev->n_free_chunks;
+		yaffs_bg_gc(dev, urgency);
+		yaffs_gross_unlock(dev);
+		cond_resched();
+		yaffs_gross_lock(dev);
+		if (dev->n_erased_blocks <= n_erased &&
+		    dev->n_free_chunks <= n_free && !dev->gc_block)
+			break;
+		urgency = yaffs_bg_gc_urgency(dev);
+	} while (++steps < yaffs_bg_gc_idle_steps && urgency > 0 &&
+		 !dev->is_checkpointed && context->bg_running &&
+		 !kthread_should_stop() && yaffs_bg_idle(dev, jiffies));
+}
+
 static int yaffs_do_sync_fs(struct super_block *sb, int request_checkpoint)
 {
 
@@ -1653,13 +1715,23 @@ static int yaffs_bg_thread_fn(void *data)
 		if (time_after(now, next_gc) && yaffs_bg_enable) {
 			if (!dev->is_checkpointed) {
 				urgency = yaffs_bg_gc_urgency(dev);
-				gc_result = yaffs_bg_gc(dev, urgency);
-				if (urgency > 1)
+				if (urgency > 1) {
+					/* Keep ahead of the writers */
+					gc_result = yaffs_bg_gc(dev, urgency);
 					next_gc = now + HZ / 20 + 1;
-				else if (urgency > 0)
+				} else if (urgency > 0 &&
+					   yaffs_bg_idle(dev, now)) {
+					yaffs_bg_gc_idle(dev, urgency);
+					now = jiffies;
 					next_gc = now + HZ / 10 + 1;
-				else
+				} else if (urgency > 0) {
+					/* Busy: wait for a quiet spell */
+					next_gc = yaffs_bg_idle_from(dev);
+					if (time_before(next_gc, now))
+						next_gc = now + HZ / 10 + 1;
+				} else {
 					next_gc = now + HZ * 2;
+				}
 			} else	{
 			        /*
 				 * gc not running so set to next_dir_update
@@ -1698,6 +1770,7 @@ static int yaffs_bg_start(struct yaffs_dev *dev)
 		return -1;
 
 	context->bg_running = 1;
+	context->fg_activity = jiffies;
 
 	context->bg_thread = kthread_run(yaffs_bg_thread_fn,
 					 (void *)dev, "yaffs-bg-%d",
@@ -1758,12 +1831,15 @@ struct yaffs_options {
 	int skip_checkpoint_read;
 	int skip_checkpoint_write;
 	int no_cache;
+	int cache_size;
 	int tags_ecc_on;
 	int tags_ecc_overridden;
 	int lazy_loading_enabled;
 	int lazy_loading_overridden;
 	int empty_lost_and_found;
 	int empty_lost_and_found_overridden;
+	int summary_enabled;
+	int summary_overridden;
 };
 
 #define MAX_OPT_LEN 30
@@ -1811,8 +1887,26 @@ static int yaffs_parse_options(struct yaffs_options *options,
 		} else if (!strcmp(cur_opt, "empty-lost-and-found-on")) {
 			options->empty_lost_and_found = 1;
 			options->empty_lost_and_found_overridden = 1;
+		} else if (!strcmp(cur_opt, "summary-off")) {
+			options->summary_enabled = 0;
+			options->summary_overridden = 1;
+		} else if (!strcmp(cur_opt, "summary-on")) {
+			options->summary_enabled = 1;
+			options->summary_overridden = 1;
 		} else if (!strcmp(cur_opt, "no-cache")) {
 			options->no_cache = 1;
+		} else if (!strncmp(cur_opt, "cache-size=", 11)) {
+			char *end;
+
+			options->cache_size =
+			    simple_strtoul(cur_opt + 11, &end, 0);
+			if (*end || options->cache_size < 1 ||
+			    options->cache_size > YAFFS_MAX_SHORT_OP_CACHES) {
+				printk(KERN_INFO
+				       "yaffs: Bad cache size \"%s\"\n",
+				       cur_opt);
+				error = 1;
+			}
 		} else if (!strcmp(cur_opt, "no-checkpoint-read")) {
 			options->skip_checkpoint_read = 1;
 		} else if (!strcmp(cur_opt, "no-checkpoint-write")) {
@@ -2215,7 +2309,8 @@ static struct super_block *yaffs_internal_read_super(int yaffs_version,
 	param->chunks_per_block = YAFFS_CHUNKS_PER_BLOCK;
 	param->total_bytes_per_chunk = YAFFS_BYTES_PER_CHUNK;
 	param->n_reserved_blocks = 5;
-	param->n_caches = (options.no_cache) ? 0 : 10;
+	param->n_caches = (options.no_cache) ? 0 :
+	    (options.cache_size) ? options.cache_size : 10;
 	param->inband_tags = options.inband_tags;
 
 #ifdef CONFIG_YAFFS_DISABLE_LAZY_LOAD
@@ -2256,6 +2351,13 @@ static struct super_block *yaffs_internal_read_super(int yaffs_version,
 	if (options.empty_lost_and_found_overridden)
 		param->empty_lost_n_found = options.empty_lost_and_found;
 
+#ifdef CONFIG_YAFFS_DISABLE_SUMMARY
+	param->disable_summary = 1;
+#endif
+
+	if (options.summary_overridden)
+		param->disable_summary = !options.summary_enabled;
+
 	/* ... and the functions. */
 	if (yaffs_version == 2) {
 		param->write_chunk_tags_fn = nandmtd2_write_chunk_tags;
@@ -2442,6 +2544,8 @@ static char *yaffs_dump_dev_part0(char *buf, struct yaffs_dev *dev)
 			param->n_reserved_blocks);
 	buf += sprintf(buf, "always_check_erased... %d\n",
 			param->always_check_erased);
+	buf += sprintf(buf, "disable_summary....... %d\n",
+			param->disable_summary);
 
 	return buf;
 }
@@ -2474,6 +2578,7 @@ static char *yaffs_dump_dev_part1(char *buf, struct yaffs_dev *dev)
 		    dev->oldest_dirty_gc_count);
 	buf += sprintf(buf, "n_gc_blocks........... %u\n", dev->n_gc_blocks);
 	buf += sprintf(buf, "bg_gcs................ %u\n", dev->bg_gcs);
+	buf += sprintf(buf, "fg_gcs................ %u\n", dev->fg_gcs);
 	buf +=
 	    sprintf(buf, "n_retired_writes...... %u\n", dev->n_retired_writes);
 	buf +=
@@ -2486,6 +2591,7 @@ static char *yaffs_dump_dev_part1(char *buf, struct yaffs_dev *dev)
 	    sprintf(buf, "n_tags_ecc_unfixed.... %u\n",
 		    dev->n_tags_ecc_unfixed);
 	buf += sprintf(buf, "cache_hits............ %u\n", dev->cache_hits);
+	buf += sprintf(buf, "cache_misses.......... %u\n", dev->cache_misses);
 	buf +=
 	    sprintf(buf, "n_deleted_files....... %u\n", dev->n_deleted_files);
 	buf +=
@@ -18,6 +18,7 @@
 #include "yaffs_bitmap.h"
 #include "yaffs_nand.h"
 #include "yaffs_getblockinfo.h"
+#include "yaffs_summary.h"
 #include "yaffs_verify.h"
 #include "yaffs_attribs.h"
 
@@ -983,6 +984,8 @@ int yaffs2_scan_backwards(struct yaffs_dev *dev)
 	int found_chunks;
 	int equiv_id;
 	int alloc_failed = 0;
+	int summary_available;
+	int n_summaries = 0;
 
 	struct yaffs_block_index *block_index = NULL;
 	int alt_block_index = 0;
@@ -1102,10 +1105,24 @@ int yaffs2_scan_backwards(struct yaffs_dev *dev)
 
 		deleted = 0;
 
+		/* If the block has a summary, take the tags from it rather
+		 * than reading them chunk by chunk.  The summary chunks
+		 * themselves are marked in use by yaffs_summary_read().
+		 */
+		summary_available = 0;
+		if (state == YAFFS_BLOCK_STATE_NEEDS_SCANNING)
+			summary_available = yaffs_summary_read(dev, blk);
+
+		if (summary_available) {
+			n_summaries++;
+			c = dev->chunks_per_summary - 1;
+		} else {
+			c = dev->param.chunks_per_block - 1;
+		}
+
 		/* For each chunk in each block that needs scanning.... */
 		found_chunks = 0;
-		for (c = dev->param.chunks_per_block - 1;
-		     !alloc_failed && c >= 0 &&
+		for (; !alloc_failed && c >= 0 &&
 		     (state == YAFFS_BLOCK_STATE_NEEDS_SCANNING ||
 		      state == YAFFS_BLOCK_STATE_ALLOCATING); c--) {
 			/* Scan backwards...
@@ -1114,8 +1131,10 @@ int yaffs2_scan_backwards(struct yaffs_dev *dev)
 
 			chunk = blk * dev->param.chunks_per_block + c;
 
-			result = yaffs_rd_chunk_tags_nand(dev, chunk, NULL,
-							  &tags);
+			if (!summary_available ||
+			    !yaffs_summary_fetch(dev, &tags, blk, c))
+				result = yaffs_rd_chunk_tags_nand(dev, chunk,
+								  NULL, &tags);
 
 			/* Let's have a good look at this chunk... */
 
@@ -1176,6 +1195,13 @@ int yaffs2_scan_backwards(struct yaffs_dev *dev)
 
 				dev->n_free_chunks++;
 
+			} else if (tags.obj_id == YAFFS_OBJECTID_SUMMARY &&
+				   tags.seq_number == bi->seq_number) {
+				/* Summary chunk of a block whose summary
+				 * could not be used.
+				 */
+				yaffs_summary_scanned(dev, blk, c);
+
 			} else if (tags.obj_id > YAFFS_MAX_OBJECT_ID ||
 				   tags.chunk_id > YAFFS_MAX_CHUNK_ID ||
 				   (tags.chunk_id > 0
@@ -1565,6 +1591,8 @@ int yaffs2_scan_backwards(struct yaffs_dev *dev)
 		bi->block_state = state;
 
 		/* Now let's see if it was dirty */
+		if (state == YAFFS_BLOCK_STATE_FULL)
+			yaffs_summary_check_unused(dev, blk);
 		if (bi->pages_in_use == 0 &&
 		    !bi->has_shrink_hdr &&
 		    bi->block_state == YAFFS_BLOCK_STATE_FULL) {
@@ -1592,7 +1620,9 @@ int yaffs2_scan_backwards(struct yaffs_dev *dev)
 	if (alloc_failed)
 		return YAFFS_FAIL;
 
-	yaffs_trace(YAFFS_TRACE_SCAN, "yaffs2_scan_backwards ends");
+	yaffs_trace(YAFFS_TRACE_SCAN,
+		"yaffs2_scan_backwards ends, %d of %d blocks had summaries",
+		n_summaries, n_to_scan);
 
 	return YAFFS_OK;
 }
@@ -120,6 +120,10 @@ struct request {
 #ifdef CONFIG_BLK_CGROUP
 	unsigned long long start_time_ns;
 	unsigned long long io_start_time_ns;    /* when passed to hardware */
+#endif
+#ifdef CONFIG_BLK_DEV_PRIO
+	unsigned short prio_weight;	/* 0 if not limited */
+	unsigned int prio_target_us;	/* read latency target */
 #endif
 	/* Number of scatter-gather DMA addr+len pairs after
 	 * physical address coalescing is performed.
@@ -379,6 +383,15 @@ struct request_queue
 	/* Throttle data */
 	struct throtl_data *td;
 #endif
+
+#ifdef CONFIG_BLK_DEV_DISCARD_DEFER
+	/* Deferred discards */
+	struct discard_data *discard_data;
+#endif
+
+#ifdef CONFIG_BLK_DEV_PRIO
+	struct blk_prio_data *prio_data;
+#endif
 };
 
 #define QUEUE_FLAG_QUEUED	1	/* uses generic tag queueing */
@@ -1147,6 +1160,15 @@ static inline int blk_throtl_exit(struct request_queue *q) { return 0; }
 static inline void throtl_shutdown_timer_wq(struct request_queue *q) {}
 #endif /* CONFIG_BLK_DEV_THROTTLING */
 
+#ifdef CONFIG_BLK_DEV_DISCARD_DEFER
+extern void blk_queue_discard_defer(struct request_queue *q, bool enable);
+extern void blk_discard_defer_flush(struct request_queue *q);
+#else /* CONFIG_BLK_DEV_DISCARD_DEFER */
+static inline void blk_queue_discard_defer(struct request_queue *q,
+					   bool enable) {}
+static inline void blk_discard_defer_flush(struct request_queue *q) {}
+#endif /* CONFIG_BLK_DEV_DISCARD_DEFER */
+
 #define MODULE_ALIAS_BLOCKDEV(major,minor) \
 	MODULE_ALIAS("block-major-" __stringify(major) "-" __stringify(minor))
 #define MODULE_ALIAS_BLOCKDEV_MAJOR(major) \
@@ -0,0 +1,79 @@
+/* bulkstat.h - per-process statistics for many processes in one read
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of version 2.1 of the GNU Lesser General Public License
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it would be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef _LINUX_BULKSTAT_H
+#define _LINUX_BULKSTAT_H
+
+#include <linux/types.h>
+
+/*
+ * Reading /proc/bulkstat returns as many whole struct bulkstat_task
+ * records as fit in the buffer, one per process, the same values as
+ * /proc/<pid>/stat and statm report.  The file position is the pid to
+ * continue from, so successive reads walk all processes in pid order
+ * and lseek(fd, 0, SEEK_SET) starts a new sample.
+ *
+ * Writing an array of __s32 pids restricts later reads on that file to
+ * those processes, in the given order, and rewinds; the file position
+ * is then the index in the array.  Writing a single 0 removes the
+ * filter.  Processes that have exited are skipped.
+ *
+ * Newer versions only add fields at the end; bs_size is the size of
+ * the record the kernel returns.
+ */
+
+#define BULKSTAT_MAX_PIDS	4096
+
+struct bulkstat_task {
+	__u32	bs_size;		/* sizeof(struct bulkstat_task) */
+	__s32	bs_pid;			/* thread group id */
+	__s32	bs_ppid;
+	__s32	bs_pgid;
+	__s32	bs_sid;
+	__u32	bs_uid;
+	__u32	bs_euid;
+	__u32	bs_gid;
+	char	bs_comm[16];
+	__u8	bs_state;		/* as the letter in /proc/<pid>/stat */
+	__s8	bs_nice;
+	__u8	bs_policy;
+	__u8	bs_pad;
+	__s32	bs_prio;
+	__u32	bs_rt_priority;
+	__s32	bs_num_threads;
+	__s32	bs_cpu;			/* last ran on */
+	__s32	bs_oom_adj;
+	__s32	bs_oom_score_adj;
+	__u32	bs_flags;		/* PF_* */
+
+	/* times in nanoseconds, for the whole thread group */
+	__u64	bs_utime;
+	__u64	bs_stime;
+	__u64	bs_cutime;		/* waited for children */
+	__u64	bs_cstime;
+	__u64	bs_start_time;		/* since boot */
+
+	__u64	bs_min_flt;
+	__u64	bs_maj_flt;
+	__u64	bs_nvcsw;		/* voluntary context switches */
+	__u64	bs_nivcsw;
+
+	/* memory in pages, as in /proc/<pid>/statm */
+	__u64	bs_vm_size;
+	__u64	bs_vm_rss;
+	__u64	bs_vm_shared;
+	__u64	bs_vm_text;
+	__u64	bs_vm_data;
+	__u64	bs_vm_hwm;		/* peak rss */
+	__u64	bs_vm_swap;
+};
+
+#endif /* _LINUX_BULKSTAT_H */
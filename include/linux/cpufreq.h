@@ -21,6 +21,7 @@
 #include <linux/workqueue.h>
 #include <linux/cpumask.h>
 #include <asm/div64.h>
+#include <asm/cputime.h>
 
 #define CPUFREQ_NAME_LEN 16
 
@@ -340,6 +341,27 @@ static inline unsigned int cpufreq_quick_get(unsigned int cpu)
 #endif
 
 
+/*********************************************************************
+ *                    PER TASK TIME IN STATE                         *
+ *********************************************************************/
+
+struct task_struct;
+
+#ifdef CONFIG_CPU_FREQ_STAT_TASK
+void cpufreq_task_stats_init(struct task_struct *p);
+void cpufreq_task_stats_exit(struct task_struct *p);
+void cpufreq_task_stats_free(struct task_struct *p);
+void cpufreq_task_stats_account(struct task_struct *p, cputime_t cputime);
+int proc_time_in_state_show(struct task_struct *p, char *buf);
+#else
+static inline void cpufreq_task_stats_init(struct task_struct *p) {}
+static inline void cpufreq_task_stats_exit(struct task_struct *p) {}
+static inline void cpufreq_task_stats_free(struct task_struct *p) {}
+static inline void cpufreq_task_stats_account(struct task_struct *p,
+					      cputime_t cputime) {}
+#endif
+
+
 /*********************************************************************
  *                       CPUFREQ DEFAULT GOVERNOR                    *
  *********************************************************************/
@@ -369,6 +391,16 @@ extern struct cpufreq_governor cpufreq_gov_conservative;
 #elif defined(CONFIG_CPU_FREQ_DEFAULT_GOV_INTERACTIVE)
 extern struct cpufreq_governor cpufreq_gov_interactive;
 #define CPUFREQ_DEFAULT_GOVERNOR	(&cpufreq_gov_interactive)
+#elif defined(CONFIG_CPU_FREQ_DEFAULT_GOV_SCHED)
+extern struct cpufreq_governor cpufreq_gov_sched;
+#define CPUFREQ_DEFAULT_GOVERNOR	(&cpufreq_gov_sched)
+#endif
+
+#ifdef CONFIG_CPU_FREQ_GOV_SCHED
+void cpufreq_sched_update(int cpu, unsigned long nr_running, u64 now);
+#else
+static inline void cpufreq_sched_update(int cpu, unsigned long nr_running,
+					u64 now) {}
 #endif
 
 
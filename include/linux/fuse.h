@@ -155,6 +155,8 @@ struct fuse_file_lock {
  *
  * FUSE_EXPORT_SUPPORT: filesystem handles lookups of "." and ".."
  * FUSE_DONT_MASK: don't apply umask to file mode on create operations
+ * FUSE_DO_READDIRPLUS: do READDIRPLUS (READDIR+LOOKUP in one)
+ * FUSE_MAX_PAGES: init_out.max_pages contains the max number of req pages
  */
 #define FUSE_ASYNC_READ		(1 << 0)
 #define FUSE_POSIX_LOCKS	(1 << 1)
@@ -163,6 +165,8 @@ struct fuse_file_lock {
 #define FUSE_EXPORT_SUPPORT	(1 << 4)
 #define FUSE_BIG_WRITES		(1 << 5)
 #define FUSE_DONT_MASK		(1 << 6)
+#define FUSE_DO_READDIRPLUS	(1 << 13)
+#define FUSE_MAX_PAGES		(1 << 22)
 
 /**
  * CUSE INIT request/reply flags
@@ -265,6 +269,7 @@ enum fuse_opcode {
 	FUSE_POLL          = 40,
 	FUSE_NOTIFY_REPLY  = 41,
 	FUSE_BATCH_FORGET  = 42,
+	FUSE_READDIRPLUS   = 44,
 
 	/* CUSE specific operations */
 	CUSE_INIT          = 4096,
@@ -276,7 +281,11 @@ enum fuse_notify_code {
 	FUSE_NOTIFY_INVAL_ENTRY = 3,
 	FUSE_NOTIFY_STORE = 4,
 	FUSE_NOTIFY_RETRIEVE = 5,
+	FUSE_NOTIFY_DELETE = 6,
 	FUSE_NOTIFY_CODE_MAX,
+
+	/* local extension, only accepted with the inval_batch mount option */
+	FUSE_NOTIFY_INVAL_BATCH = 1024,
 };
 
 /* The read buffer is required to be at least 8k, but may be much larger */
@@ -483,6 +492,10 @@ struct fuse_init_out {
 	__u16   max_background;
 	__u16   congestion_threshold;
 	__u32	max_write;
+	__u32	time_gran;
+	__u16	max_pages;
+	__u16	padding;
+	__u32	unused[8];
 };
 
 #define CUSE_INIT_INFO_MAX 4096
@@ -587,6 +600,16 @@ struct fuse_dirent {
 #define FUSE_DIRENT_SIZE(d) \
 	FUSE_DIRENT_ALIGN(FUSE_NAME_OFFSET + (d)->namelen)
 
+struct fuse_direntplus {
+	struct fuse_entry_out entry_out;
+	struct fuse_dirent dirent;
+};
+
+#define FUSE_NAME_OFFSET_DIRENTPLUS \
+	offsetof(struct fuse_direntplus, dirent.name)
+#define FUSE_DIRENTPLUS_SIZE(d) \
+	FUSE_DIRENT_ALIGN(FUSE_NAME_OFFSET_DIRENTPLUS + (d)->dirent.namelen)
+
 struct fuse_notify_inval_inode_out {
 	__u64	ino;
 	__s64	off;
@@ -599,6 +622,46 @@ struct fuse_notify_inval_entry_out {
 	__u32	padding;
 };
 
+/*
+ * FUSE_NOTIFY_INVAL_BATCH carries count records, each a
+ * fuse_notify_inval_batch_entry.  With namelen zero it invalidates the
+ * attributes and the off/len data range of inode ino, like
+ * FUSE_NOTIFY_INVAL_INODE.  Otherwise it is followed by a zero
+ * terminated name, padded to 8 bytes, and invalidates that entry in
+ * directory ino, like FUSE_NOTIFY_INVAL_ENTRY.  The whole message may be
+ * at most FUSE_NOTIFY_INVAL_BATCH_MAX bytes.  The code is not part of the
+ * upstream protocol, so the kernel only accepts it on a connection
+ * mounted with inval_batch.
+ */
+#define FUSE_NOTIFY_INVAL_BATCH_MAX 16384
+
+struct fuse_notify_inval_batch_out {
+	__u32	count;
+	__u32	padding;
+};
+
+struct fuse_notify_inval_batch_entry {
+	__u64	ino;
+	__s64	off;
+	__s64	len;
+	__u32	namelen;
+	__u32	padding;
+	char	name[0];
+};
+
+#define FUSE_INVAL_BATCH_NAME_OFFSET \
+	offsetof(struct fuse_notify_inval_batch_entry, name)
+#define FUSE_INVAL_BATCH_ENTRY_SIZE(e) \
+	FUSE_DIRENT_ALIGN(FUSE_INVAL_BATCH_NAME_OFFSET + \
+			  ((e)->namelen ? (e)->namelen + 1 : 0))
+
+struct fuse_notify_delete_out {
+	__u64	parent;
+	__u64	child;
+	__u32	namelen;
+	__u32	padding;
+};
+
 struct fuse_notify_store_out {
 	__u64	nodeid;
 	__u64	offset;
@@ -31,6 +31,7 @@
 #include <linux/mutex.h>
 #include <linux/timer.h>
 #include <linux/slab.h>
+#include <linux/math64.h>
 #endif
 
 #define journal_oom_retry 1
@@ -662,6 +663,24 @@ struct transaction_stats_s {
 	struct transaction_run_stats_s run;
 };
 
+/* log2 buckets of microseconds, the last one open ended */
+#define JBD2_HIST_SLOTS		24
+
+struct transaction_hist_s {
+	/* handles waiting to start */
+	unsigned long		th_wait[JBD2_HIST_SLOTS];
+	unsigned long		th_locked[JBD2_HIST_SLOTS];
+	unsigned long		th_commit[JBD2_HIST_SLOTS];
+};
+
+static inline void jbd2_hist_add(unsigned long *hist, u64 ns)
+{
+	u64 us = div_u64(ns, NSEC_PER_USEC);
+	int slot = us ? fls64(us) : 0;
+
+	hist[min(slot, JBD2_HIST_SLOTS - 1)]++;
+}
+
 static inline unsigned long
 jbd2_time_diff(unsigned long start, unsigned long end)
 {
@@ -740,6 +759,7 @@ jbd2_time_diff(unsigned long start, unsigned long end)
  * @j_history_lock: Protect the transactions statistics history
  * @j_proc_entry: procfs entry for the jbd statistics directory
  * @j_stats: Overall statistics
+ * @j_hist: Histograms of handle wait, locked and commit time
  * @j_private: An opaque pointer to fs-private information.
  */
 
@@ -968,6 +988,7 @@ struct journal_s
 	spinlock_t		j_history_lock;
 	struct proc_dir_entry	*j_proc_entry;
 	struct transaction_stats_s j_stats;
+	struct transaction_hist_s j_hist;
 
 	/* Failed journal commit ID */
 	unsigned int		j_failed_commit;
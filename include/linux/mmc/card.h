@@ -57,6 +57,9 @@ struct mmc_ext_csd {
 	unsigned int		sec_trim_mult;	/* Secure trim multiplier  */
 	unsigned int		sec_erase_mult;	/* Secure erase multiplier */
 	unsigned int		trim_timeout;		/* In milliseconds */
+	u8			max_packed_writes;
+	u8			max_packed_reads;
+	bool			packed_event_en;
 };
 
 struct sd_scr {
@@ -10,6 +10,8 @@
 
 #include <linux/interrupt.h>
 #include <linux/device.h>
+#include <linux/completion.h>
+#include <linux/ktime.h>
 
 struct request;
 struct mmc_data;
@@ -117,6 +119,7 @@ struct mmc_data {
 
 	unsigned int		sg_len;		/* size of scatter list */
 	struct scatterlist	*sg;		/* I/O scatter list */
+	s32			host_cookie;	/* host private data */
 };
 
 struct mmc_request {
@@ -125,17 +128,40 @@ struct mmc_request {
 	struct mmc_data		*data;
 	struct mmc_command	*stop;
 
+	struct completion	completion;
 	void			*done_data;	/* completion data */
 	void			(*done)(struct mmc_request *);/* completion function */
+
+#ifdef CONFIG_MMC_LATENCY_HIST
+	ktime_t			queued;		/* handed to the core */
+	ktime_t			started;	/* handed to the host */
+	ktime_t			cmd_done;	/* command response (host) */
+	ktime_t			data_done;	/* data transferred (host) */
+	ktime_t			completed;	/* mmc_request_done() */
+#endif
 };
 
 struct mmc_host;
 struct mmc_card;
+struct mmc_async_req;
+
+struct mmc_async_req {
+	/* active mmc request */
+	struct mmc_request	*mrq;
+	/*
+	 * Check error status of completed mmc request.
+	 * Returns 0 if success otherwise non zero.
+	 */
+	int (*err_check) (struct mmc_card *, struct mmc_async_req *);
+};
 
+extern struct mmc_async_req *mmc_start_req(struct mmc_host *,
+					   struct mmc_async_req *, int *);
 extern void mmc_wait_for_req(struct mmc_host *, struct mmc_request *);
 extern int mmc_wait_for_cmd(struct mmc_host *, struct mmc_command *, int);
 extern int mmc_wait_for_app_cmd(struct mmc_host *, struct mmc_card *,
 	struct mmc_command *, int);
+extern int mmc_send_ext_csd(struct mmc_card *card, u8 *ext_csd);
 
 #define MMC_ERASE_ARG		0x00000000
 #define MMC_SECURE_ERASE_ARG	0x80000000
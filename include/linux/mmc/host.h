@@ -105,6 +105,18 @@ struct mmc_host_ops {
 	 */
 	int (*enable)(struct mmc_host *host);
 	int (*disable)(struct mmc_host *host, int lazy);
+	/*
+	 * It is optional for the host to implement pre_req and post_req in
+	 * order to support double buffering of requests (prepare one
+	 * request while another request is active).
+	 * pre_req() must always be followed by a post_req().
+	 * To undo a call made to pre_req(), call post_req() with
+	 * a nonzero err condition.
+	 */
+	void	(*post_req)(struct mmc_host *host, struct mmc_request *req,
+			    int err);
+	void	(*pre_req)(struct mmc_host *host, struct mmc_request *req,
+			   bool is_first_req);
 	void	(*request)(struct mmc_host *host, struct mmc_request *req);
 	/*
 	 * Avoid calling these three functions too often or in a "fast path",
@@ -143,6 +155,35 @@ struct mmc_host_ops {
 struct mmc_card;
 struct device;
 
+#ifdef CONFIG_MMC_LATENCY_HIST
+enum mmc_lat_class {
+	MMC_LAT_READ,
+	MMC_LAT_WRITE,
+	MMC_LAT_DISCARD,
+	MMC_LAT_OTHER,
+	MMC_LAT_NR_CLASSES,
+};
+
+enum mmc_lat_phase {
+	MMC_LAT_QUEUE,		/* core entry to host->ops->request() */
+	MMC_LAT_ISSUE,		/* until the command response */
+	MMC_LAT_DMA,		/* until the data is transferred */
+	MMC_LAT_BUSY,		/* card programming, stop and status polls */
+	MMC_LAT_TOTAL,
+	MMC_LAT_NR_PHASES,
+};
+
+#define MMC_LAT_BUCKETS		20	/* log2 microseconds, last is open */
+
+struct mmc_latency_hist {
+	spinlock_t	lock;
+	unsigned long	count[MMC_LAT_NR_CLASSES];
+	u32		max_us[MMC_LAT_NR_CLASSES][MMC_LAT_NR_PHASES];
+	u32		hist[MMC_LAT_NR_CLASSES][MMC_LAT_NR_PHASES]
+			    [MMC_LAT_BUCKETS];
+};
+#endif
+
 struct mmc_host {
 	struct device		*parent;
 	struct device		class_dev;
@@ -284,6 +325,8 @@ struct mmc_host {
 
 	struct dentry		*debugfs_root;
 
+	struct mmc_async_req	*areq;		/* active async req */
+
 #ifdef CONFIG_MMC_EMBEDDED_SDIO
 	struct {
 		struct sdio_cis			*cis;
@@ -306,6 +349,9 @@ struct mmc_host {
 		ktime_t wtime_drv;	   /* Wr time  MMC Host  */
 		ktime_t start;
 	} perf;
+#endif
+#ifdef CONFIG_MMC_LATENCY_HIST
+	struct mmc_latency_hist	lat_hist;
 #endif
 	unsigned long		private[0] ____cacheline_aligned;
 };
@@ -382,6 +428,27 @@ static inline int mmc_regulator_set_ocr(struct mmc_host *mmc,
 }
 #endif
 
+/*
+ * Host drivers call these when the command response of @mrq arrives and
+ * when its data has been transferred, to split the request latency into
+ * phases.  Without them the whole time is accounted to one phase.
+ */
+static inline void mmc_latency_cmd_done(struct mmc_request *mrq)
+{
+#ifdef CONFIG_MMC_LATENCY_HIST
+	if (!mrq->cmd_done.tv64)
+		mrq->cmd_done = ktime_get();
+#endif
+}
+
+static inline void mmc_latency_data_done(struct mmc_request *mrq)
+{
+#ifdef CONFIG_MMC_LATENCY_HIST
+	if (!mrq->data_done.tv64)
+		mrq->data_done = ktime_get();
+#endif
+}
+
 static inline int mmc_host_cmd23(struct mmc_host *host)
 {
 	return host->caps & MMC_CAP_CMD23;
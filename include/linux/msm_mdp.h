@@ -50,6 +50,9 @@
 
 #define MSMFB_OVERLAY_3D       _IOWR(MSMFB_IOCTL_MAGIC, 147, \
 						struct msmfb_overlay_3d)
+#define MSMFB_ASYNC_BLIT       _IOWR(MSMFB_IOCTL_MAGIC, 148, \
+						struct mdp_async_blit_req_list)
+#define MSMFB_ASYNC_BLIT_WAIT  _IOW(MSMFB_IOCTL_MAGIC, 149, unsigned int)
 
 #define FB_TYPE_3D_PANEL 0x10101010
 #define MDP_IMGTYPE2_START 0x10000
@@ -184,6 +187,20 @@ struct mdp_blit_req_list {
 	struct mdp_blit_req req[];
 };
 
+/*
+ * MSMFB_ASYNC_BLIT: all requests are validated and flushed before the
+ * ioctl returns, the blits themselves run in the background.  The returned
+ * handle can be passed to MSMFB_ASYNC_BLIT_WAIT to wait for completion.
+ * The wait returns the first error of any list up to and including that
+ * handle which has not been reported yet, and -EINVAL for a handle that
+ * was never returned.
+ */
+struct mdp_async_blit_req_list {
+	uint32_t count;
+	uint32_t handle;	/* out */
+	struct mdp_blit_req req[];
+};
+
 #define MSMFB_DATA_VERSION 2
 
 struct msmfb_data {
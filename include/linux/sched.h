@@ -1321,6 +1321,9 @@ struct task_struct {
 	cputime_t gtime;
 #ifndef CONFIG_VIRT_CPU_ACCOUNTING
 	cputime_t prev_utime, prev_stime;
+#endif
+#ifdef CONFIG_CPU_FREQ_STAT_TASK
+	cputime64_t *cpufreq_time_in_state;	/* indexed like cpufreq_stats */
 #endif
 	unsigned long nvcsw, nivcsw; /* context switch counts */
 	struct timespec start_time; 		/* monotonic time */
@@ -0,0 +1,42 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM cpufreq_sched
+
+#if !defined(_TRACE_CPUFREQ_SCHED_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_CPUFREQ_SCHED_H
+
+#include <linux/tracepoint.h>
+
+/*
+ * One event per frequency decision of the 'sched' governor: the
+ * utilization of the last window (0..1024 of the current frequency),
+ * the frequency the CPU ran at and the frequency requested.
+ */
+TRACE_EVENT(cpufreq_sched_decision,
+
+	TP_PROTO(unsigned int cpu, unsigned int util, unsigned int cur,
+		 unsigned int target),
+
+	TP_ARGS(cpu, util, cur, target),
+
+	TP_STRUCT__entry(
+		__field(	unsigned int,	cpu	)
+		__field(	unsigned int,	util	)
+		__field(	unsigned int,	cur	)
+		__field(	unsigned int,	target	)
+	),
+
+	TP_fast_assign(
+		__entry->cpu = cpu;
+		__entry->util = util;
+		__entry->cur = cur;
+		__entry->target = target;
+	),
+
+	TP_printk("cpu=%u util=%u cur=%u target=%u",
+		  __entry->cpu, __entry->util, __entry->cur, __entry->target)
+);
+
+#endif /* _TRACE_CPUFREQ_SCHED_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -0,0 +1,79 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM mmc
+
+#if !defined(_TRACE_MMC_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_MMC_H
+
+#include <linux/tracepoint.h>
+#include <linux/mmc/core.h>
+#include <linux/mmc/host.h>
+
+/*
+ * A request is handed to the host driver, and the host driver reports it
+ * done.  The distance between the two is the issue to completion time
+ * of the request; retries by the core are not traced again.
+ */
+TRACE_EVENT(mmc_request_start,
+
+	TP_PROTO(struct mmc_host *host, struct mmc_request *mrq),
+
+	TP_ARGS(host, mrq),
+
+	TP_STRUCT__entry(
+		__string(	name,		mmc_hostname(host)	)
+		__field(	u32,		opcode			)
+		__field(	u32,		arg			)
+		__field(	unsigned int,	blocks			)
+		__field(	unsigned int,	blksz			)
+		__field(	unsigned int,	flags			)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, mmc_hostname(host));
+		__entry->opcode = mrq->cmd->opcode;
+		__entry->arg = mrq->cmd->arg;
+		__entry->blocks = mrq->data ? mrq->data->blocks : 0;
+		__entry->blksz = mrq->data ? mrq->data->blksz : 0;
+		__entry->flags = mrq->data ? mrq->data->flags : 0;
+	),
+
+	TP_printk("%s: CMD%u arg=%08x blocks=%u blksz=%u%s",
+		  __get_str(name), __entry->opcode, __entry->arg,
+		  __entry->blocks, __entry->blksz,
+		  __entry->flags & MMC_DATA_WRITE ? " write" :
+		  __entry->flags & MMC_DATA_READ ? " read" : "")
+);
+
+TRACE_EVENT(mmc_request_done,
+
+	TP_PROTO(struct mmc_host *host, struct mmc_request *mrq),
+
+	TP_ARGS(host, mrq),
+
+	TP_STRUCT__entry(
+		__string(	name,		mmc_hostname(host)	)
+		__field(	u32,		opcode			)
+		__field(	int,		cmd_err			)
+		__field(	int,		data_err		)
+		__field(	int,		stop_err		)
+		__field(	unsigned int,	bytes_xfered		)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, mmc_hostname(host));
+		__entry->opcode = mrq->cmd->opcode;
+		__entry->cmd_err = mrq->cmd->error;
+		__entry->data_err = mrq->data ? mrq->data->error : 0;
+		__entry->stop_err = mrq->stop ? mrq->stop->error : 0;
+		__entry->bytes_xfered = mrq->data ? mrq->data->bytes_xfered : 0;
+	),
+
+	TP_printk("%s: CMD%u err=%d/%d/%d bytes=%u",
+		  __get_str(name), __entry->opcode, __entry->cmd_err,
+		  __entry->data_err, __entry->stop_err, __entry->bytes_xfered)
+);
+
+#endif /* _TRACE_MMC_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -0,0 +1,43 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM msm_hotplug
+
+#if !defined(_TRACE_MSM_HOTPLUG_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_MSM_HOTPLUG_H
+
+#include <linux/tracepoint.h>
+
+/*
+ * One event per CPU brought online or taken offline by the msm hotplug
+ * governor, with the run queue average (tenths of a task) and the
+ * frequency scaled load (percent) that led to the decision.
+ */
+TRACE_EVENT(msm_hotplug_decision,
+
+	TP_PROTO(unsigned int cpu, int online, unsigned int rq_avg,
+		 unsigned int load),
+
+	TP_ARGS(cpu, online, rq_avg, load),
+
+	TP_STRUCT__entry(
+		__field(	unsigned int,	cpu	)
+		__field(	int,		online	)
+		__field(	unsigned int,	rq_avg	)
+		__field(	unsigned int,	load	)
+	),
+
+	TP_fast_assign(
+		__entry->cpu = cpu;
+		__entry->online = online;
+		__entry->rq_avg = rq_avg;
+		__entry->load = load;
+	),
+
+	TP_printk("cpu=%u %s rq_avg=%u.%u load=%u",
+		  __entry->cpu, __entry->online ? "online" : "offline",
+		  __entry->rq_avg / 10, __entry->rq_avg % 10, __entry->load)
+);
+
+#endif /* _TRACE_MSM_HOTPLUG_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -73,6 +73,7 @@
 #include <linux/ftrace.h>
 #include <linux/slab.h>
 #include <linux/cpuacct.h>
+#include <linux/cpufreq.h>
 
 #include <asm/tlb.h>
 #include <asm/irq_regs.h>
@@ -3534,6 +3535,7 @@ void account_user_time(struct task_struct *p, cputime_t cputime,
 		cpustat->user = cputime64_add(cpustat->user, tmp);
 
 	cpuacct_update_stats(p, CPUACCT_STAT_USER, cputime);
+	cpufreq_task_stats_account(p, cputime);
 	/* Account for user time used */
 	acct_update_integrals(p);
 }
@@ -3601,6 +3603,7 @@ void account_system_time(struct task_struct *p, int hardirq_offset,
 		cpustat->system = cputime64_add(cpustat->system, tmp);
 
 	cpuacct_update_stats(p, CPUACCT_STAT_SYSTEM, cputime);
+	cpufreq_task_stats_account(p, cputime);
 
 	/* Account for system time used */
 	acct_update_integrals(p);
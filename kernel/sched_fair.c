@@ -1274,6 +1274,8 @@ enqueue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 	struct cfs_rq *cfs_rq;
 	struct sched_entity *se = &p->se;
 
+	cpufreq_sched_update(cpu_of(rq), rq->nr_running, rq->clock);
+
 	for_each_sched_entity(se) {
 		if (se->on_rq)
 			break;
@@ -1302,6 +1304,8 @@ static void dequeue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 	struct cfs_rq *cfs_rq;
 	struct sched_entity *se = &p->se;
 
+	cpufreq_sched_update(cpu_of(rq), rq->nr_running, rq->clock);
+
 	for_each_sched_entity(se) {
 		cfs_rq = cfs_rq_of(se);
 		dequeue_entity(cfs_rq, se, flags);
@@ -4031,6 +4035,8 @@ static void task_tick_fair(struct rq *rq, struct task_struct *curr, int queued)
 		cfs_rq = cfs_rq_of(se);
 		entity_tick(cfs_rq, se, queued);
 	}
+
+	cpufreq_sched_update(cpu_of(rq), rq->nr_running, rq->clock);
 }
 
 /*
@@ -16,6 +16,25 @@
 void free_pgtables(struct mmu_gather *tlb, struct vm_area_struct *start_vma,
 		unsigned long floor, unsigned long ceiling);
 
+#ifdef CONFIG_READAHEAD_TRACE
+extern int readahead_trace_recording;
+extern void __readahead_trace_record(struct file *filp, pgoff_t start,
+				     unsigned long nr);
+
+/* Log a range read into the page cache while a trace is recorded. */
+static inline void readahead_trace_record(struct file *filp, pgoff_t start,
+					  unsigned long nr)
+{
+	if (unlikely(readahead_trace_recording))
+		__readahead_trace_record(filp, start, nr);
+}
+#else
+static inline void readahead_trace_record(struct file *filp, pgoff_t start,
+					  unsigned long nr)
+{
+}
+#endif
+
 static inline void set_page_count(struct page *page, int v)
 {
 	atomic_set(&page->_count, v);
@@ -0,0 +1,499 @@
+/*
+ * mm/readahead_trace.c - record and replay page cache reads
+ *
+ * Records the file ranges read from disk during boot or an application
+ * launch, so that the next time the same working set can be read up
+ * front in large sorted chunks instead of page fault by page fault.
+ *
+ * Writing "record [name]" to /proc/readahead_trace starts recording every
+ * range __do_page_cache_readahead() reads, "stop" ends it; recording also
+ * stops by itself after max_record_secs.  The "readahead_trace=<name>"
+ * boot option starts recording before the root filesystem is mounted.
+ *
+ * Reading the file returns the trace as "<start> <nr_pages> <path>" lines,
+ * with the files in device and inode order, which on ext4 roughly follows
+ * their place on disk, and each file's ranges sorted and merged.  Writing
+ * such lines back replays them with force_page_cache_readahead().
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/ctype.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/dcache.h>
+#include <linux/hash.h>
+#include <linux/jiffies.h>
+#include <linux/kref.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/vmalloc.h>
+#include <asm/uaccess.h>
+
+#include "internal.h"
+
+#define RA_TRACE_NAME_LEN	32
+#define RA_TRACE_MAX_FILES	4096
+#define RA_TRACE_MAX_RANGES	32768
+#define RA_TRACE_HASH_BITS	8
+
+static unsigned int max_record_secs = 120;
+module_param(max_record_secs, uint, S_IRUGO | S_IWUSR);
+
+struct ra_trace_file {
+	struct hlist_node	hash;
+	dev_t			dev;
+	unsigned long		ino;
+	char			*path;
+};
+
+struct ra_trace_range {
+	unsigned int		file;		/* index in files */
+	unsigned int		nr;
+	pgoff_t			start;
+};
+
+struct ra_trace_buf {
+	struct kref		kref;
+	char			name[RA_TRACE_NAME_LEN];
+	struct ra_trace_file	*files;
+	unsigned int		nr_files;
+	struct ra_trace_range	*ranges;
+	unsigned int		nr_ranges;
+	struct hlist_head	hash[1 << RA_TRACE_HASH_BITS];
+};
+
+/* A snapshot of a trace, sorted and merged for reading */
+struct ra_trace_session {
+	struct ra_trace_buf	*buf;
+	struct ra_trace_range	*ranges;
+	unsigned int		nr_ranges;
+};
+
+int readahead_trace_recording;
+static unsigned long ra_trace_deadline;
+static struct ra_trace_buf *ra_trace_cur;
+static DEFINE_MUTEX(ra_trace_mutex);
+
+static char ra_trace_boot_name[RA_TRACE_NAME_LEN] __initdata;
+
+static void ra_trace_buf_release(struct kref *kref)
+{
+	struct ra_trace_buf *buf = container_of(kref, struct ra_trace_buf,
+						kref);
+	unsigned int i;
+
+	for (i = 0; i < buf->nr_files; i++)
+		kfree(buf->files[i].path);
+	vfree(buf->files);
+	vfree(buf->ranges);
+	kfree(buf);
+}
+
+static void ra_trace_buf_put(struct ra_trace_buf *buf)
+{
+	if (buf)
+		kref_put(&buf->kref, ra_trace_buf_release);
+}
+
+static struct ra_trace_buf *ra_trace_buf_alloc(const char *name)
+{
+	struct ra_trace_buf *buf;
+	int i;
+
+	buf = kzalloc(sizeof(*buf), GFP_KERNEL);
+	if (!buf)
+		return NULL;
+	buf->files = vmalloc(RA_TRACE_MAX_FILES * sizeof(*buf->files));
+	buf->ranges = vmalloc(RA_TRACE_MAX_RANGES * sizeof(*buf->ranges));
+	if (!buf->files || !buf->ranges) {
+		vfree(buf->files);
+		vfree(buf->ranges);
+		kfree(buf);
+		return NULL;
+	}
+	kref_init(&buf->kref);
+	strlcpy(buf->name, name, sizeof(buf->name));
+	for (i = 0; i < ARRAY_SIZE(buf->hash); i++)
+		INIT_HLIST_HEAD(&buf->hash[i]);
+	return buf;
+}
+
+/* ra_trace_mutex must be held */
+static int ra_trace_start(const char *name)
+{
+	struct ra_trace_buf *buf = ra_trace_buf_alloc(name);
+
+	if (!buf)
+		return -ENOMEM;
+	ra_trace_buf_put(ra_trace_cur);
+	ra_trace_cur = buf;
+	ra_trace_deadline = jiffies + max_record_secs * HZ;
+	readahead_trace_recording = 1;
+	return 0;
+}
+
+/*
+ * Find or add the file of a recorded range.  Files are remembered by
+ * path, the only name that survives a reboot; unlinked files and files
+ * without a usable path are not recorded.
+ */
+static int ra_trace_file_index(struct ra_trace_buf *buf, struct file *filp)
+{
+	struct inode *inode = filp->f_mapping->host;
+	dev_t dev = inode->i_sb->s_dev;
+	struct hlist_head *head;
+	struct hlist_node *node;
+	struct ra_trace_file *f;
+	char *page, *path;
+
+	head = &buf->hash[hash_long(inode->i_ino ^ dev, RA_TRACE_HASH_BITS)];
+	hlist_for_each_entry(f, node, head, hash)
+		if (f->ino == inode->i_ino && f->dev == dev)
+			return f - buf->files;
+
+	if (buf->nr_files == RA_TRACE_MAX_FILES ||
+	    d_unlinked(filp->f_path.dentry))
+		return -1;
+
+	page = (char *)__get_free_page(GFP_NOFS);
+	if (!page)
+		return -1;
+	path = d_path(&filp->f_path, page, PAGE_SIZE);
+	if (IS_ERR(path) || path[0] != '/' || strchr(path, '\n')) {
+		free_page((unsigned long)page);
+		return -1;
+	}
+
+	f = &buf->files[buf->nr_files];
+	f->path = kstrdup(path, GFP_NOFS);
+	free_page((unsigned long)page);
+	if (!f->path)
+		return -1;
+	f->dev = dev;
+	f->ino = inode->i_ino;
+	hlist_add_head(&f->hash, head);
+	return buf->nr_files++;
+}
+
+void __readahead_trace_record(struct file *filp, pgoff_t start,
+			      unsigned long nr)
+{
+	struct ra_trace_buf *buf;
+	struct ra_trace_range *r;
+	int file;
+
+	if (!filp || !nr)
+		return;
+
+	mutex_lock(&ra_trace_mutex);
+	buf = ra_trace_cur;
+	if (!readahead_trace_recording || !buf)
+		goto out;
+	if (time_after(jiffies, ra_trace_deadline)) {
+		readahead_trace_recording = 0;
+		goto out;
+	}
+
+	file = ra_trace_file_index(buf, filp);
+	if (file < 0)
+		goto out;
+
+	if (buf->nr_ranges) {
+		r = &buf->ranges[buf->nr_ranges - 1];
+		if (r->file == file && r->start + r->nr == start) {
+			r->nr += nr;
+			goto out;
+		}
+	}
+	if (buf->nr_ranges == RA_TRACE_MAX_RANGES) {
+		readahead_trace_recording = 0;
+		goto out;
+	}
+	r = &buf->ranges[buf->nr_ranges++];
+	r->file = file;
+	r->start = start;
+	r->nr = nr;
+out:
+	mutex_unlock(&ra_trace_mutex);
+}
+
+/* protected by ra_trace_mutex */
+static struct ra_trace_file *ra_trace_sort_files;
+
+static int ra_trace_cmp_start(const void *a, const void *b)
+{
+	const struct ra_trace_range *ra = a, *rb = b;
+
+	if (ra->start != rb->start)
+		return ra->start < rb->start ? -1 : 1;
+	return 0;
+}
+
+static int ra_trace_cmp(const void *a, const void *b)
+{
+	const struct ra_trace_range *ra = a, *rb = b;
+	const struct ra_trace_file *fa = &ra_trace_sort_files[ra->file];
+	const struct ra_trace_file *fb = &ra_trace_sort_files[rb->file];
+
+	if (fa->dev != fb->dev)
+		return fa->dev < fb->dev ? -1 : 1;
+	if (fa->ino != fb->ino)
+		return fa->ino < fb->ino ? -1 : 1;
+	return ra_trace_cmp_start(a, b);
+}
+
+/* Merge overlapping or adjacent ranges of a sorted array. */
+static unsigned int ra_trace_merge(struct ra_trace_range *ranges,
+				   unsigned int nr)
+{
+	unsigned int i, out = 0;
+
+	if (!nr)
+		return 0;
+
+	for (i = 1; i < nr; i++) {
+		struct ra_trace_range *r = &ranges[out];
+
+		if (ranges[i].file == r->file &&
+		    ranges[i].start <= r->start + r->nr) {
+			r->nr = max_t(pgoff_t, r->start + r->nr,
+				      ranges[i].start + ranges[i].nr) -
+				r->start;
+			continue;
+		}
+		ranges[++out] = ranges[i];
+	}
+	return out + 1;
+}
+
+static void *ra_trace_seq_start(struct seq_file *seq, loff_t *pos)
+{
+	struct ra_trace_session *s = seq->private;
+
+	if (*pos == 0)
+		return SEQ_START_TOKEN;
+	if (*pos > s->nr_ranges)
+		return NULL;
+	return &s->ranges[*pos - 1];
+}
+
+static void *ra_trace_seq_next(struct seq_file *seq, void *v, loff_t *pos)
+{
+	++*pos;
+	return ra_trace_seq_start(seq, pos);
+}
+
+static int ra_trace_seq_show(struct seq_file *seq, void *v)
+{
+	struct ra_trace_session *s = seq->private;
+	struct ra_trace_range *r = v;
+
+	if (v == SEQ_START_TOKEN) {
+		if (s->buf)
+			seq_printf(seq, "# %s: %u files, %u ranges\n",
+				   s->buf->name, s->buf->nr_files,
+				   s->nr_ranges);
+		return 0;
+	}
+	seq_printf(seq, "%lu %u %s\n", r->start, r->nr,
+		   s->buf->files[r->file].path);
+	return 0;
+}
+
+static void ra_trace_seq_stop(struct seq_file *seq, void *v)
+{
+}
+
+static const struct seq_operations ra_trace_seq_ops = {
+	.start	= ra_trace_seq_start,
+	.next	= ra_trace_seq_next,
+	.stop	= ra_trace_seq_stop,
+	.show	= ra_trace_seq_show,
+};
+
+static int ra_trace_open(struct inode *inode, struct file *file)
+{
+	struct ra_trace_session *s;
+	struct ra_trace_buf *buf;
+	int ret;
+
+	s = kzalloc(sizeof(*s), GFP_KERNEL);
+	if (!s)
+		return -ENOMEM;
+
+	mutex_lock(&ra_trace_mutex);
+	buf = (file->f_mode & FMODE_READ) ? ra_trace_cur : NULL;
+	if (buf && buf->nr_ranges) {
+		s->ranges = vmalloc(buf->nr_ranges * sizeof(*s->ranges));
+		if (!s->ranges) {
+			mutex_unlock(&ra_trace_mutex);
+			kfree(s);
+			return -ENOMEM;
+		}
+		memcpy(s->ranges, buf->ranges,
+		       buf->nr_ranges * sizeof(*s->ranges));
+		ra_trace_sort_files = buf->files;
+		sort(s->ranges, buf->nr_ranges, sizeof(*s->ranges),
+		     ra_trace_cmp, NULL);
+		s->nr_ranges = ra_trace_merge(s->ranges, buf->nr_ranges);
+	}
+	if (buf)
+		kref_get(&buf->kref);
+	s->buf = buf;
+	mutex_unlock(&ra_trace_mutex);
+
+	ret = seq_open(file, &ra_trace_seq_ops);
+	if (ret) {
+		ra_trace_buf_put(s->buf);
+		vfree(s->ranges);
+		kfree(s);
+		return ret;
+	}
+	((struct seq_file *)file->private_data)->private = s;
+	return 0;
+}
+
+static int ra_trace_release(struct inode *inode, struct file *file)
+{
+	struct ra_trace_session *s;
+
+	s = ((struct seq_file *)file->private_data)->private;
+	ra_trace_buf_put(s->buf);
+	vfree(s->ranges);
+	kfree(s);
+	return seq_release(inode, file);
+}
+
+static void ra_trace_replay_file(const char *path,
+				 struct ra_trace_range *ranges,
+				 unsigned int nr)
+{
+	struct file *filp;
+	unsigned int i;
+
+	filp = filp_open(path, O_RDONLY | O_LARGEFILE, 0);
+	if (IS_ERR(filp))
+		return;
+
+	sort(ranges, nr, sizeof(*ranges), ra_trace_cmp_start, NULL);
+	nr = ra_trace_merge(ranges, nr);
+	for (i = 0; i < nr; i++)
+		force_page_cache_readahead(filp->f_mapping, filp,
+					   ranges[i].start, ranges[i].nr);
+	filp_close(filp, NULL);
+}
+
+/*
+ * Replay the trace lines in buf, each run of lines for the same file
+ * with the file opened once and its ranges sorted.  Returns the number
+ * of bytes used, which is up to the last complete line.
+ */
+static ssize_t ra_trace_replay(char *buf, size_t len)
+{
+	struct ra_trace_range *ranges;
+	char *line = buf, *end, *path, *last = NULL;
+	unsigned int nr = 0, max = len / 6 + 1;
+	unsigned long start;
+	unsigned int count;
+	int n;
+
+	ranges = kmalloc(max * sizeof(*ranges), GFP_KERNEL);
+	if (!ranges)
+		return -ENOMEM;
+
+	while ((end = memchr(line, '\n', buf + len - line))) {
+		*end = '\0';
+		if (line[0] == '#' || sscanf(line, "%lu %u %n",
+					     &start, &count, &n) != 2)
+			goto next;
+		path = line + n;
+		if (last && strcmp(last, path)) {
+			ra_trace_replay_file(last, ranges, nr);
+			nr = 0;
+		}
+		last = path;
+		ranges[nr].file = 0;
+		ranges[nr].start = start;
+		ranges[nr].nr = count;
+		nr++;
+next:
+		line = end + 1;
+	}
+	if (nr)
+		ra_trace_replay_file(last, ranges, nr);
+	kfree(ranges);
+
+	return line - buf;
+}
+
+static ssize_t ra_trace_write(struct file *file, const char __user *ubuf,
+			      size_t count, loff_t *ppos)
+{
+	char *buf, *name;
+	ssize_t ret;
+
+	count = min_t(size_t, count, PAGE_SIZE - 1);
+	buf = (char *)__get_free_page(GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+	if (copy_from_user(buf, ubuf, count)) {
+		ret = -EFAULT;
+		goto out;
+	}
+	buf[count] = '\0';
+
+	if (!strncmp(buf, "record", 6) && (!buf[6] || isspace(buf[6]))) {
+		name = strstrip(buf + 6);
+		mutex_lock(&ra_trace_mutex);
+		ret = ra_trace_start(*name ? name : "trace");
+		mutex_unlock(&ra_trace_mutex);
+		if (!ret)
+			ret = count;
+	} else if (sysfs_streq(buf, "stop")) {
+		readahead_trace_recording = 0;
+		ret = count;
+	} else {
+		ret = ra_trace_replay(buf, count);
+		if (ret == 0)
+			ret = -EINVAL;		/* no complete line */
+	}
+out:
+	free_page((unsigned long)buf);
+	return ret;
+}
+
+static const struct file_operations ra_trace_fops = {
+	.owner		= THIS_MODULE,
+	.open		= ra_trace_open,
+	.read		= seq_read,
+	.write		= ra_trace_write,
+	.llseek		= seq_lseek,
+	.release	= ra_trace_release,
+};
+
+static int __init ra_trace_setup(char *str)
+{
+	strlcpy(ra_trace_boot_name, str, sizeof(ra_trace_boot_name));
+	return 1;
+}
+__setup("readahead_trace=", ra_trace_setup);
+
+static int __init ra_trace_init(void)
+{
+	proc_create("readahead_trace", S_IRUSR | S_IWUSR, NULL,
+		    &ra_trace_fops);
+
+	if (ra_trace_boot_name[0]) {
+		mutex_lock(&ra_trace_mutex);
+		ra_trace_start(ra_trace_boot_name);
+		mutex_unlock(&ra_trace_mutex);
+	}
+	return 0;
+}
+module_init(ra_trace_init);